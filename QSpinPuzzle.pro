@@ -37,6 +37,16 @@ SOURCES += \
     src/puzzle/spin_metrics.h \
     src/puzzle/spin_game_recorder.h \
     src/puzzle/spin_game_recorder.cpp \
+    src/puzzle/spin_packed_state.cpp \
+    src/puzzle/spin_discrete_moves.cpp \
+    src/puzzle/spin_puzzle_batch.cpp \
+    src/puzzle/spin_zobrist.cpp \
+    src/puzzle/spin_solver.cpp \
+    src/puzzle/spin_transposition_table.cpp \
+    src/puzzle/spin_pattern_database.cpp \
+    src/puzzle/spin_symmetry.cpp \
+    src/puzzle/spin_event_bus.cpp \
+    src/puzzle/spin_game_reader.cpp \
     src/widgets/spin_puzzle_history_widget.cpp \
     src/widgets/spin_puzzle_replay_widget.cpp \
     src/widgets/spin_puzzle_widget.cpp \
@@ -60,6 +70,16 @@ HEADERS  += \
     src/widgets/spin_puzzle_window.h \
     src/widgets/spin_puzzle_filesystems.h  \
     src/puzzle/spin_game_recorder.h \
+    src/puzzle/spin_packed_state.h \
+    src/puzzle/spin_discrete_moves.h \
+    src/puzzle/spin_puzzle_batch.h \
+    src/puzzle/spin_zobrist.h \
+    src/puzzle/spin_solver.h \
+    src/puzzle/spin_transposition_table.h \
+    src/puzzle/spin_pattern_database.h \
+    src/puzzle/spin_symmetry.h \
+    src/puzzle/spin_event_bus.h \
+    src/puzzle/spin_game_reader.h \
     src/widgets/spin_puzzle_config_widget.h
 
 DISTFILES += \
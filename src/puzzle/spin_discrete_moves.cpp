@@ -0,0 +1,180 @@
+#include "spin_discrete_moves.h"
+
+namespace puzzle {
+
+namespace {
+
+constexpr std::size_t N_COMMANDS =
+  static_cast<std::size_t>(COMMANDS::N_COMMANDS);
+
+using Permutation = DiscreteMoves::Permutation;
+//!< permutations for every (active side, command)
+using Permutations = std::array<std::array<Permutation, N_COMMANDS>, 2>;
+
+Permutation
+identity()
+{
+  Permutation p;
+  for (std::size_t n = 0; n < p.size(); ++n) {
+    p[n] = static_cast<uint8_t>(n);
+  }
+  return p;
+}
+
+//!< rotate the marbles of a leaf: clockwise moves every marble one step ahead
+Permutation
+rotation(SIDE side, LEAF leaf, bool clockwise)
+{
+  constexpr std::size_t N = DiscreteMoves::GROUP_SIZE;
+  Permutation p = identity();
+  for (std::size_t i = 0; i < N; ++i) {
+    const std::size_t source = clockwise ? (i + N - 1) % N : (i + 1) % N;
+    p[DiscreteMoves::position(side, leaf, i)] =
+      static_cast<uint8_t>(DiscreteMoves::position(side, leaf, source));
+  }
+  return p;
+}
+
+//!< swap the positions 1..5 of a leaf with the opposite leaf on the other side
+Permutation
+spin(SIDE side, LEAF leaf)
+{
+  const SIDE other = (side == SIDE::FRONT) ? SIDE::BACK : SIDE::FRONT;
+  const LEAF other_leaf = DiscreteMoves::opposite_leaf(leaf);
+  Permutation p = identity();
+  for (std::size_t i = 1; i <= DiscreteMoves::N_SPIN; ++i) {
+    const auto a = DiscreteMoves::position(side, leaf, i);
+    const auto b = DiscreteMoves::position(other, other_leaf, i);
+    p[a] = static_cast<uint8_t>(b);
+    p[b] = static_cast<uint8_t>(a);
+  }
+  return p;
+}
+
+Permutations
+create_permutations()
+{
+  Permutations permutations;
+  for (std::size_t s = 0; s < 2; ++s) {
+    const auto side = static_cast<SIDE>(s);
+    for (std::size_t c = 0; c < N_COMMANDS; ++c) {
+      const auto command = static_cast<COMMANDS>(c);
+      const LEAF leaf = DiscreteMoves::leaf(command);
+      if (command <= COMMANDS::WEST_RIGHT) {
+        permutations[s][c] = rotation(side, leaf, true);
+      } else if (command <= COMMANDS::WEST_LEFT) {
+        permutations[s][c] = rotation(side, leaf, false);
+      } else if (command <= COMMANDS::WEST_SPIN) {
+        permutations[s][c] = spin(side, leaf);
+      } else {
+        permutations[s][c] = identity();
+      }
+    }
+  }
+  return permutations;
+}
+
+//!< positions changed by a permutation
+DiscreteMoves::Moves
+sparse(const Permutation& permutation)
+{
+  // the unused entries copy a position that does not move into itself
+  std::size_t fixed = 0;
+  while (permutation[fixed] != fixed) {
+    ++fixed;
+  }
+  DiscreteMoves::Moves moves;
+  moves.target.fill(static_cast<uint8_t>(fixed));
+  moves.source.fill(static_cast<uint8_t>(fixed));
+  std::size_t n = 0;
+  for (std::size_t p = 0; p < permutation.size(); ++p) {
+    if (permutation[p] != p) {
+      moves.target[n] = static_cast<uint8_t>(p);
+      moves.source[n] = permutation[p];
+      ++n;
+    }
+  }
+  return moves;
+}
+
+} // namespace
+
+const DiscreteMoves::Moves&
+DiscreteMoves::moves(SIDE active_side, COMMANDS command)
+{
+  static const auto moves = []() {
+    std::array<std::array<Moves, N_COMMANDS>, 2> moves;
+    for (std::size_t s = 0; s < 2; ++s) {
+      for (std::size_t c = 0; c < N_COMMANDS; ++c) {
+        moves[s][c] = sparse(
+          permutation(static_cast<SIDE>(s), static_cast<COMMANDS>(c)));
+      }
+    }
+    return moves;
+  }();
+  return moves[static_cast<std::size_t>(active_side)]
+              [static_cast<std::size_t>(command)];
+}
+
+const DiscreteMoves::Permutation&
+DiscreteMoves::permutation(SIDE active_side, COMMANDS command)
+{
+  static const Permutations permutations = create_permutations();
+  return permutations[static_cast<std::size_t>(active_side)]
+                     [static_cast<std::size_t>(command)];
+}
+
+const std::array<uint8_t, DiscreteMoves::N_SPIN>&
+DiscreteMoves::spin_offsets(std::size_t step)
+{
+  // the i-th marble of a leaf shifted by `step` is stored at (i - step) mod N
+  static const auto offsets = []() {
+    std::array<std::array<uint8_t, N_SPIN>, GROUP_SIZE> offsets;
+    for (std::size_t s = 0; s < GROUP_SIZE; ++s) {
+      for (std::size_t i = 1; i <= N_SPIN; ++i) {
+        offsets[s][i - 1] =
+          static_cast<uint8_t>((i + GROUP_SIZE - s) % GROUP_SIZE);
+      }
+    }
+    return offsets;
+  }();
+  return offsets[step];
+}
+
+LEAF
+DiscreteMoves::leaf(COMMANDS command)
+{
+  switch (command) {
+    case COMMANDS::NORTH_RIGHT:
+    case COMMANDS::NORTH_LEFT:
+    case COMMANDS::NORTH_SPIN:
+      return LEAF::NORTH;
+    case COMMANDS::EAST_RIGHT:
+    case COMMANDS::EAST_LEFT:
+    case COMMANDS::EAST_SPIN:
+      return LEAF::EAST;
+    case COMMANDS::WEST_RIGHT:
+    case COMMANDS::WEST_LEFT:
+    case COMMANDS::WEST_SPIN:
+      return LEAF::WEST;
+    default:
+      return LEAF::INVALID;
+  }
+}
+
+LEAF
+DiscreteMoves::opposite_leaf(LEAF leaf)
+{
+  switch (leaf) {
+    case LEAF::NORTH:
+      return LEAF::NORTH;
+    case LEAF::EAST:
+      return LEAF::WEST;
+    case LEAF::WEST:
+      return LEAF::EAST;
+    default:
+      return LEAF::INVALID;
+  }
+}
+
+} // namespace puzzle
@@ -0,0 +1,131 @@
+#ifndef SPIN_DISCRETE_MOVES_H
+#define SPIN_DISCRETE_MOVES_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "spin_puzzle_definitions.h"
+
+namespace puzzle {
+
+/**
+ * @brief Precomputed tables to apply \ref COMMANDS as permutations.
+ *
+ * When both sides of a game are in a discrete configuration (see
+ * \ref SpinPuzzleSide::is_discrete ) every command moves the marbles by a
+ * fixed permutation. The permutations are expressed on the *logical layout*
+ * of the game: 60 positions, where position
+ * \code{.cpp}
+ *    30 * side + 10 * leaf + i
+ * \endcode
+ * is the i-th marble of the leaf starting from
+ * \ref SpinPuzzleSide::begin(LEAF) .
+ *
+ * A permutation `p` maps the layout `in` into the layout `out` as
+ * \code{.cpp}
+ *    out[i] = in[p[i]]
+ * \endcode
+ * so that applying a command is a single gather (see \ref apply ).
+ *
+ * @note the commands that do not move any marble (INTERNAL_LEFT,
+ * INTERNAL_RIGHT and SWAP_SIDE) have the identity as permutation.
+ */
+class DiscreteMoves
+{
+public:
+  //!< number of marbles in a leaf
+  static constexpr std::size_t GROUP_SIZE = 10;
+  //!< number of marbles in a side
+  static constexpr std::size_t SIDE_SIZE = 3 * GROUP_SIZE;
+  //!< number of positions in the logical layout
+  static constexpr std::size_t N_POSITIONS = 2 * SIDE_SIZE;
+  //!< number of marbles swapped by a spin
+  static constexpr std::size_t N_SPIN = 5;
+
+  //!< maximum number of positions moved by a command
+  static constexpr std::size_t N_MOVED = GROUP_SIZE;
+
+  using Permutation = std::array<uint8_t, N_POSITIONS>;
+
+  /**
+   * @brief Sparse form of a permutation: only the moved positions.
+   *
+   * out[target[n]] = in[source[n]] for n in [0, N_MOVED); the unused
+   * entries map a position that is not moved into itself.
+   */
+  struct Moves
+  {
+    std::array<uint8_t, N_MOVED> target;
+    std::array<uint8_t, N_MOVED> source;
+  };
+
+  /**
+   * @brief  permutation of the logical layout for a command
+   * @param  active_side: side the command is applied to
+   * @param  command: command to apply
+   * @retval permutation, see \ref DiscreteMoves
+   */
+  static const Permutation& permutation(SIDE active_side, COMMANDS command);
+
+  //!< sparse form of \ref permutation
+  static const Moves& moves(SIDE active_side, COMMANDS command);
+
+  /**
+   * @brief  apply the moves of a command to a logical layout in place
+   * @param  moves: moves to apply
+   * @param  layout: pointer to the \ref N_POSITIONS elements of a layout
+   */
+  template<typename T>
+  static void apply(const Moves& moves, T* layout)
+  {
+    T moved[N_MOVED];
+    for (std::size_t n = 0; n < N_MOVED; ++n) {
+      moved[n] = layout[moves.source[n]];
+    }
+    for (std::size_t n = 0; n < N_MOVED; ++n) {
+      layout[moves.target[n]] = moved[n];
+    }
+  }
+
+  /**
+   * @brief  offsets (in the marble array of a leaf) of the marbles swapped
+   *         by a spin
+   * @param  step: number of \ref SpinPuzzleSide::STEP the leaf is shifted by
+   * @retval offsets of the logical positions 1..5 of the leaf
+   */
+  static const std::array<uint8_t, N_SPIN>& spin_offsets(std::size_t step);
+
+  //!< leaf moved by a command (\ref LEAF::INVALID if no leaf is moved)
+  static LEAF leaf(COMMANDS command);
+
+  //!< leaf of the opposite side exchanged by a spin
+  static LEAF opposite_leaf(LEAF leaf);
+
+  //!< logical position of the i-th marble of a leaf
+  static constexpr std::size_t position(SIDE side, LEAF leaf, std::size_t i)
+  {
+    return SIDE_SIZE * static_cast<std::size_t>(side) +
+           GROUP_SIZE * static_cast<std::size_t>(leaf) + i;
+  }
+
+  /**
+   * @brief  apply a permutation to a logical layout
+   * @param  permutation: permutation to apply
+   * @param  in: layout to permute
+   * @param  out: permuted layout (must not alias in)
+   */
+  template<typename T>
+  static void apply(const Permutation& permutation,
+                    const std::array<T, N_POSITIONS>& in,
+                    std::array<T, N_POSITIONS>& out)
+  {
+    for (std::size_t n = 0; n < N_POSITIONS; ++n) {
+      out[n] = in[permutation[n]];
+    }
+  }
+};
+
+} // namespace puzzle
+
+#endif // SPIN_DISCRETE_MOVES_H
@@ -0,0 +1,69 @@
+#include "spin_event_bus.h"
+
+#include <algorithm>
+
+namespace puzzle {
+
+EventQueue::EventQueue(std::size_t log2_capacity)
+  : m_mask((std::size_t{ 1 } << log2_capacity) - 1)
+  , m_messages(new Message[m_mask + 1])
+{
+}
+
+bool
+EventQueue::push(const Message& message)
+{
+  const std::size_t head = m_head.load(std::memory_order_relaxed);
+  if (head - m_tail_cache > m_mask) {
+    m_tail_cache = m_tail.load(std::memory_order_acquire);
+    if (head - m_tail_cache > m_mask) {
+      m_dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+  }
+  m_messages[head & m_mask] = message;
+  m_head.store(head + 1, std::memory_order_release);
+  return true;
+}
+
+bool
+EventQueue::pop(Message& message)
+{
+  const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+  if (tail == m_head_cache) {
+    m_head_cache = m_head.load(std::memory_order_acquire);
+    if (tail == m_head_cache) {
+      return false;
+    }
+  }
+  message = m_messages[tail & m_mask];
+  m_tail.store(tail + 1, std::memory_order_release);
+  return true;
+}
+
+std::shared_ptr<EventQueue>
+EventBus::subscribe(std::size_t log2_capacity)
+{
+  m_queues.push_back(std::make_shared<EventQueue>(log2_capacity));
+  return m_queues.back();
+}
+
+void
+EventBus::unsubscribe(const std::shared_ptr<EventQueue>& queue)
+{
+  m_queues.erase(std::remove(m_queues.begin(), m_queues.end(), queue),
+                 m_queues.end());
+}
+
+void
+EventBus::publish(const Recorder::Event& event)
+{
+  EventQueue::Message message;
+  message.event = event;
+  message.sequence = m_sequence++;
+  for (const auto& queue : m_queues) {
+    queue->push(message);
+  }
+}
+
+} // namespace puzzle
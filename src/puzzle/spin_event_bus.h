@@ -0,0 +1,137 @@
+#ifndef SPIN_EVENT_BUS_H
+#define SPIN_EVENT_BUS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "spin_game_recorder.h"
+
+namespace puzzle {
+
+/**
+ * @brief Lock-free queue of the actions of a game for a single consumer.
+ *
+ * A ring of fixed-size messages with a single producer (the thread of the
+ * game) and a single consumer. The two threads only share the atomic
+ * indices of the ring, each on its own cache line, and each keeps a copy
+ * of the index of the other one so that it reads it only when the ring
+ * looks full (or empty). The producer never waits: a message that does not
+ * fit is dropped and counted (see \ref dropped ), the sequence numbers of
+ * the messages tell the consumer where the gap is.
+ */
+class EventQueue
+{
+public:
+  //!< action of the game and its number in the bus
+  struct Message
+  {
+    Recorder::Event event;
+    uint32_t sequence;
+  };
+
+  /**
+   * @brief  create an empty queue
+   * @param  log2_capacity: the queue holds 2^log2_capacity messages
+   */
+  explicit EventQueue(std::size_t log2_capacity = 12);
+
+  /**
+   * @brief  append a message (producer only)
+   * @param  message: message to append
+   * @retval false if the queue is full, the message is dropped
+   */
+  bool push(const Message& message);
+
+  /**
+   * @brief  take the oldest message (consumer only)
+   * @param  message: message taken
+   * @retval false if the queue is empty
+   */
+  bool pop(Message& message);
+
+  /**
+   * @brief  take all the messages available (consumer only)
+   * @param  f: function called with every message, in order
+   * @retval number of messages taken
+   */
+  template<typename F>
+  std::size_t drain(F&& f)
+  {
+    const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+    m_head_cache = m_head.load(std::memory_order_acquire);
+    for (std::size_t n = tail; n != m_head_cache; ++n) {
+      f(static_cast<const Message&>(m_messages[n & m_mask]));
+    }
+    m_tail.store(m_head_cache, std::memory_order_release);
+    return m_head_cache - tail;
+  }
+
+  //!< number of messages the queue can hold
+  std::size_t capacity() const { return m_mask + 1; }
+
+  //!< number of messages dropped because the queue was full
+  uint64_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+private:
+  std::size_t m_mask;
+  std::unique_ptr<Message[]> m_messages;
+  //!< next message to write: written by the producer
+  alignas(64) std::atomic<std::size_t> m_head{ 0 };
+  //!< last value of m_tail read by the producer
+  std::size_t m_tail_cache = 0;
+  //!< next message to read: written by the consumer
+  alignas(64) std::atomic<std::size_t> m_tail{ 0 };
+  //!< last value of m_head read by the consumer
+  std::size_t m_head_cache = 0;
+  alignas(64) std::atomic<uint64_t> m_dropped{ 0 };
+};
+
+/**
+ * @brief Fan-out of the actions of a game to consumers on other threads.
+ *
+ * A game with a bus attached (see \ref SpinPuzzleGame::attach_event_bus )
+ * publishes every action as a \ref Recorder::Event , with its angle rounded
+ * to 1/ANGLE_SCALE degree as the game does before applying it (see
+ * \ref SpinPuzzleSide::round_angle ). Every consumer (recorder, autosave,
+ * analytics, network feed, ...) subscribes with its own \ref EventQueue and
+ * drains it on its thread, e.g. applying the events to a copy of the game
+ * with \ref Recorder::apply : the thread of the game only copies the event
+ * in the queues.
+ *
+ * @note \ref subscribe and \ref unsubscribe must be called from the thread
+ *       of the game.
+ */
+class EventBus
+{
+public:
+  /**
+   * @brief  add a consumer
+   * @param  log2_capacity: the queue holds 2^log2_capacity messages
+   * @retval queue of the consumer, it receives the events published from
+   *         now on
+   */
+  std::shared_ptr<EventQueue> subscribe(std::size_t log2_capacity = 12);
+
+  //!< remove a consumer, the queue is no more filled
+  void unsubscribe(const std::shared_ptr<EventQueue>& queue);
+
+  //!< send an event to every consumer (thread of the game only)
+  void publish(const Recorder::Event& event);
+
+  //!< number of consumers
+  std::size_t subscribers() const { return m_queues.size(); }
+
+  //!< number of events published
+  uint32_t published() const { return m_sequence; }
+
+private:
+  std::vector<std::shared_ptr<EventQueue>> m_queues;
+  uint32_t m_sequence = 0;
+};
+
+} // namespace puzzle
+
+#endif // SPIN_EVENT_BUS_H
@@ -0,0 +1,98 @@
+#include "spin_game_reader.h"
+
+#include <cstring>
+
+#include "spin_puzzle_game.h"
+
+namespace puzzle {
+
+namespace {
+
+bool
+is_blank(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+} // namespace
+
+GameReader::GameReader(std::FILE* file)
+  : m_file(file)
+  , m_buffer(BLOCK_SIZE)
+{
+  const long position = std::ftell(file);
+  if (position > 0) {
+    m_offset = static_cast<std::size_t>(position);
+  }
+}
+
+bool
+GameReader::read(SpinPuzzleGame& game)
+{
+  m_failed = false;
+  // skip the blank lines
+  for (;;) {
+    while (m_begin != m_end && is_blank(m_buffer[m_begin])) {
+      consume(1);
+    }
+    if (m_begin != m_end) {
+      break;
+    }
+    if (!fill()) {
+      return false;
+    }
+  }
+  // the game ends with the line (or with the file)
+  const char* eol = nullptr;
+  for (;;) {
+    eol = static_cast<const char*>(
+      std::memchr(&m_buffer[m_begin], '\n', m_end - m_begin));
+    if (eol || !fill()) {
+      break;
+    }
+  }
+  const char* data = &m_buffer[m_begin];
+  const std::size_t size = eol ? eol - data + 1 : m_end - m_begin;
+  std::size_t error = 0;
+  if (game.load_text(data, size, &error) == 0) {
+    m_failed = true;
+    m_error_offset = m_offset + error;
+    m_error_line = m_line;
+    m_error_column = error + 1;
+    consume(size);
+    return false;
+  }
+  consume(size);
+  ++m_games;
+  return true;
+}
+
+bool
+GameReader::fill()
+{
+  if (m_begin > 0) {
+    std::memmove(m_buffer.data(), &m_buffer[m_begin], m_end - m_begin);
+    m_end -= m_begin;
+    m_begin = 0;
+  }
+  // a game longer than the buffer
+  if (m_end == m_buffer.size()) {
+    m_buffer.resize(m_buffer.size() + BLOCK_SIZE);
+  }
+  const std::size_t n =
+    std::fread(&m_buffer[m_end], 1, m_buffer.size() - m_end, m_file);
+  m_end += n;
+  return n > 0;
+}
+
+void
+GameReader::consume(std::size_t size)
+{
+  if (size > 0 && m_buffer[m_begin + size - 1] == '\n') {
+    ++m_line;
+  }
+  m_begin += size;
+  m_offset += size;
+}
+
+} // namespace puzzle
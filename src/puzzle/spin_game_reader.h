@@ -0,0 +1,93 @@
+#ifndef SPIN_GAME_READER_H
+#define SPIN_GAME_READER_H
+
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+
+namespace puzzle {
+
+class SpinPuzzleGame;
+
+/**
+ * @brief Reader of the games stored by \ref SpinPuzzleGame::serialize in a
+ * file.
+ *
+ * The file is read in blocks of \ref BLOCK_SIZE bytes and every game (one
+ * line of text) is parsed from the block with
+ * \ref SpinPuzzleGame::load_text . Blank lines are skipped. An invalid game
+ * does not stop the reader: \ref read returns false, the position of the
+ * error is kept (see \ref error_offset ) and the next call goes on with the
+ * following line.
+ *
+ * @note the reader owns the bytes it has read from the file: the position
+ * of the file is \ref unread bytes after the last game read.
+ */
+class GameReader
+{
+public:
+  //!< bytes read from the file at once
+  static constexpr std::size_t BLOCK_SIZE = 64 * 1024;
+
+  /**
+   * @brief  create a reader from the current position of a file
+   * @param  file: file to read, it must stay open while reading
+   */
+  explicit GameReader(std::FILE* file);
+
+  /**
+   * @brief  load the next game
+   * @param  game: game to load, it is left untouched if no valid game is
+   *         found
+   * @retval false at the end of the file or if the game is not valid (see
+   *         \ref failed )
+   */
+  bool read(SpinPuzzleGame& game);
+
+  //!< check if the last \ref read has found an invalid game
+  bool failed() const { return m_failed; }
+
+  //!< offset in the file of the first invalid character of the last game
+  std::size_t error_offset() const { return m_error_offset; }
+
+  //!< line (starting from 1) of the last invalid game
+  std::size_t error_line() const { return m_error_line; }
+
+  //!< column (starting from 1) of the first invalid character
+  std::size_t error_column() const { return m_error_column; }
+
+  //!< offset in the file of the next game
+  std::size_t offset() const { return m_offset; }
+
+  //!< number of games read
+  std::size_t games() const { return m_games; }
+
+  //!< bytes read from the file and not used yet
+  std::size_t unread() const { return m_end - m_begin; }
+
+private:
+  //!< read the next block of the file
+  //!< @retval false at the end of the file
+  bool fill();
+
+  //!< use the given bytes of the buffer
+  void consume(std::size_t size);
+
+  std::FILE* m_file;
+  std::vector<char> m_buffer;
+  //!< bytes of \ref m_buffer read and not used yet
+  std::size_t m_begin = 0;
+  std::size_t m_end = 0;
+  //!< offset in the file and line of m_buffer[m_begin]
+  std::size_t m_offset = 0;
+  std::size_t m_line = 1;
+  std::size_t m_games = 0;
+  bool m_failed = false;
+  std::size_t m_error_offset = 0;
+  std::size_t m_error_line = 0;
+  std::size_t m_error_column = 0;
+};
+
+} // namespace puzzle
+
+#endif // SPIN_GAME_READER_H
@@ -1,24 +1,150 @@
 #include "spin_game_recorder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
 #include "spin_puzzle_game.h"
 
 namespace puzzle {
 
+namespace {
+
+//!< current time in milliseconds
+size_t
+now()
+{
+#ifdef QSPIN_PUZZLE_RECORD_TIMES
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+           std::chrono::system_clock::now().time_since_epoch())
+    .count();
+#else
+  return 0;
+#endif
+}
+
+constexpr char MAGIC[4] = { 'S', 'P', 'R', 'C' };
+
+//!< a serialized game takes less than a kilobyte: a larger size is corrupted
+constexpr uint64_t MAX_GAME_SIZE = 1 << 16;
+
+//!< append an unsigned integer in 7-bit groups, least significant first
 void
-Recorder::rotate_marbles(LEAF leaf, double angle)
+write_varint(std::string& out, uint64_t value)
+{
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+bool
+read_varint(std::istream& in, uint64_t& value)
+{
+  value = 0;
+  for (unsigned shift = 0; shift < 64; shift += 7) {
+    const int byte = in.get();
+    if (byte == std::char_traits<char>::eof()) {
+      return false;
+    }
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+//!< signed integers with small magnitude take few bytes
+uint64_t
+zigzag(int32_t value)
+{
+  const auto bits = static_cast<uint32_t>(value);
+  return (bits << 1) ^ (value < 0 ? 0xffffffffu : 0u);
+}
+
+int32_t
+unzigzag(uint64_t value)
+{
+  const auto bits = static_cast<uint32_t>(value);
+  return static_cast<int32_t>((bits >> 1) ^ (0u - (bits & 1u)));
+}
+
+//!< bytes left to read in a stream, MAX_GAME_SIZE if it cannot seek
+uint64_t
+remaining(std::istream& in)
+{
+  const auto position = in.tellg();
+  if (position == std::streampos(-1) || !in.seekg(0, std::ios::end)) {
+    in.clear();
+    return MAX_GAME_SIZE;
+  }
+  const auto end = in.tellg();
+  in.seekg(position);
+  return static_cast<uint64_t>(end - position);
+}
+
+//!< the type and the leaf of an event read from a file are in range
+bool
+valid_code(int code)
 {
-  m_events.emplace_back(EventType::ROTATE_MARBLES, angle, leaf);
+  return (code & 0x7) <= static_cast<int>(Recorder::EventType::SWAP_SIDE) &&
+         (code >> 3) <= static_cast<int>(LEAF::INVALID);
 }
 
+//!< append the header of the binary format up to the start game
 void
-Recorder::rotate_internal_disk(double angle)
+write_header(std::string& out, uint32_t version, const std::string& game)
 {
-  m_events.emplace_back(EventType::ROTATE_INTERNAL_DISK, angle);
+  out.append(MAGIC, sizeof(MAGIC));
+  write_varint(out, version);
+  write_varint(out, game.size());
+  out.append(game);
 }
 
+//!< append an event and the milliseconds from the previous one
 void
+write_event(std::string& out, const Recorder::Event& event, uint64_t elapsed)
+{
+  out.push_back(static_cast<char>(event.code()));
+  write_varint(out, zigzag(event.fixed_angle()));
+  write_varint(out, elapsed);
+}
+
+} // namespace
+
+double
+Recorder::rotate_marbles(LEAF leaf, double angle)
+{
+  return rotate_marbles(leaf, angle, false);
+}
+
+double
+Recorder::rotate_marbles(LEAF leaf, double angle, bool additive)
+{
+  const Event event(EventType::ROTATE_MARBLES, angle, leaf);
+  const size_t time = now();
+  if (!additive || !merge(event, time)) {
+    add(event, time);
+    m_mergeable = additive;
+    m_merge_start = time;
+  }
+  return event.angle();
+}
+
+double
+Recorder::rotate_internal_disk(double angle)
+{
+  add(Event(EventType::ROTATE_INTERNAL_DISK, angle), now());
+  return m_events.back().angle();
+}
+
+double
 Recorder::spin_leaf(LEAF leaf, double angle)
 {
-  m_events.emplace_back(EventType::SPIN_LEAF, angle, leaf);
+  add(Event(Event::spin_type(angle), angle, leaf), now());
+  return m_events.back().angle();
 }
 
 void
@@ -30,21 +156,217 @@ Recorder::spin_leaf(LEAF leaf)
 void
 Recorder::swap_side()
 {
-  m_events.emplace_back(EventType::SWAP_SIDE);
+  add(Event(EventType::SWAP_SIDE), now());
 }
 void
 Recorder::reset()
+{
+  clear_events();
+}
+
+void
+Recorder::clear_events()
 {
   m_events.clear();
+  m_times.clear();
+  m_start_time = 0;
+  m_keyframes.clear();
+  m_mergeable = false;
+  m_streamed = 0;
+  m_streamed_time = 0;
+  m_dropped = 0;
+}
+
+void
+Recorder::add(const Event& event, size_t time)
+{
+  if (m_events.empty() && m_streamed == 0) {
+    m_start_time = time;
+  }
+  if (m_stream) {
+    // the events recorded so far can not be merged any more
+    write_stream(m_events.size());
+  }
+  const uint32_t last = m_times.empty() ? m_streamed_time : m_times.back();
+  m_events.emplace_back(event);
+  m_times.push_back(std::max(last, elapsed(time)));
+  m_mergeable = false;
+  trim_window();
+}
+
+void
+Recorder::set_window(size_t events, size_t time)
+{
+  m_window_events = events;
+  m_window_time = time;
+  if (events > 0) {
+    m_events.reserve(events + 1);
+    m_times.reserve(events + 1);
+  }
+  trim_window();
+}
+
+void
+Recorder::trim_window()
+{
+  if (m_events.empty() || m_stream) {
+    return;
+  }
+  size_t n = 0;
+  if (m_window_events > 0 && m_events.size() > m_window_events) {
+    n = m_events.size() - m_window_events + m_window_events / 8;
+  }
+  if (m_window_time > 0 && m_times.back() - m_times.front() > m_window_time) {
+    const size_t first = m_times.back() - m_window_time + m_window_time / 8;
+    const auto kept = std::lower_bound(m_times.begin(), m_times.end(), first);
+    n = std::max<size_t>(n, kept - m_times.begin());
+  }
+  // the last event can still be merged
+  n = std::min(n, m_events.size() - 1);
+  if (n == 0) {
+    return;
+  }
+
+  if (has_start_game()) {
+    // the start game becomes the game before the first event kept, written
+    // with all the digits of the angles
+    SpinPuzzleGame game;
+    game.load(m_start_game);
+    for (size_t i = 0; i < n; ++i) {
+      apply(game, m_events[i]);
+    }
+    std::stringstream start;
+    start << std::setprecision(std::numeric_limits<double>::max_digits10);
+    game.serialize(start);
+    m_start_game.str("");
+    m_start_game.clear();
+    m_start_game << start.str();
+  }
+
+  const uint32_t first_time = m_times[n];
+  m_start_time += first_time;
+  m_events.erase(m_events.begin(), m_events.begin() + n);
+  m_times.erase(m_times.begin(), m_times.begin() + n);
+  for (auto& time : m_times) {
+    time -= first_time;
+  }
+  m_streamed_time = 0;
+  m_merge_start = std::max(m_merge_start, m_start_time);
+  m_dropped += n;
+  // the keyframes after the first event kept are still valid
+  auto keyframe = m_keyframes.begin();
+  while (keyframe != m_keyframes.end() && keyframe->event < n) {
+    ++keyframe;
+  }
+  m_keyframes.erase(m_keyframes.begin(), keyframe);
+  for (auto& kept : m_keyframes) {
+    kept.event -= n;
+  }
+  m_current = m_events.end();
+}
+
+void
+Recorder::write_stream(size_t n)
+{
+  if (n == 0) {
+    return;
+  }
+  for (size_t i = 0; i < n; ++i) {
+    m_stream->write(m_events[i], m_start_time + m_times[i]);
+  }
+  m_streamed += n;
+  m_streamed_time = m_times[n - 1];
+  m_events.erase(m_events.begin(), m_events.begin() + n);
+  m_times.erase(m_times.begin(), m_times.begin() + n);
+  m_keyframes.clear();
+  m_current = m_events.end();
+}
+
+uint32_t
+Recorder::elapsed(size_t time) const
+{
+  if (time <= m_start_time) {
+    return 0;
+  }
+  constexpr size_t MAX = std::numeric_limits<uint32_t>::max();
+  return static_cast<uint32_t>(std::min(time - m_start_time, MAX));
+}
+
+bool
+Recorder::merge(const Event& event, size_t time)
+{
+  if (m_coalescing == 0 || !m_mergeable || m_events.empty() ||
+      m_events.back().code() != event.code() ||
+      (time > m_merge_start && time - m_merge_start > m_coalescing)) {
+    return false;
+  }
+  // keep the angle within a turn, far from the limits of the fixed point
+  constexpr int64_t TURN = 360 * Event::ANGLE_SCALE;
+  const int64_t angle = static_cast<int64_t>(m_events.back().fixed_angle()) +
+                        event.fixed_angle();
+  if (angle < -TURN || angle > TURN) {
+    return false;
+  }
+  m_events.back() =
+    Event::from_code(event.code(), static_cast<int32_t>(angle));
+  m_times.back() = std::max(m_times.back(), elapsed(time));
+  // a keyframe after the last event is no more valid
+  while (!m_keyframes.empty() &&
+         m_keyframes.back().event >= m_events.size()) {
+    m_keyframes.pop_back();
+  }
+  return true;
 }
 
 void
 Recorder::rec(const SpinPuzzleGame& game)
 {
+  close_stream();
+  m_keyframes.clear();
+  m_mergeable = false;
   game.serialize(m_start_game);
   m_recording = true;
 }
 
+bool
+Recorder::rec(const SpinPuzzleGame& game, const std::string& path)
+{
+  rec(game);
+  auto stream = std::make_shared<RecordStream>();
+  if (!stream->open(path, m_start_game.str())) {
+    return false;
+  }
+  m_stream = stream;
+  return true;
+}
+
+Recorder::~Recorder()
+{
+  close_stream();
+}
+
+void
+Recorder::stop()
+{
+  if (!m_recording) {
+    return;
+  }
+  close_stream();
+  m_start_game.seekg(0, std::ios::beg);
+  m_recording = false;
+}
+
+void
+Recorder::close_stream()
+{
+  if (!m_stream) {
+    return;
+  }
+  write_stream(m_events.size());
+  m_stream->close();
+  m_stream.reset();
+}
+
 void
 Recorder::replay(SpinPuzzleGame& game)
 {
@@ -65,34 +387,16 @@ Recorder::serialize(std::FILE* file) const
 size_t
 Recorder::play(SpinPuzzleGame& game, size_t time)
 {
-  auto start_time = m_current->time();
-  for (; m_current != m_events.end(); ++m_current) {
-    const Event& event = *m_current;
-    switch (event.type()) {
-      case Recorder::EventType::ROTATE_MARBLES:
-        game.rotate_marbles(event.leaf(), event.angle());
-        break;
-      case Recorder::EventType::ROTATE_INTERNAL_DISK:
-        game.rotate_internal_disk(event.angle());
-        break;
-      case Recorder::EventType::SPIN_LEAF_ANGLE:
-        game.spin_leaf(event.leaf(), event.angle());
-        break;
-      case Recorder::EventType::SPIN_LEAF:
-        game.spin_leaf(event.leaf());
-        break;
-      case Recorder::EventType::SWAP_SIDE:
-        game.swap_side();
-        break;
-      default:
-        break;
-    }
-    if (m_current->time() - start_time >= time) {
-      ++m_current;
-      break;
-    }
+  if (isEnd()) {
+    return size();
   }
-  return m_current - m_events.begin();
+  // up to the first event at the given time from the current one, included
+  const size_t start_time = m_times[current()];
+  const auto last = std::lower_bound(
+    m_times.begin() + current(), m_times.end(), start_time + time);
+  const size_t end = std::min<size_t>(last - m_times.begin() + 1, size());
+  play(game, m_current, m_events.begin() + end);
+  return current();
 }
 
 void
@@ -102,29 +406,58 @@ Recorder::play(SpinPuzzleGame& game,
 {
   for (m_current = begin; m_current != end && m_current != m_events.end();
        ++m_current) {
-    const Event& event = *m_current;
-    switch (event.type()) {
-      case Recorder::EventType::ROTATE_MARBLES:
-        game.rotate_marbles(event.leaf(), event.angle());
-        break;
-      case Recorder::EventType::ROTATE_INTERNAL_DISK:
-        game.rotate_internal_disk(event.angle());
-        break;
-      case Recorder::EventType::SPIN_LEAF_ANGLE:
-        game.spin_leaf(event.leaf(), event.angle());
-        break;
-      case Recorder::EventType::SPIN_LEAF:
-        game.spin_leaf(event.leaf());
-        break;
-      case Recorder::EventType::SWAP_SIDE:
-        game.swap_side();
-        break;
-      default:
-        break;
-    }
+    apply(game, *m_current);
+    update_keyframes(game, m_current - m_events.begin() + 1);
+  }
+}
+
+void
+Recorder::apply(SpinPuzzleGame& game, const Event& event)
+{
+  switch (event.type()) {
+    case Recorder::EventType::ROTATE_MARBLES:
+      game.rotate_marbles(event.leaf(), event.angle());
+      break;
+    case Recorder::EventType::ROTATE_INTERNAL_DISK:
+      game.rotate_internal_disk(event.angle());
+      break;
+    case Recorder::EventType::SPIN_LEAF_ANGLE:
+      game.spin_leaf(event.leaf(), event.angle());
+      break;
+    case Recorder::EventType::SPIN_LEAF:
+      game.spin_leaf(event.leaf());
+      break;
+    case Recorder::EventType::SWAP_SIDE:
+      game.swap_side();
+      break;
+    default:
+      break;
   }
 }
 
+void
+Recorder::update_keyframes(const SpinPuzzleGame& game, size_t played)
+{
+  const size_t last = m_keyframes.empty() ? 0 : m_keyframes.back().event;
+  if (played <= last) {
+    return;
+  }
+  const size_t elapsed = m_times[played - 1] - m_times[last > 0 ? last - 1 : 0];
+  if (!(m_keyframe_events > 0 && played - last >= m_keyframe_events) &&
+      !(m_keyframe_time > 0 && elapsed >= m_keyframe_time)) {
+    return;
+  }
+  Keyframe keyframe{ played, false, {}, {} };
+  keyframe.packed = keyframe.state.pack(game);
+  if (!keyframe.packed) {
+    // e.g. spin rotations that are not a whole number of ticks
+    std::stringstream s;
+    game.serialize(s);
+    keyframe.game = s.str();
+  }
+  m_keyframes.emplace_back(std::move(keyframe));
+}
+
 bool
 Recorder::step_forward(SpinPuzzleGame& game, size_t steps)
 {
@@ -151,25 +484,271 @@ Recorder::rewind(SpinPuzzleGame& game)
   m_current = m_events.begin();
 }
 
+bool
+Recorder::has_start_game()
+{
+  m_start_game.seekg(0, std::ios::end);
+  const auto size = m_start_game.tellg();
+  m_start_game.seekg(0, std::ios::beg);
+  return size > 0;
+}
+
+bool
+Recorder::seek(SpinPuzzleGame& game, size_t event)
+{
+  if (event > m_events.size() || !has_start_game()) {
+    return false;
+  }
+  // last keyframe up to the event
+  auto keyframe = std::upper_bound(
+    m_keyframes.begin(),
+    m_keyframes.end(),
+    event,
+    [](size_t event, const Keyframe& keyframe) {
+      return event < keyframe.event;
+    });
+  if (keyframe == m_keyframes.begin()) {
+    rewind(game);
+  } else {
+    --keyframe;
+    if (keyframe->packed) {
+      keyframe->state.unpack(game);
+    } else {
+      std::stringstream s(keyframe->game);
+      game.load(s);
+    }
+    m_current = m_events.begin() + keyframe->event;
+  }
+  play(game, m_current, m_events.begin() + event);
+  return true;
+}
+
+bool
+Recorder::seek_time(SpinPuzzleGame& game, size_t time)
+{
+  const auto end = std::upper_bound(m_times.begin(), m_times.end(), time);
+  return seek(game, end - m_times.begin());
+}
+
+std::pair<size_t, size_t>
+Recorder::time_range(size_t begin, size_t end) const
+{
+  const auto first = std::lower_bound(m_times.begin(), m_times.end(), begin);
+  const auto last = std::lower_bound(first, m_times.end(), end);
+  return { first - m_times.begin(), last - m_times.begin() };
+}
+
+void
+Recorder::serialize_binary(std::ostream& out) const
+{
+  std::string bytes;
+  write_header(bytes, BINARY_VERSION, m_start_game.str());
+  write_varint(bytes, m_events.size());
+  write_varint(bytes, m_start_time);
+  uint32_t time = 0;
+  for (size_t n = 0; n < m_events.size(); ++n) {
+    write_event(bytes, m_events[n], m_times[n] - time);
+    time = m_times[n];
+  }
+  out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+bool
+Recorder::load_binary(std::istream& in)
+{
+  char magic[sizeof(MAGIC)];
+  uint64_t version = 0;
+  uint64_t game_size = 0;
+  if (!in.read(magic, sizeof(magic)) ||
+      !std::equal(magic, magic + sizeof(magic), MAGIC) ||
+      !read_varint(in, version) ||
+      (version != BINARY_VERSION && version != STREAM_VERSION) ||
+      !read_varint(in, game_size) ||
+      game_size > std::min(remaining(in), MAX_GAME_SIZE)) {
+    return false;
+  }
+  std::string game(game_size, '\0');
+  if (!in.read(&game[0], static_cast<std::streamsize>(game_size))) {
+    return false;
+  }
+  // a stream has no count: the events go up to the end of the file and the
+  // first one holds the time of the start
+  const bool stream = (version == STREAM_VERSION);
+  uint64_t size = std::numeric_limits<uint64_t>::max();
+  uint64_t start_time = 0;
+  if (!stream && (!read_varint(in, size) || !read_varint(in, start_time))) {
+    return false;
+  }
+  // the whole file is read before the recorder is changed
+  std::vector<Event> events;
+  std::vector<size_t> times;
+  size_t time = start_time;
+  for (uint64_t n = 0; n < size; ++n) {
+    const int code = in.get();
+    if (stream && code == std::char_traits<char>::eof()) {
+      break;
+    }
+    uint64_t angle = 0;
+    uint64_t elapsed = 0;
+    if (code == std::char_traits<char>::eof() || !read_varint(in, angle) ||
+        !read_varint(in, elapsed)) {
+      if (stream) {
+        // the last event has been truncated by a crash
+        break;
+      }
+      return false;
+    }
+    if (!valid_code(code)) {
+      return false;
+    }
+    time += elapsed;
+    events.push_back(
+      Event::from_code(static_cast<uint8_t>(code), unzigzag(angle)));
+    times.push_back(time);
+  }
+  clear_events();
+  // the start game is needed by the window while the events are added
+  m_start_game.str("");
+  m_start_game.clear();
+  m_start_game << game;
+  for (size_t n = 0; n < events.size(); ++n) {
+    add(events[n], times[n]);
+  }
+  m_current = m_events.end();
+  return true;
+}
+
+RecordStream::RecordStream(size_t flush_interval)
+  : m_flush_interval(flush_interval)
+{
+}
+
+RecordStream::~RecordStream()
+{
+  close();
+}
+
+bool
+RecordStream::open(const std::string& path, const std::string& game)
+{
+  close();
+  m_file = std::fopen(path.c_str(), "wb");
+  if (!m_file) {
+    return false;
+  }
+  // the header is written at once: an empty recording is a valid file
+  std::string header;
+  write_header(header, Recorder::STREAM_VERSION, game);
+  if (std::fwrite(header.data(), 1, header.size(), m_file) != header.size() ||
+      std::fflush(m_file) != 0) {
+    std::fclose(m_file);
+    m_file = nullptr;
+    return false;
+  }
+  m_closing = false;
+  m_failed = false;
+  m_time = 0;
+  m_size = 0;
+  m_writer = std::thread(&RecordStream::run, this);
+  return true;
+}
+
+void
+RecordStream::write(const Recorder::Event& event, size_t time)
+{
+  if (!m_file) {
+    return;
+  }
+  std::unique_lock<std::mutex> lock(m_mutex);
+  // the caller waits only if the disk can not keep up with the events
+  m_drained.wait(lock, [this]() { return m_buffer.size() < MAX_BUFFER_SIZE; });
+  write_event(m_buffer, event, (time > m_time) ? time - m_time : 0);
+  m_time = std::max(m_time, time);
+  ++m_size;
+  if (m_buffer.size() >= BUFFER_SIZE) {
+    lock.unlock();
+    m_wake.notify_one();
+  }
+}
+
+bool
+RecordStream::close()
+{
+  if (!m_file) {
+    return true;
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_closing = true;
+  }
+  m_wake.notify_one();
+  m_writer.join();
+  const bool ok = (std::fclose(m_file) == 0) && !m_failed;
+  m_file = nullptr;
+  return ok;
+}
+
+void
+RecordStream::run()
+{
+  std::string pending;
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (true) {
+    m_wake.wait_for(lock, m_flush_interval, [this]() {
+      return m_closing || m_buffer.size() >= BUFFER_SIZE;
+    });
+    pending.swap(m_buffer);
+    const bool closing = m_closing;
+    lock.unlock();
+    m_drained.notify_all();
+    if (!pending.empty()) {
+      // flushed at every write: a crash loses at most a flush interval
+      if (std::fwrite(pending.data(), 1, pending.size(), m_file) !=
+            pending.size() ||
+          std::fflush(m_file) != 0) {
+        m_failed = true;
+      }
+      pending.clear();
+    }
+    if (closing) {
+      return;
+    }
+    lock.lock();
+  }
+}
+
 Recorder::EventType
 Recorder::Event::type() const
 {
-  return m_eventType;
+  return static_cast<EventType>(m_code & 0x7);
 }
 
 LEAF
 Recorder::Event::leaf() const
 {
-  return m_leaf;
+  return static_cast<LEAF>((m_code >> 3) & 0x7);
 }
+
 double
 Recorder::Event::angle() const
 {
-  return m_angle;
+  return static_cast<double>(m_angle) / ANGLE_SCALE;
 }
-size_t
-Recorder::Event::time() const
+
+Recorder::Event
+Recorder::Event::from_code(uint8_t code, int32_t fixed_angle)
 {
-  return m_time;
+  Event event;
+  event.m_code = code;
+  event.m_angle = fixed_angle;
+  return event;
+}
+
+int32_t
+Recorder::Event::quantize(double angle)
+{
+  constexpr double MAX = std::numeric_limits<int32_t>::max();
+  const double scaled = std::clamp(angle * ANGLE_SCALE, -MAX, MAX);
+  return static_cast<int32_t>(std::lround(scaled));
+}
 }
-}
\ No newline at end of file
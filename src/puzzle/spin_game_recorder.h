@@ -1,15 +1,27 @@
 #ifndef SPIN_PUZZLE_RECORDER_H
 #define SPIN_PUZZLE_RECORDER_H
 
+#include "spin_packed_state.h"
 #include "spin_puzzle_definitions.h"
+#include "spin_puzzle_side.h"
 #include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
 #include <iomanip>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
 namespace puzzle {
 
+class RecordStream;
 class SpinPuzzleGame;
 
 class Recorder
@@ -27,94 +39,149 @@ public:
   Recorder() = default;
   Recorder(const Recorder& recorder)
     : m_events(recorder.m_events)
+    , m_start_time(recorder.m_start_time)
+    , m_times(recorder.m_times)
     , m_current(recorder.m_current)
     , m_recording{ false }
+    , m_keyframes(recorder.m_keyframes)
+    , m_keyframe_events(recorder.m_keyframe_events)
+    , m_keyframe_time(recorder.m_keyframe_time)
+    , m_coalescing(recorder.m_coalescing)
+    , m_window_events(recorder.m_window_events)
+    , m_window_time(recorder.m_window_time)
+    , m_dropped(recorder.m_dropped)
   {
     m_start_game.clear();
     m_start_game << recorder.m_start_game.str();
   }
+  //!< write the last event to the file of \ref rec , if it is still open
+  ~Recorder();
 
+  /**
+   * @brief Event of a recording in 8 bytes.
+   *
+   * The type and the leaf share a byte, the angle is stored in fixed point
+   * with a resolution of 1/ANGLE_SCALE degree. The time of the event is kept
+   * by the \ref Recorder (see \ref time_range ).
+   */
   class Event
   {
   public:
+    //!< resolution of the angles: the one of the rotations of the game (see
+    //!< \ref SpinPuzzleSide::round_angle ), so that the events are exact
+    static constexpr int32_t ANGLE_SCALE = SpinPuzzleSide<10, 3>::ANGLE_SCALE;
+
     Event(EventType eventType, double angle = 0.0, LEAF leaf = LEAF::INVALID)
-      : m_eventType(eventType)
-      , m_angle(angle)
-      , m_leaf(leaf)
-#ifdef QSPIN_PUZZLE_RECORD_TIMES
-      , m_time(std::chrono::duration_cast<std::chrono::milliseconds>(
-                 std::chrono::system_clock::now().time_since_epoch())
-                 .count())
-#else
-      , m_time(0)
-#endif
+      : m_angle(quantize(angle))
+      , m_code(static_cast<uint8_t>(static_cast<uint8_t>(eventType) |
+                                    (static_cast<uint8_t>(leaf) << 3)))
     {
     }
     explicit Event() {}
     EventType type() const;
     LEAF leaf() const;
     double angle() const;
-    size_t time() const;
+
+    //!< angle in units of 1/ANGLE_SCALE degree
+    int32_t fixed_angle() const { return m_angle; }
+    //!< type (bits 0-2) and leaf (bits 3-5)
+    uint8_t code() const { return m_code; }
+    //!< build an event from \ref code and \ref fixed_angle
+    static Event from_code(uint8_t code, int32_t fixed_angle);
+
+    //!< type of the event of a spin: a complete spin (180 degree) is a
+    //!< SPIN_LEAF, whatever the action of the game that spins the leaf
+    static EventType spin_type(double angle)
+    {
+      return angle == 180.0 ? EventType::SPIN_LEAF : EventType::SPIN_LEAF_ANGLE;
+    }
+
+    //!< angle in degree rounded to the resolution of the events
+    static double round(double angle)
+    {
+      return SpinPuzzleSide<10, 3>::round_angle(angle);
+    }
 
     template<typename Buffer>
-    Buffer& serialize(Buffer& buffer, bool times = true) const
+    Buffer& serialize(Buffer& buffer, size_t time) const
     {
-      buffer << static_cast<int32_t>(m_eventType) << " "
+      buffer << static_cast<int32_t>(type()) << " "
              << std::setprecision(std::numeric_limits<double>::digits10)
-             << m_angle << " " << static_cast<int32_t>(m_leaf);
-      if (times) {
-        buffer << " " << m_time;
-      } else {
-        buffer << " " << 0;
-      }
+             << angle() << " " << static_cast<int32_t>(leaf()) << " " << time;
       buffer << "\n";
       return buffer;
     }
 
     template<typename Buffer>
-    void load(Buffer& buffer)
+    void load(Buffer& buffer, size_t& time)
     {
       int32_t type;
       int32_t leaf;
+      double angle;
       buffer >> type;
-      buffer >> m_angle;
+      buffer >> angle;
       buffer >> leaf;
-      buffer >> m_time;
-      m_eventType = static_cast<EventType>(type);
-      m_leaf = static_cast<LEAF>(leaf);
+      buffer >> time;
+      *this =
+        Event(static_cast<EventType>(type), angle, static_cast<LEAF>(leaf));
     }
 
   private:
-    EventType m_eventType;
-    LEAF m_leaf;
-    double m_angle;
-    size_t m_time;
+    int32_t m_angle = 0;
+    uint8_t m_code = 0;
+
+    static int32_t quantize(double angle);
   };
 
-  void rotate_marbles(LEAF leaf, double angle);
-  void rotate_internal_disk(double angle);
-  void spin_leaf(LEAF leaf, double angle);
+  //!< record an action, the returned angle is the one stored in the event
+  //!< (see \ref Event::round )
+  double rotate_marbles(LEAF leaf, double angle);
+
+  /**
+   * @brief  record a rotation of the marbles
+   * @note   with \ref set_coalescing the rotation is merged in the previous
+   *         event if both are additive, of the same leaf and within the
+   *         window of time
+   * @param  leaf: leaf to rotate
+   * @param  angle: angle to rotate
+   * @param  additive: the effect of the rotation on the game only depends on
+   *         the sum of the angles of consecutive additive rotations (i.e. a
+   *         rotation inside a leaf)
+   * @retval angle stored in the event
+   */
+  double rotate_marbles(LEAF leaf, double angle, bool additive);
+  double rotate_internal_disk(double angle);
+  double spin_leaf(LEAF leaf, double angle);
   void spin_leaf(LEAF leaf);
   void swap_side();
   void reset();
   size_t current_time() const
   {
-    if (isEnd()) {
-      return (m_events.end() - 1)->time() - m_events.begin()->time();
+    if (m_times.empty()) {
+      return 0;
     }
-    return m_current->time() - m_events.begin()->time();
+    return isEnd() ? m_times.back() : m_times[current()];
   }
 
   void rec(const SpinPuzzleGame& game);
-  void stop()
-  {
-    if (!m_recording) {
-      return;
-    }
-    m_start_game.seekg(0, std::ios::beg);
-    m_recording = false;
-  };
+
+  /**
+   * @brief  start recording and append the events to a file as they happen
+   * @note   the events are written by a \ref RecordStream and then dropped
+   *         from memory: only the last one is kept, until it can not be
+   *         merged any more (see \ref set_coalescing ). The file is closed by
+   *         \ref stop and it is loaded by \ref load_binary , even if it has
+   *         been truncated by a crash.
+   * @param  game: game at the start of the recording
+   * @param  path: file to write
+   * @retval false if the file can not be written, the events are then only
+   *         kept in memory
+   */
+  bool rec(const SpinPuzzleGame& game, const std::string& path);
+  void stop();
   void replay(SpinPuzzleGame& game);
+  //!< apply an event to a game, as it is done by \ref replay
+  static void apply(SpinPuzzleGame& game, const Event& event);
   size_t play(SpinPuzzleGame& game, size_t time);
   size_t size() const
   {
@@ -127,6 +194,88 @@ public:
   bool step_forward(SpinPuzzleGame& game, size_t steps);
   void rewind();
   void rewind(SpinPuzzleGame& game);
+
+  /**
+   * @brief  move the replay to the state after the given number of events
+   * @note   the game is restored from the nearest keyframe before the event
+   *         (or from the start game) and only the events after it are
+   *         played. The keyframes are taken while the events are played, see
+   *         \ref set_keyframe_interval .
+   * @param  game: game to update
+   * @param  event: number of events to play [0, size()]
+   * @retval false if the event is out of range or nothing has been recorded
+   */
+  bool seek(SpinPuzzleGame& game, size_t event);
+
+  /**
+   * @brief  move the replay to the given time (see \ref current_time )
+   * @note   see \ref seek
+   * @param  game: game to update
+   * @param  time: milliseconds from the first event, all the events up to it
+   *         are played
+   * @retval false if nothing has been recorded
+   */
+  bool seek_time(SpinPuzzleGame& game, size_t time);
+
+  /**
+   * @brief  set how often a keyframe is taken while the events are played
+   * @note   a keyframe is taken when either interval is exceeded. The
+   *         keyframes already taken are kept.
+   * @param  events: number of events between two keyframes (0: never)
+   * @param  time: milliseconds between two keyframes (0: never)
+   */
+  void set_keyframe_interval(size_t events, size_t time = 0)
+  {
+    m_keyframe_events = events;
+    m_keyframe_time = time;
+  }
+
+  //!< number of keyframes taken
+  size_t keyframes() const { return m_keyframes.size(); }
+
+  /**
+   * @brief  merge the consecutive additive rotations of a leaf
+   * @note   the merged event has the sum of the angles and the time of the
+   *         last rotation, so a replay gives the same final state but skips
+   *         the intermediate ones. The events already recorded are kept.
+   * @param  window: milliseconds from the first rotation merged in an event
+   *         to the last one (0: never merge)
+   */
+  void set_coalescing(size_t window)
+  {
+    m_coalescing = window;
+    m_mergeable = false;
+  }
+
+  //!< window of time of the merged rotations, see \ref set_coalescing
+  size_t coalescing() const { return m_coalescing; }
+
+  /**
+   * @brief  keep only the last events, e.g. for a recording always on
+   * @note   when a limit is exceeded the oldest events (an eighth of the
+   *         limit more, so that it does not happen at every event) are
+   *         played on the start game, that becomes the game before the
+   *         first event kept: as the game rotates by the angles of the
+   *         events (see \ref SpinPuzzleSide::round_angle ), the events kept
+   *         are still replayed exactly.
+   *         The memory of the events is reserved at once.
+   * @param  events: maximum number of events (0: no limit)
+   * @param  time: maximum milliseconds from the first event kept to the
+   *         last one (0: no limit)
+   */
+  void set_window(size_t events, size_t time = 0);
+
+  //!< number of events dropped from the start, see \ref set_window
+  size_t dropped() const { return m_dropped; }
+
+  /**
+   * @brief  events recorded in a window of time
+   * @note   binary search on the index of the times: O(log(size()))
+   * @param  begin: start of the window in milliseconds from the first event
+   * @param  end: end of the window (excluded)
+   * @retval first event of the window and the event after the last one
+   */
+  std::pair<size_t, size_t> time_range(size_t begin, size_t end) const;
   bool isRecording() const
   {
     return m_recording;
@@ -141,14 +290,39 @@ public:
   {
     buffer << m_start_game.str();
     buffer << m_events.size() << "\n";
-    for (const auto& e : m_events) {
-      e.serialize(buffer, times);
+    for (size_t n = 0; n < m_events.size(); ++n) {
+      m_events[n].serialize(buffer, times ? m_start_time + m_times[n] : 0);
     }
     return buffer;
   }
 
   std::FILE* serialize(std::FILE* file) const;
 
+  //!< version of the binary format
+  static constexpr uint32_t BINARY_VERSION = 1;
+  //!< version of the binary format written by \ref RecordStream : no
+  //!< count of the events, they go up to the end of the file
+  static constexpr uint32_t STREAM_VERSION = 2;
+
+  /**
+   * @brief  store the recording in the compact binary format
+   * @note   after a header and the start game, every event takes a byte for
+   *         the type and the leaf, then the angle in fixed point and the time
+   *         from the previous event as variable length integers: usually
+   *         3 to 5 bytes instead of a line of text of 20 to 40 bytes.
+   * @param  out: stream to write (opened in binary mode)
+   */
+  void serialize_binary(std::ostream& out) const;
+
+  /**
+   * @brief  load a recording stored by \ref serialize_binary or by a
+   *         \ref RecordStream
+   * @note   a truncated event at the end of a stream is ignored
+   * @param  in: stream to read (opened in binary mode)
+   * @retval false if the data is not valid, the recorder is then unchanged
+   */
+  bool load_binary(std::istream& in);
+
   template<typename Buffer>
   void load(Buffer& buffer)
   {
@@ -159,11 +333,12 @@ public:
     m_start_game.clear();
     m_start_game << game << "\n";
     buffer >> size;
-    m_events.clear();
+    clear_events();
     for (size_t n = 0; n < size; ++n) {
       Event e;
-      e.load(buffer);
-      m_events.emplace_back(e);
+      size_t time = 0;
+      e.load(buffer, time);
+      add(e, time);
     }
   }
 
@@ -171,11 +346,141 @@ private:
   void play(SpinPuzzleGame& game,
             std::vector<Event>::iterator begin,
             std::vector<Event>::iterator end);
+  //!< append an event that happened at the given time (in milliseconds)
+  void add(const Event& event, size_t time);
+  //!< milliseconds from the first event, see \ref m_times
+  uint32_t elapsed(size_t time) const;
+  //!< write the first events to the stream and drop them
+  void write_stream(size_t n);
+  //!< write the events left and close the stream
+  void close_stream();
+  //!< drop the oldest events if they exceed the limits of the window
+  void trim_window();
+  //!< merge an additive rotation in the last event if possible
+  bool merge(const Event& event, size_t time);
+  //!< remove the events and everything computed from them
+  void clear_events();
+  //!< take a keyframe if the played events are far from the last one
+  void update_keyframes(const SpinPuzzleGame& game, size_t played);
+  //!< check if there is a start game
+  bool has_start_game();
+
+  //!< state of the game after a number of events
+  struct Keyframe
+  {
+    //!< number of events played
+    size_t event;
+    //!< state of the game, if it can be packed
+    bool packed;
+    PackedState state;
+    //!< serialized game otherwise
+    std::string game;
+  };
 
   std::vector<Event> m_events;
+  //!< time of the first event in milliseconds
+  size_t m_start_time = 0;
+  //!< index of the times: milliseconds from the first event up to every
+  //!< event, never decreasing even if the clock goes back
+  std::vector<uint32_t> m_times;
   std::vector<Event>::iterator m_current = m_events.end();
   std::stringstream m_start_game;
   bool m_recording = false;
+  //!< keyframes sorted by event
+  std::vector<Keyframe> m_keyframes;
+  size_t m_keyframe_events = 256;
+  size_t m_keyframe_time = 0;
+  //!< window of the merged rotations (0: disabled)
+  size_t m_coalescing = 0;
+  //!< the last event is an additive rotation that can be extended
+  bool m_mergeable = false;
+  //!< time of the first rotation merged in the last event
+  size_t m_merge_start = 0;
+  //!< file the events are written to while recording
+  std::shared_ptr<RecordStream> m_stream;
+  //!< events written to the stream and dropped
+  size_t m_streamed = 0;
+  //!< time of the last event dropped
+  uint32_t m_streamed_time = 0;
+  //!< limits of the window of the events (0: no limit)
+  size_t m_window_events = 0;
+  size_t m_window_time = 0;
+  //!< events dropped by the window
+  size_t m_dropped = 0;
+};
+
+/**
+ * @brief Append-only file of the events of a \ref Recorder .
+ *
+ * The file has the header of \ref Recorder::serialize_binary followed by
+ * the events, with no count: it is valid at any time. The events are
+ * encoded in a buffer that a background thread writes and flushes every
+ * flush interval, or as soon as it holds BUFFER_SIZE bytes, so that the
+ * caller never waits for the disk (unless the buffer reaches
+ * MAX_BUFFER_SIZE bytes).
+ */
+class RecordStream
+{
+public:
+  //!< bytes buffered before the writer is woken up
+  static constexpr size_t BUFFER_SIZE = 4096;
+  //!< bytes buffered before \ref write waits for the writer
+  static constexpr size_t MAX_BUFFER_SIZE = 1 << 20;
+
+  //!< @param flush_interval: milliseconds between two writes to the file
+  explicit RecordStream(size_t flush_interval = 1000);
+  ~RecordStream();
+
+  RecordStream(const RecordStream&) = delete;
+  RecordStream& operator=(const RecordStream&) = delete;
+
+  /**
+   * @brief  create the file and start the writer
+   * @param  path: file to write
+   * @param  game: serialized game at the start of the recording
+   * @retval false if the file can not be written
+   */
+  bool open(const std::string& path, const std::string& game);
+
+  /**
+   * @brief  append an event
+   * @param  event: event to append
+   * @param  time: time of the event in milliseconds
+   */
+  void write(const Recorder::Event& event, size_t time);
+
+  /**
+   * @brief  write the buffered events and close the file
+   * @retval false if some event could not be written
+   */
+  bool close();
+
+  //!< check if the file is open
+  bool is_open() const { return m_file != nullptr; }
+
+  //!< number of events appended since \ref open
+  size_t size() const { return m_size; }
+
+private:
+  //!< loop of the writer thread
+  void run();
+
+  std::FILE* m_file = nullptr;
+  std::chrono::milliseconds m_flush_interval;
+  std::thread m_writer;
+  std::mutex m_mutex;
+  //!< wakes the writer up
+  std::condition_variable m_wake;
+  //!< wakes up a caller waiting for room in the buffer
+  std::condition_variable m_drained;
+  //!< encoded events not written yet
+  std::string m_buffer;
+  bool m_closing = false;
+  //!< set by the writer if the file could not be written
+  bool m_failed = false;
+  //!< time of the last event
+  size_t m_time = 0;
+  size_t m_size = 0;
 };
 }
 
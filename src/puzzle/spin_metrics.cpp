@@ -1,10 +1,32 @@
 #include "spin_metrics.h"
+#include <algorithm>
 #include <limits>
 
 namespace puzzle {
 
 double
 MetricProvider::naive_disorder(const puzzle::SpinPuzzleGame& game)
+{
+  // same as naive_disorder_full with the histograms kept by the game
+  std::array<uint8_t, N_MARBLE_COLORS> max_colors;
+  max_colors.fill(0);
+  for (auto side : { SIDE::FRONT, SIDE::BACK }) {
+    for (auto leaf : { LEAF::NORTH, LEAF::EAST, LEAF::WEST }) {
+      const auto& histogram = game.color_histogram(side, leaf);
+      for (size_t colors = 0; colors < N_MARBLE_COLORS; ++colors) {
+        max_colors[colors] = std::max(histogram[colors], max_colors[colors]);
+      }
+    }
+  }
+  double disorder = 0.0;
+  for (size_t colors = 0; colors < N_MARBLE_COLORS; ++colors) {
+    disorder += max_colors[colors];
+  }
+  return disorder / 60.0;
+}
+
+double
+MetricProvider::naive_disorder_full(const puzzle::SpinPuzzleGame& game)
 {
   double disorder = 0.0;
   auto current_step = game.current_time_step();
@@ -16,60 +38,13 @@ MetricProvider::naive_disorder(const puzzle::SpinPuzzleGame& game)
       color = 0;
     }
   }
-  auto colorToIndex = [](puzzle::Color color) {
-    switch (color) {
-      case puzzle::blue:
-        return 0;
-      case puzzle::green:
-        return 1;
-      case puzzle::magenta:
-        return 2;
-      case puzzle::cyan:
-        return 3;
-      case puzzle::red:
-        return 4;
-      case puzzle::yellow:
-      default:
-        return 5;
-    }
-  };
-  auto indexToColor = [](size_t index) {
-    switch (index) {
-      case 0:
-        return puzzle::blue;
-      case 1:
-        return puzzle::green;
-      case 2:
-        return puzzle::magenta;
-      case 3:
-        return puzzle::cyan;
-      case 4:
-        return puzzle::red;
-      default:
-        return puzzle::yellow;
-    }
-  };
   for (size_t treefoil = 0; treefoil < 6; ++treefoil) {
     auto& colors = treefoils[treefoil];
     size_t start = 1 + treefoil * 13 - (treefoil >= 3);
     for (size_t index = 0; index < 10; ++index) {
-      ++colors[colorToIndex(current_step[start + index])];
-    }
-  }
-
-#if 0
-  std::cout << "treefoils:\n";
-  for (size_t treefoil = 0; treefoil < 6; ++treefoil) {
-    std::cout << "T-" << treefoil + 1 << ": ";
-    auto& colors = treefoils[treefoil];
-    size_t start = 1 + treefoil * 13;
-    for (auto& color : colors) {
-      std::cout << static_cast<int>(color) << ", ";
+      ++colors[color_index(current_step[start + index])];
     }
-    std::cout << "\n";
   }
-  std::cout << "\n";
-#endif
 
   std::array<int8_t, 6> max_colors;
   max_colors.fill(0);
@@ -83,16 +58,74 @@ MetricProvider::naive_disorder(const puzzle::SpinPuzzleGame& game)
     disorder += max_colors[colors];
   }
 
-#if 0
-  std::cout << "max:\n";
-  for (size_t colors = 0; colors < 6; ++colors) {
-    disorder += max_colors[colors];
-    std::cout << static_cast<int>(max_colors[colors]) << ", ";
+  return disorder / 60.0;
+}
+
+MetricProvider::Layout
+MetricProvider::layout(const puzzle::SpinPuzzleGame& game)
+{
+  constexpr size_t N = DiscreteMoves::GROUP_SIZE;
+  Layout layout;
+  for (uint8_t s = 0; s < 2; ++s) {
+    const auto side = static_cast<SIDE>(s);
+    for (uint8_t l = 0; l < 3; ++l) {
+      const auto leaf = static_cast<LEAF>(l);
+      const auto& puzzle_side = game.get_side(side);
+      for (size_t i = 0; i < N; ++i) {
+        layout[DiscreteMoves::position(side, leaf, i)] =
+          puzzle_side.section_marble(leaf, i).color();
+      }
+    }
   }
-  std::cout << "\n";
-#endif
+  return layout;
+}
 
-  return disorder / 60.0;
+int
+MetricProvider::commands_lower_bound(const Layout& layout)
+{
+  constexpr size_t N = DiscreteMoves::GROUP_SIZE;
+  constexpr size_t N_SPIN = DiscreteMoves::N_SPIN;
+  int bound = 0;
+  for (uint8_t l = 0; l < 3; ++l) {
+    const auto leaf = static_cast<LEAF>(l);
+    const Color* front =
+      &layout[DiscreteMoves::position(SIDE::FRONT, leaf, 0)];
+    const Color* back = &layout[DiscreteMoves::position(
+      SIDE::BACK, DiscreteMoves::opposite_leaf(leaf), 0)];
+    // the pair must have one color, or two colors with N marbles each
+    const Color first = front[0];
+    Color second = first;
+    size_t n_first = 0, n_second = 0, n_front = 0;
+    for (size_t n = 0; n < 2 * N; ++n) {
+      const Color color = (n < N) ? front[n] : back[n - N];
+      if (color == first) {
+        ++n_first;
+        n_front += (n < N);
+      } else {
+        if (second == first) {
+          second = color;
+        }
+        n_second += (color == second);
+      }
+    }
+    if (n_first + n_second != 2 * N || (n_first != N && n_first != 2 * N)) {
+      return -1;
+    }
+    if (n_first == N) {
+      const size_t minority = std::min(n_front, N - n_front);
+      bound += static_cast<int>((minority + N_SPIN - 1) / N_SPIN);
+    }
+  }
+  return bound;
+}
+
+int
+MetricProvider::commands_lower_bound(const puzzle::SpinPuzzleGame& game)
+{
+  if (!game.is_discrete_state()) {
+    return -1;
+  }
+  return commands_lower_bound(layout(game));
 }
 
 }
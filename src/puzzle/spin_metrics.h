@@ -1,6 +1,9 @@
 #ifndef SPIN_METRICS_H
 #define SPIN_METRICS_H
 
+#include <array>
+
+#include "spin_discrete_moves.h"
 #include "spin_puzzle_game.h"
 
 namespace puzzle {
@@ -8,12 +11,46 @@ namespace puzzle {
 class MetricProvider
 {
 public:
+  //!< colors of the marbles in the logical layout of \ref DiscreteMoves
+  using Layout = std::array<Color, DiscreteMoves::N_POSITIONS>;
+
   MetricProvider() = default;
 
+  /**
+   * @brief  fraction of the marbles that are in place
+   * @note   for every color, the largest number of its marbles in a section
+   *         of \ref SpinPuzzleGame::current_time_step ; the sum is divided
+   *         by the number of marbles. It reads the histograms kept by the
+   *         game (see \ref SpinPuzzleGame::color_histogram ).
+   * @param  game: game to measure
+   * @retval value in (0, 1], 1 for the solved game
+   */
   double naive_disorder(const puzzle::SpinPuzzleGame& game);
 
+  //!< same as \ref naive_disorder , computed from a scan of the observation
+  double naive_disorder_full(const puzzle::SpinPuzzleGame& game);
+
+  /**
+   * @brief  admissible estimate of the number of commands to solve a game
+   * @note   only a spin moves marbles between leaves, and the leaves
+   *         exchanged by a spin are always the same pair (a leaf and its
+   *         opposite on the other side): every pair has to contain at most
+   *         two colors and every leaf has to send away its minority color,
+   *         at most 5 marbles per spin.
+   * @param  layout: colors of the game in a discrete state
+   * @retval lower bound of the number of commands, or -1 if the game can
+   *         not be solved with commands
+   */
+  static int commands_lower_bound(const Layout& layout);
+
+  //!< see \ref commands_lower_bound (-1 if the game is not discrete)
+  int commands_lower_bound(const puzzle::SpinPuzzleGame& game);
+
+  //!< colors of a game in the logical layout of \ref DiscreteMoves
+  static Layout layout(const puzzle::SpinPuzzleGame& game);
+
 private:
 };
 }
 
-#endif // SPIN_METRICS_H
\ No newline at end of file
+#endif // SPIN_METRICS_H
@@ -0,0 +1,389 @@
+#include "spin_packed_state.h"
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#include "spin_discrete_moves.h"
+#include "spin_puzzle_game.h"
+
+namespace puzzle {
+
+namespace {
+
+static_assert(PackedState::TICKS_PER_DEGREE ==
+                SpinPuzzleSide<>::TICKS_PER_DEGREE,
+              "The angles of the sides are stored as they are");
+
+constexpr uint64_t ID_MASK = (1ull << PackedState::BITS_PER_MARBLE) - 1;
+constexpr unsigned FLAGS_SHIFT = 60;
+constexpr uint64_t FLAGS_MASK = 0xf;
+constexpr unsigned TICKS_BITS = 16;
+constexpr uint64_t TICKS_MASK = 0xffff;
+//!< first word with the angles of a side
+constexpr std::size_t ANGLES_WORD = 6;
+//!< word with the spin rotation of the leaves
+constexpr std::size_t SPIN_WORD = 8;
+
+/**
+ * @brief  convert an angle in degree into ticks
+ * @retval false if the angle is not an exact multiple of a tick or it does not
+ *         fit in 16 bits
+ */
+bool
+to_ticks(double angle, uint64_t& ticks)
+{
+  const double scaled = angle * PackedState::TICKS_PER_DEGREE;
+  if (!(std::numeric_limits<int16_t>::min() <= scaled &&
+        scaled <= std::numeric_limits<int16_t>::max())) {
+    return false;
+  }
+  const long t = std::lround(scaled);
+  if (static_cast<double>(t) / PackedState::TICKS_PER_DEGREE != angle) {
+    return false;
+  }
+  ticks = static_cast<uint16_t>(static_cast<int16_t>(t));
+  return true;
+}
+
+//!< store ticks of a \ref SpinPuzzleSide::Status in 16 bits
+bool
+to_ticks(int32_t t, uint64_t& ticks)
+{
+  if (!(std::numeric_limits<int16_t>::min() <= t &&
+        t <= std::numeric_limits<int16_t>::max())) {
+    return false;
+  }
+  ticks = static_cast<uint16_t>(static_cast<int16_t>(t));
+  return true;
+}
+
+//!< ticks stored in the given slot of a word
+int32_t
+slot_ticks(uint64_t word, unsigned slot)
+{
+  return static_cast<int16_t>((word >> (TICKS_BITS * slot)) & TICKS_MASK);
+}
+
+//!< convert the ticks stored in the given slot of a word into degree
+double
+from_ticks(uint64_t word, unsigned slot)
+{
+  return static_cast<double>(slot_ticks(word, slot)) /
+         PackedState::TICKS_PER_DEGREE;
+}
+
+//!< replace the ticks stored in the given slot of a word
+void
+set_slot_ticks(uint64_t& word, unsigned slot, int32_t ticks)
+{
+  const unsigned shift = TICKS_BITS * slot;
+  word = (word & ~(TICKS_MASK << shift)) |
+         (static_cast<uint64_t>(static_cast<uint16_t>(ticks)) << shift);
+}
+
+constexpr std::size_t N = DiscreteMoves::GROUP_SIZE;
+constexpr int32_t TICKS_PER_TURN = SpinPuzzleSide<>::TICKS_PER_TURN;
+//!< ticks of a rotation by \ref SpinPuzzleSide::STEP
+constexpr int32_t STEP_TICKS = TICKS_PER_TURN / static_cast<int32_t>(N);
+constexpr int32_t HALF_TURN_TICKS = 180 * PackedState::TICKS_PER_DEGREE;
+constexpr int32_t QUARTER_TURN_TICKS = 90 * PackedState::TICKS_PER_DEGREE;
+static_assert(PackedState::MARBLES_PER_WORD == N,
+              "a word stores the marbles of a leaf");
+
+//!< spin rotation after a swap of the sides (see update_spin_rotation_angle)
+int32_t
+swapped_spin_ticks(int32_t ticks)
+{
+  return (ticks > QUARTER_TURN_TICKS) ? ticks - HALF_TURN_TICKS
+                                      : ticks + HALF_TURN_TICKS;
+}
+
+//!< swap the ids stored in the given slots of two words
+void
+swap_ids(uint64_t& a, std::size_t slot_a, uint64_t& b, std::size_t slot_b)
+{
+  const std::size_t shift_a = PackedState::BITS_PER_MARBLE * slot_a;
+  const std::size_t shift_b = PackedState::BITS_PER_MARBLE * slot_b;
+  const uint64_t id_a = (a >> shift_a) & ID_MASK;
+  const uint64_t id_b = (b >> shift_b) & ID_MASK;
+  a = (a & ~(ID_MASK << shift_a)) | (id_b << shift_a);
+  b = (b & ~(ID_MASK << shift_b)) | (id_a << shift_b);
+}
+
+//!< splitmix64 finalizer
+uint64_t
+mix(uint64_t h)
+{
+  h ^= h >> 30;
+  h *= 0xbf58476d1ce4e5b9ull;
+  h ^= h >> 27;
+  h *= 0x94d049bb133111ebull;
+  h ^= h >> 31;
+  return h;
+}
+
+} // namespace
+
+bool
+PackedState::pack(const SpinPuzzleGame& game)
+{
+  constexpr std::size_t N_SIDE_MARBLES = SpinPuzzleSide<>::N_MARBLES;
+  std::array<uint64_t, N_WORDS> words{};
+  for (std::size_t s = 0; s < 2; ++s) {
+    const auto& side = game.m_sides[s];
+    // marbles
+    for (std::size_t n = 0; n < N_SIDE_MARBLES; ++n) {
+      const SpinMarble& marble = side.m_marbles[n];
+      const int32_t id = marble.id();
+      if (id < 0 || id >= static_cast<int32_t>(N_MARBLES) ||
+          marble.color() != color_of(id)) {
+        return false;
+      }
+      words[3 * s + n / MARBLES_PER_WORD] |=
+        static_cast<uint64_t>(id) << (BITS_PER_MARBLE * (n % MARBLES_PER_WORD));
+    }
+    // flags
+    const auto& status = side.m_status;
+    if (status.has_rests()) {
+      return false;
+    }
+    const auto current = static_cast<uint64_t>(status.m_trefoil_status[1]);
+    const auto previous = static_cast<uint64_t>(status.m_trefoil_status[0]);
+    if (current > 3 || previous > 3) {
+      return false;
+    }
+    words[3 * s] |= (current | (previous << 2)) << FLAGS_SHIFT;
+    uint64_t rotation = 0;
+    for (std::size_t l = 0; l < 4; ++l) {
+      const auto r = static_cast<uint64_t>(status.m_rotation_status[l]);
+      if (r > 1) {
+        return false;
+      }
+      rotation |= r << l;
+    }
+    words[3 * s + 1] |= rotation << FLAGS_SHIFT;
+    // angles
+    uint64_t ticks = 0;
+    for (unsigned l = 0; l < 3; ++l) {
+      if (!to_ticks(status.m_shifts_leaves[l], ticks)) {
+        return false;
+      }
+      words[ANGLES_WORD + s] |= ticks << (TICKS_BITS * l);
+    }
+    if (!to_ticks(status.m_shift_cdisk, ticks)) {
+      return false;
+    }
+    words[ANGLES_WORD + s] |= ticks << (TICKS_BITS * 3);
+  }
+  const auto active_side = static_cast<uint64_t>(game.m_active_side);
+  if (active_side > 1) {
+    return false;
+  }
+  words[2] |= active_side << FLAGS_SHIFT;
+  for (unsigned l = 0; l < 3; ++l) {
+    uint64_t ticks = 0;
+    if (!to_ticks(game.m_spin_rotation[l], ticks)) {
+      return false;
+    }
+    words[SPIN_WORD] |= ticks << (TICKS_BITS * l);
+  }
+  m_words = words;
+  return true;
+}
+
+bool
+PackedState::unpack(SpinPuzzleGame& game) const
+{
+  // an empty state has all the marbles with the same id.
+  if (m_words == std::array<uint64_t, N_WORDS>{}) {
+    return false;
+  }
+  constexpr std::size_t N_SIDE_MARBLES = SpinPuzzleSide<>::N_MARBLES;
+  for (std::size_t s = 0; s < 2; ++s) {
+    auto& side = game.m_sides[s];
+    for (std::size_t n = 0; n < N_SIDE_MARBLES; ++n) {
+      const auto id = static_cast<int32_t>(
+        (m_words[3 * s + n / MARBLES_PER_WORD] >>
+         (BITS_PER_MARBLE * (n % MARBLES_PER_WORD))) &
+        ID_MASK);
+      side.m_marbles[n] = SpinMarble(id, color_of(id));
+    }
+    auto& status = side.m_status;
+    const uint64_t trefoil = (m_words[3 * s] >> FLAGS_SHIFT) & FLAGS_MASK;
+    status.m_trefoil_status[1] = static_cast<TREFOIL>(trefoil & 0x3);
+    status.m_trefoil_status[0] = static_cast<TREFOIL>(trefoil >> 2);
+    const uint64_t rotation = (m_words[3 * s + 1] >> FLAGS_SHIFT) & FLAGS_MASK;
+    for (std::size_t l = 0; l < 4; ++l) {
+      status.m_rotation_status[l] = static_cast<ROTATION>((rotation >> l) & 1);
+    }
+    for (unsigned l = 0; l < 3; ++l) {
+      status.m_shifts_leaves[l] = slot_ticks(m_words[ANGLES_WORD + s], l);
+      status.m_rests_leaves[l] = 0;
+    }
+    status.m_shift_cdisk = slot_ticks(m_words[ANGLES_WORD + s], 3);
+    status.m_rest_cdisk = 0;
+    status.m_discrete_cached = false;
+    status.update_first_marbles();
+  }
+  game.m_active_side = active_side();
+  for (unsigned l = 0; l < 3; ++l) {
+    game.m_spin_rotation[l] = from_ticks(m_words[SPIN_WORD], l);
+  }
+  game.refresh();
+  return true;
+}
+
+std::size_t
+PackedState::hash() const
+{
+  uint64_t h = 0x9e3779b97f4a7c15ull;
+  for (const uint64_t word : m_words) {
+    h = mix(h ^ word);
+  }
+  return static_cast<std::size_t>(h);
+}
+
+SIDE
+PackedState::active_side() const
+{
+  return static_cast<SIDE>((m_words[2] >> FLAGS_SHIFT) & 1);
+}
+
+int32_t
+PackedState::marble_id(SIDE side, std::size_t index) const
+{
+  const std::size_t word =
+    3 * static_cast<std::size_t>(side) + index / MARBLES_PER_WORD;
+  return static_cast<int32_t>(
+    (m_words[word] >> (BITS_PER_MARBLE * (index % MARBLES_PER_WORD))) &
+    ID_MASK);
+}
+
+bool
+PackedState::is_discrete() const
+{
+  // see SpinPuzzleSide::Status::check_discrete
+  for (std::size_t s = 0; s < 2; ++s) {
+    const uint64_t trefoil = (m_words[3 * s] >> FLAGS_SHIFT) & 0x3;
+    const uint64_t rotation = (m_words[3 * s + 1] >> FLAGS_SHIFT) & FLAGS_MASK;
+    const uint64_t angles = m_words[ANGLES_WORD + s];
+    if (trefoil != static_cast<uint64_t>(TREFOIL::LEAF_ROTATION) ||
+        (rotation & 0x7) != 0 || slot_ticks(angles, 3) != 0) {
+      return false;
+    }
+    for (unsigned l = 0; l < 3; ++l) {
+      const int32_t shift = slot_ticks(angles, l);
+      if (!(0 <= shift && shift < TICKS_PER_TURN) || shift % STEP_TICKS != 0) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+std::size_t
+PackedState::expand(const PackedState& state, Successors& out)
+{
+  if (!state.is_discrete()) {
+    return expand_game(state, out);
+  }
+  // see SpinPuzzleGame::process_discrete_command
+  const auto& words = state.m_words;
+  const auto s = static_cast<std::size_t>(state.active_side());
+  const std::size_t opposite = 1 - s;
+  std::size_t count = 0;
+  for (const bool clockwise : { true, false }) {
+    for (unsigned l = 0; l < 3; ++l) {
+      auto& child = out[count++];
+      child.command = static_cast<COMMANDS>(l + (clockwise ? 0 : 3));
+      child.state = state;
+      int32_t shift = slot_ticks(words[ANGLES_WORD + s], l) +
+                      (clockwise ? STEP_TICKS : TICKS_PER_TURN - STEP_TICKS);
+      shift -= (shift >= TICKS_PER_TURN) ? TICKS_PER_TURN : 0;
+      set_slot_ticks(child.state.m_words[ANGLES_WORD + s], l, shift);
+    }
+  }
+  for (unsigned l = 0; l < 3; ++l) {
+    // see SpinPuzzleGame::add_spin_rotation
+    const int32_t spin = slot_ticks(words[SPIN_WORD], l) + HALF_TURN_TICKS;
+    if (-QUARTER_TURN_TICKS <= spin && spin < QUARTER_TURN_TICKS) {
+      continue;
+    }
+    auto& child = out[count++];
+    child.command = static_cast<COMMANDS>(l + 6);
+    child.state = state;
+    auto& child_words = child.state.m_words;
+    const auto leaf = static_cast<LEAF>(l);
+    const auto opposite_leaf = DiscreteMoves::opposite_leaf(leaf);
+    const auto o = static_cast<unsigned>(opposite_leaf);
+    const auto& offsets = DiscreteMoves::spin_offsets(
+      slot_ticks(words[ANGLES_WORD + s], l) / STEP_TICKS);
+    const auto& opposite_offsets = DiscreteMoves::spin_offsets(
+      slot_ticks(words[ANGLES_WORD + opposite], o) / STEP_TICKS);
+    for (std::size_t n = 0; n < DiscreteMoves::N_SPIN; ++n) {
+      swap_ids(child_words[3 * s + l],
+               offsets[n],
+               child_words[3 * opposite + o],
+               opposite_offsets[n]);
+    }
+    set_slot_ticks(child_words[SPIN_WORD], l, swapped_spin_ticks(spin));
+  }
+  // INTERNAL_LEFT and INTERNAL_RIGHT are not legal on a discrete state
+  auto& child = out[count++];
+  child.command = COMMANDS::SWAP_SIDE;
+  child.state = state;
+  child.state.m_words[2] ^= 1ull << FLAGS_SHIFT;
+  for (unsigned l = 0; l < 3; ++l) {
+    set_slot_ticks(child.state.m_words[SPIN_WORD],
+                   l,
+                   swapped_spin_ticks(slot_ticks(words[SPIN_WORD], l)));
+  }
+  return count;
+}
+
+std::size_t
+PackedState::expand_game(const PackedState& state, Successors& out)
+{
+  SpinPuzzleGame game;
+  if (!state.unpack(game)) {
+    return 0;
+  }
+  const uint16_t legal = game.legal_commands();
+  std::size_t count = 0;
+  for (uint8_t c = 0; c < static_cast<uint8_t>(COMMANDS::N_COMMANDS); ++c) {
+    if (!(legal & (1u << c))) {
+      continue;
+    }
+    const auto command = static_cast<COMMANDS>(c);
+    state.unpack(game);
+    game.process_command(command);
+    // the states that can not be packed are skipped
+    if (out[count].state.pack(game)) {
+      out[count++].command = command;
+    }
+  }
+  return count;
+}
+
+Color
+PackedState::color_of(int32_t id)
+{
+  static const std::array<Color, N_MARBLES> colors = []() {
+    std::array<Color, N_MARBLES> colors;
+    colors.fill(SpinMarble::INVALID_COLOR);
+    for (const auto& marble : SpinPuzzleGame::createFrontMarbles()) {
+      colors[marble.id()] = marble.color();
+    }
+    for (const auto& marble : SpinPuzzleGame::createBackMarbles()) {
+      colors[marble.id()] = marble.color();
+    }
+    return colors;
+  }();
+  if (id < 0 || id >= static_cast<int32_t>(N_MARBLES)) {
+    return SpinMarble::INVALID_COLOR;
+  }
+  return colors[id];
+}
+
+} // namespace puzzle
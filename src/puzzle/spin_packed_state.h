@@ -0,0 +1,165 @@
+#ifndef SPIN_PACKED_STATE_H
+#define SPIN_PACKED_STATE_H
+
+#include <array>
+#include <cstddef>
+#include <functional>
+
+#include "spin_puzzle_definitions.h"
+
+namespace puzzle {
+
+class SpinPuzzleGame;
+
+/**
+ * @brief Compact, trivially copyable snapshot of a \ref SpinPuzzleGame.
+ *
+ * The state is stored in \ref N_WORDS 64-bit words:
+ *   - words 0..5: one word for every section (side, leaf) of the marbles, in
+ *     the same order as they are stored in the sides. Every word keeps the
+ *     ten marble ids in 6 bits each (bits 0..59), the remaining 4 bits carry
+ *     the flags of the side:
+ *       - section NORTH: current (bits 60-61) and previous (bits 62-63)
+ *         \ref TREFOIL status
+ *       - section EAST: \ref ROTATION status of NORTH, EAST, WEST, TREFOIL
+ *       - section WEST: active side (only for the front side)
+ *   - words 6..7: phase shift of NORTH, EAST, WEST and of the internal disk
+ *     for the front and the back side, as signed 16-bit \ref TICKS_PER_DEGREE
+ *     ticks.
+ *   - word 8: spin rotation of NORTH, EAST and WEST as signed 16-bit ticks.
+ *
+ * The color of a marble is not stored: it is the one given to its id by
+ * \ref SpinPuzzleGame::createFrontMarbles and
+ * \ref SpinPuzzleGame::createBackMarbles.
+ *
+ * @note the tollerance, the keyboard state and the recorder are not part of
+ * the state (as for \ref SpinPuzzleGame::serialize ) and they are left
+ * untouched by \ref PackedState::unpack
+ */
+class PackedState
+{
+public:
+  //!< number of 64-bit words used to store a game
+  static constexpr std::size_t N_WORDS = 9;
+  //!< resolution of the angles: 1/7200 of a turn
+  static constexpr int TICKS_PER_DEGREE = 20;
+  //!< number of marbles in the game
+  static constexpr std::size_t N_MARBLES = 60;
+  //!< number of marbles stored in a word
+  static constexpr std::size_t MARBLES_PER_WORD = 10;
+  //!< number of bits used for the id of a marble
+  static constexpr std::size_t BITS_PER_MARBLE = 6;
+
+  //!< a state reached from another one by a command
+  struct Successor;
+  //!< every successor of a state, one for each command at most
+  using Successors =
+    std::array<Successor, static_cast<std::size_t>(COMMANDS::N_COMMANDS)>;
+
+  PackedState() = default;
+
+  //!< state with the given raw words (see \ref words )
+  explicit PackedState(const std::array<uint64_t, N_WORDS>& words)
+    : m_words(words)
+  {
+  }
+
+  /**
+   * @brief  store the given game
+   * @note   if the game can not be represented (marbles with an unexpected
+   *         color, angles not multiple of a tick) the state is left untouched
+   * @param  game: game to store
+   * @retval true if the game has been stored without loss of information
+   */
+  bool pack(const SpinPuzzleGame& game);
+
+  /**
+   * @brief  restore the stored state into a game
+   * @param  game: game to update
+   * @retval true on success
+   */
+  bool unpack(SpinPuzzleGame& game) const;
+
+  //!< hash of the state, suitable for hash containers
+  std::size_t hash() const;
+
+  //!< active side of the stored game
+  SIDE active_side() const;
+
+  /**
+   * @brief  id of the marble at the given position of a side
+   * @param  side: side of the trefoil
+   * @param  index: position in the marble array of the side [0, 30)
+   * @retval id of the marble
+   */
+  int32_t marble_id(SIDE side, std::size_t index) const;
+
+  //!< raw words of the state
+  const std::array<uint64_t, N_WORDS>& words() const { return m_words; }
+
+  //!< color of a marble given its id (see createFrontMarbles)
+  static Color color_of(int32_t id);
+
+  /**
+   * @brief  generate the states reached with every legal command
+   *
+   * The commands are the ones of \ref SpinPuzzleGame::legal_commands , in
+   * increasing order, and every successor is the state packed after
+   * \ref SpinPuzzleGame::process_command . A discrete state (see
+   * \ref SpinPuzzleGame::is_discrete_state ) is expanded directly on the
+   * words, without building any game; the other states are unpacked into a
+   * game for every command.
+   *
+   * @note   the games are assumed to have the default tollerance
+   * @param  state: state to expand
+   * @param  out: successors, the first ones are valid
+   * @retval number of successors stored in out
+   */
+  static std::size_t expand(const PackedState& state, Successors& out);
+
+  bool operator==(const PackedState& other) const
+  {
+    return m_words == other.m_words;
+  }
+  bool operator!=(const PackedState& other) const { return !(*this == other); }
+
+private:
+  std::array<uint64_t, N_WORDS> m_words{};
+
+  //!< check if the stored game is in a discrete state
+  bool is_discrete() const;
+  //!< \ref expand through a \ref SpinPuzzleGame
+  static std::size_t expand_game(const PackedState& state, Successors& out);
+};
+
+struct PackedState::Successor
+{
+  //!< command given to the parent state
+  COMMANDS command;
+  //!< state reached by the command
+  PackedState state;
+};
+
+//!< hash functor to store \ref PackedState in unordered containers
+struct PackedStateHash
+{
+  std::size_t operator()(const PackedState& state) const
+  {
+    return state.hash();
+  }
+};
+
+} // namespace puzzle
+
+namespace std {
+template<>
+struct hash<puzzle::PackedState>
+{
+  std::size_t operator()(const puzzle::PackedState& state) const
+  {
+    return state.hash();
+  }
+};
+} // namespace std
+
+#endif // SPIN_PACKED_STATE_H
@@ -0,0 +1,344 @@
+#include "spin_pattern_database.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+
+#if defined(_WIN32)
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "spin_discrete_moves.h"
+
+namespace puzzle {
+
+namespace {
+
+constexpr std::size_t N = DiscreteMoves::GROUP_SIZE;
+//!< positions of a pair
+constexpr std::size_t N_PAIR = 2 * N;
+constexpr uint32_t PAIR_MASK = (1u << N_PAIR) - 1;
+constexpr uint8_t UNKNOWN = 0xff;
+
+//!< header of the file
+struct Header
+{
+  char magic[4];
+  uint32_t version;
+  uint32_t n_patterns;
+  uint32_t reserved;
+};
+constexpr char MAGIC[4] = { 'S', 'P', 'D', 'B' };
+
+//!< binomial coefficients up to binomial(N_PAIR, N)
+const std::array<std::array<uint32_t, N + 1>, N_PAIR + 1>&
+binomials()
+{
+  static const auto binomials = []() {
+    std::array<std::array<uint32_t, N + 1>, N_PAIR + 1> binomials{};
+    for (std::size_t n = 0; n <= N_PAIR; ++n) {
+      binomials[n][0] = 1;
+      for (std::size_t k = 1; k <= std::min(n, N); ++k) {
+        binomials[n][k] = binomials[n - 1][k - 1] +
+                          ((k <= n - 1) ? binomials[n - 1][k] : 0);
+      }
+    }
+    return binomials;
+  }();
+  return binomials;
+}
+
+//!< rank of a pattern: bit 0 is set and the other N - 1 bits in [1, 20)
+std::size_t
+rank(uint32_t mask)
+{
+  const auto& c = binomials();
+  std::size_t rank = 0;
+  std::size_t k = 0;
+  for (std::size_t p = 1; p < N_PAIR; ++p) {
+    if (mask & (1u << p)) {
+      ++k;
+      rank += c[p - 1][k];
+    }
+  }
+  return rank;
+}
+
+//!< patterns have the first position set: swap the colors if needed
+uint32_t
+canonical(uint32_t mask)
+{
+  return (mask & 1u) ? mask : (~mask & PAIR_MASK);
+}
+
+//!< position in the layout of the i-th position of the pair of NORTH
+std::size_t
+layout_position(std::size_t i)
+{
+  return (i < N) ? DiscreteMoves::position(SIDE::FRONT, LEAF::NORTH, i)
+                 : DiscreteMoves::position(SIDE::BACK, LEAF::NORTH, i - N);
+}
+
+//!< a command on the pair of NORTH as a permutation of its positions
+struct PairMove
+{
+  //!< side the command is given from
+  SIDE side;
+  //!< new position i holds the old position source[i]
+  std::array<uint8_t, N_PAIR> source;
+};
+
+std::vector<PairMove>
+pair_moves()
+{
+  const COMMANDS commands[] = { COMMANDS::NORTH_RIGHT,
+                                COMMANDS::NORTH_LEFT,
+                                COMMANDS::NORTH_SPIN };
+  std::array<uint8_t, DiscreteMoves::N_POSITIONS> pair_index;
+  pair_index.fill(UNKNOWN);
+  for (std::size_t i = 0; i < N_PAIR; ++i) {
+    pair_index[layout_position(i)] = static_cast<uint8_t>(i);
+  }
+  std::vector<PairMove> moves;
+  for (auto side : { SIDE::FRONT, SIDE::BACK }) {
+    for (auto command : commands) {
+      const auto& permutation = DiscreteMoves::permutation(side, command);
+      PairMove move{ side, {} };
+      for (std::size_t i = 0; i < N_PAIR; ++i) {
+        move.source[i] = pair_index[permutation[layout_position(i)]];
+      }
+      moves.push_back(move);
+    }
+  }
+  return moves;
+}
+
+uint32_t
+apply(const PairMove& move, uint32_t mask)
+{
+  uint32_t moved = 0;
+  for (std::size_t i = 0; i < N_PAIR; ++i) {
+    moved |= ((mask >> move.source[i]) & 1u) << i;
+  }
+  return canonical(moved);
+}
+
+} // namespace
+
+PatternDatabase::~PatternDatabase()
+{
+  unload();
+}
+
+void
+PatternDatabase::unload()
+{
+#if !defined(_WIN32)
+  if (m_mapped) {
+    munmap(m_mapped, m_mapped_size);
+  }
+#endif
+  m_mapped = nullptr;
+  m_mapped_size = 0;
+  m_data = nullptr;
+  m_buffer.clear();
+}
+
+void
+PatternDatabase::build()
+{
+  unload();
+  const auto moves = pair_moves();
+  m_buffer.assign(DATA_SIZE, UNKNOWN);
+  uint8_t* sides = m_buffer.data();
+  uint8_t* no_swap = m_buffer.data() + 2 * N_PATTERNS;
+
+  // solved: the front leaf has the first color, the back leaf the other one
+  const uint32_t solved = (1u << N) - 1;
+  const std::size_t goal = rank(solved);
+
+  // breadth-first search on (active side, pattern), every move costs 1
+  std::deque<std::pair<uint8_t, uint32_t>> queue;
+  for (uint8_t side = 0; side < 2; ++side) {
+    sides[side * N_PATTERNS + goal] = 0;
+    queue.emplace_back(side, solved);
+  }
+  while (!queue.empty()) {
+    const auto [side, mask] = queue.front();
+    queue.pop_front();
+    const uint8_t distance = sides[side * N_PATTERNS + rank(mask)];
+    // the moves are their own inverse or come with their inverse
+    auto visit = [&](uint8_t next_side, uint32_t next_mask) {
+      auto& d = sides[next_side * N_PATTERNS + rank(next_mask)];
+      if (d == UNKNOWN) {
+        d = distance + 1;
+        queue.emplace_back(next_side, next_mask);
+      }
+    };
+    visit(side ^ 1, mask);
+    for (const auto& move : moves) {
+      if (static_cast<uint8_t>(move.side) == side) {
+        visit(side, apply(move, mask));
+      }
+    }
+  }
+
+  // the same without the cost of the swaps: every command on any side
+  std::deque<uint32_t> patterns_queue{ solved };
+  no_swap[goal] = 0;
+  while (!patterns_queue.empty()) {
+    const uint32_t mask = patterns_queue.front();
+    patterns_queue.pop_front();
+    const uint8_t distance = no_swap[rank(mask)];
+    for (const auto& move : moves) {
+      const uint32_t next = apply(move, mask);
+      auto& d = no_swap[rank(next)];
+      if (d == UNKNOWN) {
+        d = distance + 1;
+        patterns_queue.push_back(next);
+      }
+    }
+  }
+  m_data = m_buffer.data();
+}
+
+bool
+PatternDatabase::save(const std::string& path) const
+{
+  if (!is_loaded()) {
+    return false;
+  }
+  std::FILE* file = std::fopen(path.c_str(), "wb");
+  if (!file) {
+    return false;
+  }
+  Header header{};
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.n_patterns = static_cast<uint32_t>(N_PATTERNS);
+  bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+            std::fwrite(m_data, 1, DATA_SIZE, file) == DATA_SIZE;
+  ok = (std::fclose(file) == 0) && ok;
+  return ok;
+}
+
+bool
+PatternDatabase::load(const std::string& path)
+{
+  unload();
+  const std::size_t size = sizeof(Header) + DATA_SIZE;
+#if defined(_WIN32)
+  // no memory mapping: read the tables, the file must have the exact size
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file.is_open() || file.tellg() != static_cast<std::streamoff>(size)) {
+    return false;
+  }
+  file.seekg(0);
+  std::vector<uint8_t> buffer(size);
+  if (!file.read(reinterpret_cast<char*>(buffer.data()), size)) {
+    return false;
+  }
+  const uint8_t* bytes = buffer.data();
+#else
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0 ||
+      static_cast<std::size_t>(info.st_size) != size) {
+    close(fd);
+    return false;
+  }
+  void* mapped = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  // the mapping keeps a reference to the file
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    return false;
+  }
+  const auto* bytes = static_cast<const uint8_t*>(mapped);
+#endif
+  Header header;
+  std::memcpy(&header, bytes, sizeof(header));
+  if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+      header.version != VERSION || header.n_patterns != N_PATTERNS) {
+#if !defined(_WIN32)
+    munmap(mapped, size);
+#endif
+    return false;
+  }
+#if defined(_WIN32)
+  m_buffer.assign(bytes + sizeof(Header), bytes + size);
+  m_data = m_buffer.data();
+#else
+  m_mapped = mapped;
+  m_mapped_size = size;
+  m_data = bytes + sizeof(Header);
+#endif
+  return true;
+}
+
+std::size_t
+PatternDatabase::pattern(const Layout& layout, LEAF leaf)
+{
+  const Color* front = &layout[DiscreteMoves::position(SIDE::FRONT, leaf, 0)];
+  const Color* back = &layout[DiscreteMoves::position(
+    SIDE::BACK, DiscreteMoves::opposite_leaf(leaf), 0)];
+  uint32_t mask = 0;
+  for (std::size_t i = 0; i < N; ++i) {
+    mask |= static_cast<uint32_t>(front[i] == front[0]) << i;
+    mask |= static_cast<uint32_t>(back[i] == front[0]) << (N + i);
+  }
+  if (mask == PAIR_MASK) {
+    return N_PATTERNS;
+  }
+  return rank(mask);
+}
+
+int
+PatternDatabase::pair_distance(const Layout& layout,
+                               SIDE side,
+                               LEAF leaf) const
+{
+  const std::size_t index = pattern(layout, leaf);
+  if (index == N_PATTERNS) {
+    return 0;
+  }
+  return m_data[static_cast<std::size_t>(side) * N_PATTERNS + index];
+}
+
+int
+PatternDatabase::distance(const Layout& layout, SIDE side) const
+{
+  const std::size_t offset = static_cast<std::size_t>(side) * N_PATTERNS;
+  const uint8_t* no_swap = m_data + 2 * N_PATTERNS;
+  int max_distance = 0;
+  int sum_no_swap = 0;
+  for (uint8_t l = 0; l < 3; ++l) {
+    const std::size_t index = pattern(layout, static_cast<LEAF>(l));
+    if (index == N_PATTERNS) {
+      continue;
+    }
+    max_distance = std::max<int>(max_distance, m_data[offset + index]);
+    sum_no_swap += no_swap[index];
+  }
+  return std::max(max_distance, sum_no_swap);
+}
+
+int
+PatternDatabase::max_distance() const
+{
+  if (!is_loaded()) {
+    return 0;
+  }
+  return *std::max_element(m_data, m_data + DATA_SIZE);
+}
+
+} // namespace puzzle
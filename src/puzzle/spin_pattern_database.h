@@ -0,0 +1,123 @@
+#ifndef SPIN_PATTERN_DATABASE_H
+#define SPIN_PATTERN_DATABASE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "spin_metrics.h"
+#include "spin_puzzle_definitions.h"
+
+namespace puzzle {
+
+/**
+ * @brief Exact distances to the goal of the pairs of leaves.
+ *
+ * The commands never move a marble out of its *pair*: a leaf of the front
+ * side and its opposite leaf on the back side (see
+ * \ref DiscreteMoves::opposite_leaf ). The database projects a game on the
+ * 20 positions of a pair: since the pair must hold two colors of 10
+ * marbles, a pattern is the set of positions with the color of the first
+ * marble of the front leaf. The three pairs move in the same way, so a
+ * single table serves all of them.
+ *
+ * For every pattern the database stores:
+ *   - the number of commands to solve the pair for each active side;
+ *   - the number of commands to solve the pair not counting SWAP_SIDE.
+ * The commands that move a pair do not move the others, so the sum over
+ * the pairs of the second distance is admissible, as is the maximum of the
+ * first one (see \ref distance ).
+ *
+ * The tables are computed with a breadth-first search from the solved
+ * patterns (see \ref build ) and they can be stored in a file that is
+ * mapped read-only in memory by \ref load : the processes that load the
+ * same file share its pages.
+ */
+class PatternDatabase
+{
+public:
+  using Layout = MetricProvider::Layout;
+
+  //!< number of patterns of a pair (binomial(19, 9))
+  static constexpr std::size_t N_PATTERNS = 92378;
+  //!< version of the file format
+  static constexpr uint32_t VERSION = 1;
+
+  PatternDatabase() = default;
+  ~PatternDatabase();
+
+  PatternDatabase(const PatternDatabase&) = delete;
+  PatternDatabase& operator=(const PatternDatabase&) = delete;
+
+  //!< compute the tables in memory
+  void build();
+
+  /**
+   * @brief  store the tables in a file
+   * @param  path: file to write
+   * @retval true on success
+   */
+  bool save(const std::string& path) const;
+
+  /**
+   * @brief  map the tables of a file in memory (read only)
+   * @param  path: file written by \ref save
+   * @retval true if the file is valid, otherwise the database is empty
+   */
+  bool load(const std::string& path);
+
+  //!< check if the tables are available
+  bool is_loaded() const { return m_data != nullptr; }
+
+  //!< check if the tables are mapped from a file
+  bool is_mapped() const { return m_mapped != nullptr; }
+
+  /**
+   * @brief  admissible estimate of the number of commands to solve a game
+   * @param  layout: colors of the game, it must be solvable with commands
+   *         (see \ref MetricProvider::commands_lower_bound )
+   * @param  side: active side
+   * @retval lower bound of the number of commands
+   */
+  int distance(const Layout& layout, SIDE side) const;
+
+  /**
+   * @brief  exact number of commands to solve a pair
+   * @param  layout: colors of the game
+   * @param  side: active side
+   * @param  leaf: leaf of the front side of the pair
+   * @retval number of commands
+   */
+  int pair_distance(const Layout& layout, SIDE side, LEAF leaf) const;
+
+  //!< largest distance in the tables
+  int max_distance() const;
+
+  /**
+   * @brief  index of the pattern of a pair
+   * @param  layout: colors of the game
+   * @param  leaf: leaf of the front side of the pair
+   * @retval index in [0, N_PATTERNS), N_PATTERNS if the pair has a
+   *         single color
+   */
+  static std::size_t pattern(const Layout& layout, LEAF leaf);
+
+private:
+  //!< distances with each active side, then without counting the swaps
+  static constexpr std::size_t DATA_SIZE = 3 * N_PATTERNS;
+
+  //!< tables computed by build
+  std::vector<uint8_t> m_buffer;
+  //!< mapped file
+  void* m_mapped = nullptr;
+  std::size_t m_mapped_size = 0;
+  //!< first byte of the tables
+  const uint8_t* m_data = nullptr;
+
+  void unload();
+};
+
+} // namespace puzzle
+
+#endif // SPIN_PATTERN_DATABASE_H
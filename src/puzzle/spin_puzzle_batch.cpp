@@ -0,0 +1,226 @@
+#include "spin_puzzle_batch.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "spin_packed_state.h"
+#include "spin_puzzle_game.h"
+
+namespace puzzle {
+
+namespace {
+
+constexpr std::size_t N_POSITIONS = DiscreteMoves::N_POSITIONS;
+constexpr std::size_t GROUP_SIZE = DiscreteMoves::GROUP_SIZE;
+//!< spin rotation flags with every leaf at 180°
+constexpr uint8_t ALL_LEAVES = 0x7;
+
+static_assert(N_POSITIONS <= SpinPuzzleBatch::ROW_SIZE);
+static_assert(N_POSITIONS == PackedState::N_MARBLES);
+
+//!< first index in the observation of every leaf of the logical layout
+constexpr std::array<std::size_t, 6> observation_offsets()
+{
+  // see SpinPuzzleGame::current_time_step: the active side is followed by
+  // the sides, with 3 empty places after every leaf.
+  constexpr std::size_t SIDE_STRIDE = (SIZE_STEP_ARRAY - 1) / 2 - 1;
+  constexpr std::size_t LEAF_STRIDE = GROUP_SIZE + 3;
+  std::array<std::size_t, 6> offsets{};
+  for (std::size_t s = 0; s < 2; ++s) {
+    for (std::size_t l = 0; l < 3; ++l) {
+      offsets[3 * s + l] = 1 + SIDE_STRIDE * s + LEAF_STRIDE * l;
+    }
+  }
+  return offsets;
+}
+
+//!< color of every marble id
+const std::array<Color, N_POSITIONS>&
+colors()
+{
+  static const auto colors = []() {
+    std::array<Color, N_POSITIONS> colors;
+    for (std::size_t id = 0; id < N_POSITIONS; ++id) {
+      colors[id] = PackedState::color_of(static_cast<int32_t>(id));
+    }
+    return colors;
+  }();
+  return colors;
+}
+
+} // namespace
+
+SpinPuzzleBatch::SpinPuzzleBatch(std::size_t size)
+  : m_size(size)
+  , m_marbles(size * ROW_SIZE, 0)
+  , m_active_side(size, 0)
+  , m_spin(size, 0)
+{
+  reset();
+}
+
+void
+SpinPuzzleBatch::reset()
+{
+  for (std::size_t n = 0; n < m_size; ++n) {
+    reset(n);
+  }
+}
+
+void
+SpinPuzzleBatch::reset(std::size_t index)
+{
+  assert(index < m_size);
+  // in the initial configuration the marble at position p has id p
+  uint8_t* marbles = row(index);
+  for (std::size_t p = 0; p < N_POSITIONS; ++p) {
+    marbles[p] = static_cast<uint8_t>(p);
+  }
+  m_active_side[index] = static_cast<uint8_t>(SIDE::FRONT);
+  m_spin[index] = 0;
+}
+
+bool
+SpinPuzzleBatch::set_game(std::size_t index, const SpinPuzzleGame& game)
+{
+  assert(index < m_size);
+  if (!game.is_discrete_state()) {
+    return false;
+  }
+  uint8_t spin = 0;
+  for (std::size_t l = 0; l < 3; ++l) {
+    const double angle = game.m_spin_rotation[l];
+    if (angle == 180.0) {
+      spin |= 1 << l;
+    } else if (angle != 0.0) {
+      return false;
+    }
+  }
+  std::array<uint8_t, N_POSITIONS> marbles;
+  for (std::size_t s = 0; s < 2; ++s) {
+    const auto side = static_cast<SIDE>(s);
+    for (std::size_t l = 0; l < 3; ++l) {
+      const auto leaf = static_cast<LEAF>(l);
+      const auto& puzzle_side = game.get_side(side);
+      for (std::size_t i = 0; i < GROUP_SIZE; ++i) {
+        const SpinMarble& marble = puzzle_side.section_marble(leaf, i);
+        const int32_t id = marble.id();
+        if (id < 0 || id >= static_cast<int32_t>(N_POSITIONS) ||
+            marble.color() != colors()[id]) {
+          return false;
+        }
+        marbles[DiscreteMoves::position(side, leaf, i)] =
+          static_cast<uint8_t>(id);
+      }
+    }
+  }
+  std::copy(marbles.begin(), marbles.end(), row(index));
+  m_active_side[index] = static_cast<uint8_t>(game.get_active_side());
+  m_spin[index] = spin;
+  return true;
+}
+
+SpinPuzzleGame
+SpinPuzzleBatch::game(std::size_t index) const
+{
+  assert(index < m_size);
+  // at zero phase the logical layout of a side is its marble array
+  const uint8_t* marbles = row(index);
+  constexpr std::size_t SIDE_SIZE = DiscreteMoves::SIDE_SIZE;
+  std::array<SpinMarble, SIDE_SIZE> front;
+  std::array<SpinMarble, SIDE_SIZE> back;
+  for (std::size_t n = 0; n < SIDE_SIZE; ++n) {
+    const uint8_t front_id = marbles[n];
+    const uint8_t back_id = marbles[SIDE_SIZE + n];
+    front[n] = SpinMarble(front_id, colors()[front_id]);
+    back[n] = SpinMarble(back_id, colors()[back_id]);
+  }
+  SpinPuzzleGame game(std::move(front), std::move(back));
+  game.m_active_side = active_side(index);
+  for (std::size_t l = 0; l < 3; ++l) {
+    game.m_spin_rotation[l] = (m_spin[index] >> l) & 1 ? 180.0 : 0.0;
+  }
+  game.refresh();
+  return game;
+}
+
+void
+SpinPuzzleBatch::step(const COMMANDS* commands)
+{
+  for (std::size_t n = 0; n < m_size; ++n) {
+    const COMMANDS command = commands[n];
+    assert(command < COMMANDS::N_COMMANDS);
+    DiscreteMoves::apply(DiscreteMoves::moves(active_side(n), command),
+                         row(n));
+    // swapping side flips the spin rotation of every leaf
+    const uint8_t swap = (command == COMMANDS::SWAP_SIDE);
+    m_active_side[n] ^= swap;
+    m_spin[n] ^= swap * ALL_LEAVES;
+  }
+}
+
+void
+SpinPuzzleBatch::step(const std::vector<COMMANDS>& commands)
+{
+  assert(commands.size() == m_size);
+  step(commands.data());
+}
+
+void
+SpinPuzzleBatch::observations(Observation* out) const
+{
+  for (std::size_t n = 0; n < m_size; ++n) {
+    observation(n, out[n]);
+  }
+}
+
+std::vector<SpinPuzzleBatch::Observation>
+SpinPuzzleBatch::observations() const
+{
+  std::vector<Observation> out(m_size);
+  observations(out.data());
+  return out;
+}
+
+SpinPuzzleBatch::Observation
+SpinPuzzleBatch::observation(std::size_t index) const
+{
+  Observation out;
+  observation(index, out);
+  return out;
+}
+
+void
+SpinPuzzleBatch::observation(std::size_t index, Observation& out) const
+{
+  assert(index < m_size);
+  constexpr auto OFFSETS = observation_offsets();
+  const auto& color = colors();
+  const uint8_t* marbles = row(index);
+  out.fill(SpinMarble::INVALID_COLOR);
+  out[0] = static_cast<Color>(m_active_side[index]);
+  for (std::size_t g = 0; g < OFFSETS.size(); ++g) {
+    Color* leaf = out.data() + OFFSETS[g];
+    for (std::size_t i = 0; i < GROUP_SIZE; ++i) {
+      leaf[i] = color[marbles[GROUP_SIZE * g + i]];
+    }
+  }
+}
+
+bool
+SpinPuzzleBatch::is_solved(std::size_t index) const
+{
+  assert(index < m_size);
+  const auto& color = colors();
+  const uint8_t* marbles = row(index);
+  for (std::size_t p = 0; p < N_POSITIONS; p += GROUP_SIZE) {
+    for (std::size_t i = 1; i < GROUP_SIZE; ++i) {
+      if (color[marbles[p + i]] != color[marbles[p]]) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+} // namespace puzzle
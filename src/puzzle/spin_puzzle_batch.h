@@ -0,0 +1,139 @@
+#ifndef SPIN_PUZZLE_BATCH_H
+#define SPIN_PUZZLE_BATCH_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "spin_discrete_moves.h"
+#include "spin_puzzle_definitions.h"
+
+namespace puzzle {
+
+class SpinPuzzleGame;
+
+/**
+ * @brief Batch of games evolving in lock-step with discrete commands.
+ *
+ * The batch is meant for environments that drive many games with
+ * \ref COMMANDS only (e.g. reinforcement learning rollouts). Every game is
+ * in a discrete state (see \ref SpinPuzzleGame::is_discrete_state ) and
+ * it is stored as a structure of arrays:
+ *   - the marble ids in the logical layout of \ref DiscreteMoves , one row
+ *     of \ref ROW_SIZE bytes (a cache line) for every game;
+ *   - the active side of every game;
+ *   - the spin rotation of every game, one bit for every leaf (0° or 180°).
+ *
+ * A step applies one command to every game through the tables of
+ * \ref DiscreteMoves::moves : the same sequence of loads and stores for
+ * every command, without any branch on the command.
+ *
+ * @note the batch does not keep the phase of the leaves: a game retrieved
+ * with \ref game has the marbles at zero phase and gives the same
+ * observation of the game that has been stored.
+ */
+class SpinPuzzleBatch
+{
+public:
+  //!< observation of a game, see \ref SpinPuzzleGame::current_time_step
+  using Observation = std::array<Color, SIZE_STEP_ARRAY>;
+
+  //!< bytes used to store the marbles of a game
+  static constexpr std::size_t ROW_SIZE = 64;
+
+  /**
+   * @brief  create a batch of games in the initial configuration
+   * @param  size: number of games
+   */
+  explicit SpinPuzzleBatch(std::size_t size);
+
+  //!< number of games in the batch
+  std::size_t size() const { return m_size; }
+
+  //!< reset every game to the initial configuration
+  void reset();
+
+  //!< reset a game to the initial configuration
+  void reset(std::size_t index);
+
+  /**
+   * @brief  store a game in the batch
+   * @param  index: position in the batch
+   * @param  game: game to store: it must be in a discrete state, with the
+   *         marbles of \ref SpinPuzzleGame::createFrontMarbles and
+   *         \ref SpinPuzzleGame::createBackMarbles and with spin rotations
+   *         of 0° or 180°.
+   * @retval true if the game has been stored, otherwise the batch is left
+   *         untouched
+   */
+  bool set_game(std::size_t index, const SpinPuzzleGame& game);
+
+  /**
+   * @brief  retrieve a game of the batch
+   * @param  index: position in the batch
+   * @retval game with the same marbles, active side and spin rotations
+   */
+  SpinPuzzleGame game(std::size_t index) const;
+
+  /**
+   * @brief  apply a command to every game
+   * @note   it is equivalent to SpinPuzzleGame::process_command
+   * @param  commands: \ref size valid commands, one for every game
+   */
+  void step(const COMMANDS* commands);
+
+  //!< convenient overload of \ref step
+  void step(const std::vector<COMMANDS>& commands);
+
+  /**
+   * @brief  observation of every game
+   * @param  out: array of \ref size observations to fill
+   */
+  void observations(Observation* out) const;
+
+  //!< convenient overload of \ref observations
+  std::vector<Observation> observations() const;
+
+  //!< observation of a game
+  Observation observation(std::size_t index) const;
+
+  /**
+   * @brief  observation of a game
+   * @param  index: position in the batch
+   * @param  out: observation to fill
+   */
+  void observation(std::size_t index, Observation& out) const;
+
+  //!< active side of a game
+  SIDE active_side(std::size_t index) const
+  {
+    return static_cast<SIDE>(m_active_side[index]);
+  }
+
+  //!< check if a game is solved (see \ref SpinPuzzleGame::is_game_solved )
+  bool is_solved(std::size_t index) const;
+
+private:
+  //!< number of games
+  std::size_t m_size;
+  //!< marble ids of every game (\ref ROW_SIZE bytes for every game)
+  std::vector<uint8_t> m_marbles;
+  //!< active side of every game
+  std::vector<uint8_t> m_active_side;
+  //!< spin rotation of every game: bit n set if leaf n is at 180°
+  std::vector<uint8_t> m_spin;
+
+  const uint8_t* row(std::size_t index) const
+  {
+    return m_marbles.data() + index * ROW_SIZE;
+  }
+  uint8_t* row(std::size_t index)
+  {
+    return m_marbles.data() + index * ROW_SIZE;
+  }
+};
+
+} // namespace puzzle
+
+#endif // SPIN_PUZZLE_BATCH_H
@@ -45,4 +45,24 @@ color_to_str(int color)
   }
   return "invalid";
 }
+
+size_t
+color_index(Color color)
+{
+  switch (color) {
+    case puzzle::blue:
+      return 0;
+    case puzzle::green:
+      return 1;
+    case puzzle::magenta:
+      return 2;
+    case puzzle::cyan:
+      return 3;
+    case puzzle::red:
+      return 4;
+    case puzzle::yellow:
+    default:
+      return 5;
+  }
+}
 } // namespace puzzle
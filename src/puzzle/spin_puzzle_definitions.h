@@ -59,6 +59,19 @@ using Color = int;
 std::string
 color_to_str(int color);
 
+//!< number of colors of the marbles of the game
+constexpr size_t N_MARBLE_COLORS = 6;
+
+/**
+ * @brief  index of a color of the marbles of the game: blue, green,
+ *         magenta, cyan, red, yellow
+ * @note   any other color has the index of yellow
+ * @param  color: color to convert
+ * @retval index in [0, N_MARBLE_COLORS)
+ */
+size_t
+color_index(Color color);
+
 /**
  * @brief enumeration to determine the leaf of a trefoil
  */
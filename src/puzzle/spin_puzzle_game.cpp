@@ -1,35 +1,305 @@
 #include "spin_puzzle_game.h"
 
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <sstream>
 
 #include "spin_action_provider.h"
+#include "spin_discrete_moves.h"
+#include "spin_event_bus.h"
 #include "spin_game_recorder.h"
+#include "spin_packed_state.h"
+#include "spin_zobrist.h"
 
 namespace puzzle {
 
+namespace {
+
+//!< publish an action on the bus, if any
+void
+publish(EventBus* bus,
+        Recorder::EventType type,
+        double angle = 0.0,
+        LEAF leaf = LEAF::INVALID)
+{
+  if (bus) {
+    bus->publish(Recorder::Event(type, angle, leaf));
+  }
+}
+
+//!< header of the binary format: magic, version and kind of encoding
+constexpr uint8_t BINARY_MAGIC[2] = { 'S', 'G' };
+constexpr std::size_t BINARY_HEADER_SIZE = 4;
+constexpr uint8_t BINARY_PACKED = 0;
+constexpr uint8_t BINARY_FULL = 1;
+static_assert(SpinPuzzleGame::BINARY_PACKED_SIZE ==
+                BINARY_HEADER_SIZE + 8 * PackedState::N_WORDS,
+              "The size of the packed binary format is not up to date");
+// active side, spin rotations and for every side the shifts and their rests,
+// the statuses and the id and color of the marbles
+constexpr std::size_t BINARY_SIDE_SIZE = 4 * 4 + 4 * 4 + 6 + 30 * 2 * 4;
+static_assert(SpinPuzzleGame::BINARY_SIZE ==
+                BINARY_HEADER_SIZE + 1 + 3 * 8 + 2 * BINARY_SIDE_SIZE,
+              "The size of the binary format is not up to date");
+
+//!< little-endian writer of a buffer
+class BinaryWriter
+{
+public:
+  explicit BinaryWriter(uint8_t* data)
+    : m_data(data)
+  {
+  }
+
+  void u8(uint8_t value) { *m_data++ = value; }
+  void u32(uint32_t value)
+  {
+    for (unsigned n = 0; n < 4; ++n) {
+      u8(static_cast<uint8_t>(value >> (8 * n)));
+    }
+  }
+  void u64(uint64_t value)
+  {
+    for (unsigned n = 0; n < 8; ++n) {
+      u8(static_cast<uint8_t>(value >> (8 * n)));
+    }
+  }
+  void f64(double value)
+  {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    u64(bits);
+  }
+
+private:
+  uint8_t* m_data;
+};
+
+//!< little-endian reader of a buffer (the size is checked by the caller)
+class BinaryReader
+{
+public:
+  explicit BinaryReader(const uint8_t* data)
+    : m_data(data)
+  {
+  }
+
+  uint8_t u8() { return *m_data++; }
+  uint32_t u32()
+  {
+    uint32_t value = 0;
+    for (unsigned n = 0; n < 4; ++n) {
+      value |= static_cast<uint32_t>(u8()) << (8 * n);
+    }
+    return value;
+  }
+  uint64_t u64()
+  {
+    uint64_t value = 0;
+    for (unsigned n = 0; n < 8; ++n) {
+      value |= static_cast<uint64_t>(u8()) << (8 * n);
+    }
+    return value;
+  }
+  double f64()
+  {
+    const uint64_t bits = u64();
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+private:
+  const uint8_t* m_data;
+};
+
+//!< side of a game read by SpinPuzzleGame::load_binary before it is checked
+struct BinarySide
+{
+  int32_t shifts_leaves[3];
+  int32_t shift_cdisk;
+  int32_t rests_leaves[3];
+  int32_t rest_cdisk;
+  TREFOIL trefoil_status[2];
+  ROTATION rotation_status[4];
+  std::array<SpinMarble, SpinPuzzleSide<>::N_MARBLES> marbles;
+};
+
+//!< reader of the numbers of a game stored by SpinPuzzleGame::serialize
+class TextParser
+{
+public:
+  TextParser(const char* first, const char* last)
+    : m_first(first)
+    , m_pos(first)
+    , m_last(last)
+  {
+  }
+
+  //!< skip the blanks of the line
+  void skip()
+  {
+    while (m_pos != m_last && (*m_pos == ' ' || *m_pos == '\t')) {
+      ++m_pos;
+    }
+  }
+
+  //!< read the next number of the line
+  template<typename T>
+  bool number(T& value)
+  {
+    skip();
+    const auto result = std::from_chars(m_pos, m_last, value);
+    if (result.ec != std::errc() || result.ptr == m_pos ||
+        (result.ptr != m_last && !is_separator(*result.ptr))) {
+      return false;
+    }
+    m_pos = result.ptr;
+    return true;
+  }
+
+#if !defined(__cpp_lib_to_chars)
+  //!< read the next number of the line, for the standard libraries without
+  //!< std::from_chars for double
+  bool number(double& value)
+  {
+    skip();
+    // strtod needs a terminated string: the number is copied
+    char digits[64];
+    std::size_t size = 0;
+    while (m_pos + size != m_last && !is_separator(m_pos[size])) {
+      if (size + 1 == sizeof(digits)) {
+        return false;
+      }
+      digits[size] = m_pos[size];
+      ++size;
+    }
+    digits[size] = '\0';
+    char* end = nullptr;
+    value = std::strtod(digits, &end);
+    if (size == 0 || end != digits + size) {
+      return false;
+    }
+    m_pos += size;
+    return true;
+  }
+#endif
+
+  //!< read the next number, it must be in [0, max]
+  bool number(uint32_t& value, uint32_t max)
+  {
+    const char* pos = m_pos;
+    if (!number(value) || value > max) {
+      m_pos = pos;
+      skip();
+      return false;
+    }
+    return true;
+  }
+
+  //!< read the given character
+  bool expect(char c)
+  {
+    skip();
+    if (m_pos == m_last || *m_pos != c) {
+      return false;
+    }
+    ++m_pos;
+    return true;
+  }
+
+  //!< read the end of the line (or of the text)
+  bool end_of_line()
+  {
+    skip();
+    if (m_pos != m_last && *m_pos == '\r') {
+      ++m_pos;
+    }
+    if (m_pos == m_last) {
+      return true;
+    }
+    if (*m_pos != '\n') {
+      return false;
+    }
+    ++m_pos;
+    return true;
+  }
+
+  //!< offset of the current character
+  std::size_t offset() const { return m_pos - m_first; }
+
+private:
+  static bool is_separator(char c)
+  {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+  }
+
+  const char* m_first;
+  const char* m_pos;
+  const char* m_last;
+};
+
+} // namespace
+
 SpinPuzzleGame::SpinPuzzleGame(std::array<SpinMarble, 30> front,
                                std::array<SpinMarble, 30> back)
   : m_sides({ SpinPuzzleSide<10, 3>(std::move(front)),
-              SpinPuzzleSide<10, 3>(std::move(back)) }){};
+              SpinPuzzleSide<10, 3>(std::move(back)) })
+{
+  refresh();
+}
 
 bool
 SpinPuzzleGame::rotate_marbles(LEAF leaf, double angle)
 {
+  // the events store the angle exactly, so that a replay ends in this game
+  angle = SpinPuzzleSide<>::round_angle(angle);
   uint8_t n = static_cast<uint8_t>(m_active_side);
-  if (m_recorder) {
-    m_recorder->rotate_marbles(leaf, angle);
+  if (Recorder* recorder = this->recorder()) {
+    // a rotation of a leaf only adds to its shift: the recorder can merge it
+    // with the previous rotation of the same leaf
+    const bool additive =
+      leaf < LEAF::TREFOIL &&
+      m_sides[n].get_trifoild_status() == TREFOIL::LEAF_ROTATION;
+    recorder->rotate_marbles(leaf, angle, additive);
+  }
+  publish(event_bus(), Recorder::EventType::ROTATE_MARBLES, angle, leaf);
+  journal_begin(true);
+  if (!m_sides[n].rotate_marbles(leaf, angle)) {
+    return false;
   }
-  return m_sides[n].rotate_marbles(leaf, angle);
+  journal_end(JournalAction::ROTATE_MARBLES, leaf, angle);
+  if (m_sides[n].get_trifoild_status() == TREFOIL::BORDER_ROTATION ||
+      leaf >= LEAF::TREFOIL) {
+    update_side(m_active_side);
+  } else {
+    // a rotation inside a leaf does not change the same color count and
+    // the histogram of the colors
+    rehash_section(m_active_side, leaf);
+  }
+  return true;
 }
 
 bool
 SpinPuzzleGame::rotate_internal_disk(double angle)
 {
+  angle = SpinPuzzleSide<>::round_angle(angle);
   uint8_t n = static_cast<uint8_t>(m_active_side);
-  if (m_recorder) {
-    m_recorder->rotate_internal_disk(angle);
+  if (Recorder* recorder = this->recorder()) {
+    recorder->rotate_internal_disk(angle);
   }
-  return m_sides[n].rotate_internal_disk(angle);
+  publish(event_bus(), Recorder::EventType::ROTATE_INTERNAL_DISK, angle);
+  journal_begin(true);
+  if (!m_sides[n].rotate_internal_disk(angle)) {
+    return false;
+  }
+  journal_end(JournalAction::ROTATE_INTERNAL_DISK, LEAF::INVALID, angle);
+  // the marbles can move across the leaves
+  update_side(m_active_side);
+  return true;
 }
 
 void
@@ -49,23 +319,21 @@ SpinPuzzleGame::spin_leaf(LEAF leaf)
 bool
 SpinPuzzleGame::spin_leaf(LEAF leaf, double angle)
 {
-  if (m_recorder) {
-    m_recorder->spin_leaf(leaf, angle);
+  angle = SpinPuzzleSide<>::round_angle(angle);
+  if (Recorder* recorder = this->recorder()) {
+    recorder->spin_leaf(leaf, angle);
   }
+  publish(event_bus(), Recorder::Event::spin_type(angle), angle, leaf);
   if (!m_sides[static_cast<uint8_t>(m_active_side)].is_rotation_possible(
         leaf)) {
     return false;
   }
 
-  angle = fmod(angle, 360.0);
-  uint8_t n = static_cast<uint8_t>(leaf);
-  const double current_spin_angle = m_spin_rotation[n];
-  double updated_spin_angle = current_spin_angle + angle;
-
-  // spin angle is always between -90° and +90°:
-  // not enough rotation: no spin.
-  if (-90 <= updated_spin_angle && updated_spin_angle < 90) {
-    m_spin_rotation[n] = updated_spin_angle;
+  journal_begin(true, true);
+  double updated_spin_angle = 0.0;
+  if (!add_spin_rotation(leaf, angle, updated_spin_angle)) {
+    // the spin rotation has changed anyway
+    journal_end(JournalAction::SPIN_LEAF, leaf, angle);
     return false;
   }
   // whenever the new angle exceeds -90 or +90 then,
@@ -104,6 +372,38 @@ SpinPuzzleGame::spin_leaf(LEAF leaf, double angle)
     std::iter_swap(it_current, it_opposite);
   }
   update_spin_rotation_angle(leaf, updated_spin_angle);
+  // in border rotation the swapped marbles are not stored in the leaf
+  if (state_active == TREFOIL::BORDER_ROTATION) {
+    update_side(m_active_side);
+  } else {
+    update_section(m_active_side, leaf);
+  }
+  if (state_opposite == TREFOIL::BORDER_ROTATION) {
+    update_side(get_opposite_side(m_active_side));
+  } else {
+    update_section(get_opposite_side(m_active_side), opposite_leaf);
+  }
+  journal_end(JournalAction::SPIN_LEAF, leaf, angle);
+  return true;
+}
+
+bool
+SpinPuzzleGame::add_spin_rotation(LEAF leaf,
+                                  double angle,
+                                  double& updated_spin_angle)
+{
+  angle = fmod(angle, 360.0);
+  uint8_t n = static_cast<uint8_t>(leaf);
+  const double current_spin_angle = m_spin_rotation[n];
+  updated_spin_angle =
+    SpinPuzzleSide<>::round_angle(current_spin_angle + angle);
+
+  // spin angle is always between -90° and +90°:
+  // not enough rotation: no spin.
+  if (-90 <= updated_spin_angle && updated_spin_angle < 90) {
+    m_spin_rotation[n] = updated_spin_angle;
+    return false;
+  }
   return true;
 }
 
@@ -122,13 +422,18 @@ void SpinPuzzleGame::debug_iter(const char *name,
 void
 SpinPuzzleGame::swap_side()
 {
-  if (m_recorder) {
-    m_recorder->swap_side();
+  if (Recorder* recorder = this->recorder()) {
+    recorder->swap_side();
   }
+  publish(event_bus(), Recorder::EventType::SWAP_SIDE);
+  journal_begin(false);
+  m_hash ^= Zobrist::key(0, static_cast<Color>(m_active_side));
   m_active_side = get_opposite_side(m_active_side);
+  m_hash ^= Zobrist::key(0, static_cast<Color>(m_active_side));
   update_spin_rotation_angle(LEAF::NORTH);
   update_spin_rotation_angle(LEAF::EAST);
   update_spin_rotation_angle(LEAF::WEST);
+  journal_end(JournalAction::SWAP_SIDE);
 }
 
 bool
@@ -150,25 +455,6 @@ SpinPuzzleGame::to_string()
   return str + '\n';
 }
 
-bool
-SpinPuzzleGame::is_leaf_complete(const puzzle::SpinPuzzleSide<>& side,
-                                 LEAF leaf) const
-{
-  auto it = side.begin(leaf);
-  Color color = it->color();
-  size_t count_ok = 1;
-  size_t n = 0;
-  while (++n < puzzle::SpinPuzzleSide<>::GROUP_SIZE) {
-    ++it;
-    if (color == it->color()) {
-      ++count_ok;
-    } else {
-      return false;
-    }
-  }
-  return count_ok == puzzle::SpinPuzzleSide<>::GROUP_SIZE;
-}
-
 bool
 SpinPuzzleGame::is_game_solved() const
 {
@@ -182,13 +468,8 @@ SpinPuzzleGame::is_game_solved() const
     return false;
   }
 
-  // check every leaf:
-  return is_leaf_complete(front, LEAF::NORTH) &&
-         is_leaf_complete(front, LEAF::EAST) &&
-         is_leaf_complete(front, LEAF::WEST) &&
-         is_leaf_complete(back, LEAF::NORTH) &&
-         is_leaf_complete(back, LEAF::EAST) &&
-         is_leaf_complete(back, LEAF::WEST);
+  // every leaf has a single color
+  return m_same_color_total == 6 * SpinPuzzleSide<>::GROUP_SIZE;
 }
 
 bool
@@ -243,7 +524,7 @@ SpinPuzzleGame::update_spin_rotation_angle(LEAF leaf, double angle)
   } else {
     angle = 180 + angle;
   }
-  m_spin_rotation[n] = angle;
+  m_spin_rotation[n] = SpinPuzzleSide<>::round_angle(angle);
 }
 
 LEAF
@@ -357,17 +638,22 @@ void
 SpinPuzzleGame::reset()
 {
   m_active_side = SIDE::FRONT;
-  if (m_recorder) {
-    m_recorder->reset();
+  if (Recorder* recorder = this->recorder()) {
+    recorder->reset();
   }
   m_sides[0] = SpinPuzzleSide(createFrontMarbles());
   m_sides[1] = SpinPuzzleSide(createBackMarbles());
+  refresh();
 }
 
 bool
 SpinPuzzleGame::process_command(puzzle::COMMANDS command)
 {
   using namespace puzzle;
+  if (command < COMMANDS::N_COMMANDS && is_discrete_state()) {
+    process_discrete_command(command);
+    return true;
+  }
   switch (command) {
     // --------------------------------------------- //
     case COMMANDS::NORTH_RIGHT:
@@ -429,6 +715,305 @@ SpinPuzzleGame::process_command(puzzle::COMMANDS command)
   return true;
 }
 
+uint16_t
+SpinPuzzleGame::legal_commands() const
+{
+  auto bit = [](COMMANDS command) {
+    return static_cast<uint16_t>(1u << static_cast<uint8_t>(command));
+  };
+  const auto& side = get_side();
+  uint16_t mask = bit(COMMANDS::SWAP_SIDE);
+  if (side.is_marbles_rotation_effective()) {
+    for (uint8_t n = 0; n < 3; ++n) {
+      mask |= bit(static_cast<COMMANDS>(n)) | bit(static_cast<COMMANDS>(n + 3));
+    }
+  }
+  for (uint8_t n = 0; n < 3; ++n) {
+    // see spin_leaf and add_spin_rotation
+    const double angle = m_spin_rotation[n] + 180.0;
+    if (side.is_leaf_spinning_possible(static_cast<LEAF>(n)) &&
+        !(-90 <= angle && angle < 90)) {
+      mask |= bit(static_cast<COMMANDS>(n + 6));
+    }
+  }
+  if (side.is_internal_disk_rotation_effective()) {
+    mask |= bit(COMMANDS::INTERNAL_LEFT) | bit(COMMANDS::INTERNAL_RIGHT);
+  }
+  return mask;
+}
+
+bool
+SpinPuzzleGame::is_discrete_state() const
+{
+  return m_sides[0].is_discrete() && m_sides[1].is_discrete();
+}
+
+void
+SpinPuzzleGame::process_discrete_command(puzzle::COMMANDS command)
+{
+  // every branch reproduces the calls of the corresponding keys (see
+  // process_command), including the keyboard state and the recorded events.
+  auto& side = m_sides[static_cast<uint8_t>(m_active_side)];
+  const LEAF leaf = DiscreteMoves::leaf(command);
+  switch (command) {
+    case COMMANDS::NORTH_RIGHT:
+    case COMMANDS::EAST_RIGHT:
+    case COMMANDS::WEST_RIGHT:
+    case COMMANDS::NORTH_LEFT:
+    case COMMANDS::EAST_LEFT:
+    case COMMANDS::WEST_LEFT: {
+      const bool clockwise = command <= COMMANDS::WEST_RIGHT;
+      keyboard.selectSection(leaf);
+      if (Recorder* recorder = this->recorder()) {
+        const double direction = clockwise ? 1.0 : -1.0;
+        recorder->rotate_marbles(leaf, direction * SpinPuzzleSide<>::STEP);
+      }
+      publish(event_bus(),
+              Recorder::EventType::ROTATE_MARBLES,
+              (clockwise ? 1.0 : -1.0) * SpinPuzzleSide<>::STEP,
+              leaf);
+      journal_begin(false);
+      side.rotate_leaf_step(leaf, clockwise);
+      rehash_section(m_active_side, leaf);
+      journal_end(JournalAction::COMMAND, leaf, 0.0, command);
+      break;
+    }
+    case COMMANDS::NORTH_SPIN:
+    case COMMANDS::EAST_SPIN:
+    case COMMANDS::WEST_SPIN: {
+      keyboard.selectSection(leaf);
+      if (Recorder* recorder = this->recorder()) {
+        recorder->spin_leaf(leaf, 180.0);
+      }
+      publish(event_bus(), Recorder::EventType::SPIN_LEAF, 180.0, leaf);
+      journal_begin(false);
+      double updated_spin_angle = 0.0;
+      if (add_spin_rotation(leaf, 180.0, updated_spin_angle)) {
+        swap_spin_marbles(leaf);
+        update_spin_rotation_angle(leaf, updated_spin_angle);
+      }
+      journal_end(JournalAction::COMMAND, leaf, 0.0, command);
+      break;
+    }
+    case COMMANDS::INTERNAL_LEFT:
+    case COMMANDS::INTERNAL_RIGHT: {
+      keyboard.selectSection(LEAF::CENTER);
+      if (Recorder* recorder = this->recorder()) {
+        // the command puts the disk in phase: as a rotation by 0°
+        recorder->rotate_internal_disk(0.0);
+      }
+      publish(event_bus(), Recorder::EventType::ROTATE_INTERNAL_DISK);
+      // the previous status of the trefoil is lost
+      journal_begin(true);
+      side.rotate_internal_disk_in_phase();
+      journal_end(JournalAction::COMMAND, LEAF::INVALID, 0.0, command);
+      break;
+    }
+    case COMMANDS::SWAP_SIDE:
+      swap_side();
+      break;
+    default:
+      break;
+  }
+}
+
+void
+SpinPuzzleGame::swap_spin_marbles(LEAF leaf)
+{
+  auto& side = m_sides[static_cast<uint8_t>(m_active_side)];
+  const LEAF opposite_leaf = get_opposite_leaf(leaf);
+  auto& opposite =
+    m_sides[static_cast<uint8_t>(get_opposite_side(m_active_side))];
+  const auto& offsets = DiscreteMoves::spin_offsets(side.leaf_steps(leaf));
+  const auto& opposite_offsets =
+    DiscreteMoves::spin_offsets(opposite.leaf_steps(opposite_leaf));
+  for (size_t n = 0; n < DiscreteMoves::N_SPIN; ++n) {
+    std::swap(side.marble(leaf, offsets[n]),
+              opposite.marble(opposite_leaf, opposite_offsets[n]));
+  }
+  update_section(m_active_side, leaf);
+  update_section(get_opposite_side(m_active_side), opposite_leaf);
+}
+
+void
+SpinPuzzleGame::set_undo_limit(std::size_t limit)
+{
+  m_journal.reset();
+  if (limit > 0) {
+    m_journal.reset(new Journal);
+    m_journal->limit = limit;
+  }
+}
+
+void
+SpinPuzzleGame::clear_journal()
+{
+  if (!m_journal) {
+    return;
+  }
+  m_journal->first = 0;
+  m_journal->size = 0;
+  m_journal->applied = 0;
+}
+
+void
+SpinPuzzleGame::journal_begin(bool snapshot, bool both_sides)
+{
+  if (!is_journaling()) {
+    return;
+  }
+  Journal& journal = *m_journal;
+  auto& pending = journal.pending;
+  pending.active_side = m_active_side;
+  std::copy(
+    m_spin_rotation, m_spin_rotation + 3, pending.spin_rotation.begin());
+  if (!snapshot) {
+    return;
+  }
+  constexpr size_t N = SpinPuzzleSide<>::N_MARBLES;
+  const auto active = static_cast<size_t>(m_active_side);
+  journal.saved_sides = 0;
+  for (size_t s = 0; s < 2; ++s) {
+    pending.status[s] = m_sides[s].m_status;
+    if (both_sides || s == active) {
+      std::copy(m_sides[s].m_marbles.begin(),
+                m_sides[s].m_marbles.end(),
+                journal.marbles.begin() + s * N);
+      journal.saved_sides |= static_cast<uint8_t>(1u << s);
+    }
+  }
+}
+
+void
+SpinPuzzleGame::journal_end(JournalAction action,
+                            LEAF leaf,
+                            double angle,
+                            COMMANDS command)
+{
+  if (!is_journaling()) {
+    return;
+  }
+  // a new action drops the undone ones, and the oldest one if it is full
+  Journal& journal = *m_journal;
+  journal.size = journal.applied;
+  if (journal.size == journal.limit) {
+    journal.first = (journal.first + 1) % journal.limit;
+    --journal.size;
+  }
+  if (journal.entries.size() <= journal.size) {
+    // the buffer has not wrapped around yet
+    journal.entries.resize(journal.size + 1);
+  }
+  auto& entry = journal_entry(journal.size);
+  ++journal.size;
+  journal.applied = journal.size;
+
+  const auto& pending = journal.pending;
+  entry.action = action;
+  entry.command = command;
+  entry.leaf = leaf;
+  entry.angle = angle;
+  entry.active_side = pending.active_side;
+  entry.spin_rotation = pending.spin_rotation;
+  entry.marbles.clear();
+  if (entry.is_invertible()) {
+    return;
+  }
+  // only the marbles that have been moved
+  constexpr size_t N = SpinPuzzleSide<>::N_MARBLES;
+  entry.status = pending.status;
+  for (size_t s = 0; s < 2; ++s) {
+    if (!(journal.saved_sides & (1u << s))) {
+      continue;
+    }
+    for (size_t n = 0; n < N; ++n) {
+      const SpinMarble& marble = journal.marbles[s * N + n];
+      if (!(m_sides[s].m_marbles[n] == marble)) {
+        entry.marbles.emplace_back(static_cast<uint8_t>(s * N + n), marble);
+      }
+    }
+  }
+}
+
+bool
+SpinPuzzleGame::undo()
+{
+  if (undo_count() == 0 || recorder() || event_bus()) {
+    return false;
+  }
+  const auto& entry = journal_entry(--m_journal->applied);
+  if (entry.action == JournalAction::SWAP_SIDE) {
+    m_hash ^= Zobrist::key(0, static_cast<Color>(m_active_side));
+    m_active_side = entry.active_side;
+    m_hash ^= Zobrist::key(0, static_cast<Color>(m_active_side));
+    std::copy(
+      entry.spin_rotation.begin(), entry.spin_rotation.end(), m_spin_rotation);
+    return true;
+  }
+  if (entry.is_invertible()) {
+    const auto n = static_cast<uint8_t>(entry.command);
+    const double spin = entry.spin_rotation[n % 3];
+    std::copy(
+      entry.spin_rotation.begin(), entry.spin_rotation.end(), m_spin_rotation);
+    if (entry.command <= COMMANDS::WEST_LEFT) {
+      // a step in the other direction
+      get_side().rotate_leaf_step(entry.leaf,
+                                  entry.command > COMMANDS::WEST_RIGHT);
+      rehash_section(m_active_side, entry.leaf);
+    } else if (!(-90 <= spin + 180 && spin + 180 < 90)) {
+      // the spin has swapped the marbles (see add_spin_rotation)
+      swap_spin_marbles(entry.leaf);
+    }
+    return true;
+  }
+  constexpr size_t N = SpinPuzzleSide<>::N_MARBLES;
+  for (size_t s = 0; s < 2; ++s) {
+    auto& status = m_sides[s].m_status;
+    const int tollerance = status.tollerance();
+    status = entry.status[s];
+    status.set_tollerance(tollerance);
+  }
+  for (const auto& [position, marble] : entry.marbles) {
+    m_sides[position / N].m_marbles[position % N] = marble;
+  }
+  m_active_side = entry.active_side;
+  std::copy(
+    entry.spin_rotation.begin(), entry.spin_rotation.end(), m_spin_rotation);
+  recompute();
+  return true;
+}
+
+bool
+SpinPuzzleGame::redo()
+{
+  if (redo_count() == 0 || recorder() || event_bus()) {
+    return false;
+  }
+  // the game is as before the action: it has the same effect
+  const auto& entry = journal_entry(m_journal->applied);
+  m_journal->replaying = true;
+  switch (entry.action) {
+    case JournalAction::COMMAND:
+      process_discrete_command(entry.command);
+      break;
+    case JournalAction::ROTATE_MARBLES:
+      rotate_marbles(entry.leaf, entry.angle);
+      break;
+    case JournalAction::ROTATE_INTERNAL_DISK:
+      rotate_internal_disk(entry.angle);
+      break;
+    case JournalAction::SPIN_LEAF:
+      spin_leaf(entry.leaf, entry.angle);
+      break;
+    case JournalAction::SWAP_SIDE:
+      swap_side();
+      break;
+  }
+  m_journal->replaying = false;
+  ++m_journal->applied;
+  return true;
+}
+
 bool
 SpinPuzzleGame::process_key(int key, double fraction_angle)
 {
@@ -542,6 +1127,323 @@ SpinPuzzleGame::current_time_step() const
   return out;
 }
 
+uint64_t
+SpinPuzzleGame::section_hash(SIDE side, LEAF leaf) const
+{
+  // see SpinPuzzleSide::current_time_step for the layout of a section
+  constexpr size_t N = SpinPuzzleSide<>::GROUP_SIZE;
+  constexpr size_t N_FIXED = N - 3;
+  const size_t n_leaf = static_cast<size_t>(leaf);
+  const size_t start = ((side == SIDE::FRONT) ? 1 : (SIZE_STEP_ARRAY - 1) / 2) +
+                       n_leaf * (N + 3);
+  const auto& puzzle_side = get_side(side);
+  uint64_t hash = 0;
+  if (puzzle_side.get_trifoild_status() == TREFOIL::BORDER_ROTATION) {
+    for (size_t n = 0; n < N; ++n) {
+      const size_t index = start + n + ((n < N_FIXED) ? 0 : 3);
+      const auto& marble = puzzle_side.section_marble(LEAF::TREFOIL,
+                                                      n_leaf * N + n);
+      hash ^= Zobrist::key(index, marble.color());
+    }
+  } else {
+    for (size_t n = 0; n < N; ++n) {
+      const auto& marble = puzzle_side.section_marble(leaf, n);
+      hash ^= Zobrist::key(start + n, marble.color());
+    }
+  }
+  return hash;
+}
+
+void
+SpinPuzzleGame::rehash_section(SIDE side, LEAF leaf)
+{
+  const size_t n = 3 * static_cast<size_t>(side) + static_cast<size_t>(leaf);
+  const uint64_t hash = section_hash(side, leaf);
+  m_hash ^= m_section_hash[n] ^ hash;
+  m_section_hash[n] = hash;
+}
+
+void
+SpinPuzzleGame::rehash_side(SIDE side)
+{
+  rehash_section(side, LEAF::NORTH);
+  rehash_section(side, LEAF::EAST);
+  rehash_section(side, LEAF::WEST);
+}
+
+void
+SpinPuzzleGame::rehash()
+{
+  m_hash = Zobrist::key(0, static_cast<Color>(m_active_side));
+  m_section_hash.fill(0);
+  rehash_side(SIDE::FRONT);
+  rehash_side(SIDE::BACK);
+}
+
+void
+SpinPuzzleGame::recount_section(SIDE side, LEAF leaf)
+{
+  // the leaf as it is stored in the side: the count does not depend on its
+  // first marble
+  constexpr size_t N = SpinPuzzleSide<>::GROUP_SIZE;
+  const auto& puzzle_side = get_side(side);
+  Color previous = puzzle_side.marble(leaf, N - 1).color();
+  uint8_t count = 0;
+  for (size_t n = 0; n < N; ++n) {
+    const Color color = puzzle_side.marble(leaf, n).color();
+    count += color == previous;
+    previous = color;
+  }
+  const size_t n = 3 * static_cast<size_t>(side) + static_cast<size_t>(leaf);
+  m_same_color_total += count;
+  m_same_color_total -= m_same_color[n];
+  m_same_color[n] = count;
+}
+
+void
+SpinPuzzleGame::recount_colors(SIDE side, LEAF leaf)
+{
+  // see section_hash for the layout of a section
+  constexpr size_t N = SpinPuzzleSide<>::GROUP_SIZE;
+  constexpr size_t N_FIXED = N - 3;
+  const size_t n_leaf = static_cast<size_t>(leaf);
+  const auto& puzzle_side = get_side(side);
+  ColorHistogram histogram{};
+  if (puzzle_side.get_trifoild_status() == TREFOIL::BORDER_ROTATION) {
+    for (size_t n = 0; n < N_FIXED; ++n) {
+      const auto& marble =
+        puzzle_side.section_marble(LEAF::TREFOIL, n_leaf * N + n);
+      ++histogram[color_index(marble.color())];
+    }
+    histogram[color_index(SpinMarble::INVALID_COLOR)] += N - N_FIXED;
+  } else {
+    // the order of the marbles does not matter
+    for (size_t n = 0; n < N; ++n) {
+      ++histogram[color_index(puzzle_side.marble(leaf, n).color())];
+    }
+  }
+  m_color_histograms[3 * static_cast<size_t>(side) + n_leaf] = histogram;
+}
+
+void
+SpinPuzzleGame::update_section(SIDE side, LEAF leaf)
+{
+  rehash_section(side, leaf);
+  recount_section(side, leaf);
+  recount_colors(side, leaf);
+}
+
+void
+SpinPuzzleGame::update_side(SIDE side)
+{
+  update_section(side, LEAF::NORTH);
+  update_section(side, LEAF::EAST);
+  update_section(side, LEAF::WEST);
+}
+
+void
+SpinPuzzleGame::refresh()
+{
+  recompute();
+  clear_journal();
+}
+
+void
+SpinPuzzleGame::recompute()
+{
+  rehash();
+  m_same_color.fill(0);
+  m_same_color_total = 0;
+  for (auto side : { SIDE::FRONT, SIDE::BACK }) {
+    for (auto leaf : { LEAF::NORTH, LEAF::EAST, LEAF::WEST }) {
+      recount_section(side, leaf);
+      recount_colors(side, leaf);
+    }
+  }
+}
+
+std::size_t
+SpinPuzzleGame::serialize_binary(uint8_t* data, std::size_t size) const
+{
+  PackedState state;
+  const bool packed = state.pack(*this);
+  const std::size_t needed = packed ? BINARY_PACKED_SIZE : BINARY_SIZE;
+  if (size < needed) {
+    return 0;
+  }
+  BinaryWriter out(data);
+  out.u8(BINARY_MAGIC[0]);
+  out.u8(BINARY_MAGIC[1]);
+  out.u8(BINARY_VERSION);
+  if (packed) {
+    out.u8(BINARY_PACKED);
+    for (const uint64_t word : state.words()) {
+      out.u64(word);
+    }
+    return needed;
+  }
+  out.u8(BINARY_FULL);
+  out.u8(static_cast<uint8_t>(m_active_side));
+  for (const double angle : m_spin_rotation) {
+    out.f64(angle);
+  }
+  for (const auto& side : m_sides) {
+    const auto& status = side.m_status;
+    for (const int32_t shift : status.m_shifts_leaves) {
+      out.u32(static_cast<uint32_t>(shift));
+    }
+    out.u32(static_cast<uint32_t>(status.m_shift_cdisk));
+    for (const int32_t rest : status.m_rests_leaves) {
+      out.u32(static_cast<uint32_t>(rest));
+    }
+    out.u32(static_cast<uint32_t>(status.m_rest_cdisk));
+    for (const TREFOIL trefoil : status.m_trefoil_status) {
+      out.u8(static_cast<uint8_t>(trefoil));
+    }
+    for (const ROTATION rotation : status.m_rotation_status) {
+      out.u8(static_cast<uint8_t>(rotation));
+    }
+    for (const auto& marble : side.m_marbles) {
+      out.u32(static_cast<uint32_t>(marble.id()));
+      out.u32(static_cast<uint32_t>(marble.color()));
+    }
+  }
+  return needed;
+}
+
+std::size_t
+SpinPuzzleGame::load_binary(const uint8_t* data, std::size_t size)
+{
+  if (size < BINARY_HEADER_SIZE || data[0] != BINARY_MAGIC[0] ||
+      data[1] != BINARY_MAGIC[1] || data[2] != BINARY_VERSION) {
+    return 0;
+  }
+  BinaryReader in(data + BINARY_HEADER_SIZE);
+  if (data[3] == BINARY_PACKED) {
+    if (size < BINARY_PACKED_SIZE) {
+      return 0;
+    }
+    std::array<uint64_t, PackedState::N_WORDS> words;
+    for (auto& word : words) {
+      word = in.u64();
+    }
+    // every id must appear once
+    const PackedState state(words);
+    uint64_t ids = 0;
+    for (const SIDE side : { SIDE::FRONT, SIDE::BACK }) {
+      for (std::size_t n = 0; n < SpinPuzzleSide<>::N_MARBLES; ++n) {
+        const int32_t id = state.marble_id(side, n);
+        if (id >= static_cast<int32_t>(PackedState::N_MARBLES) ||
+            (ids & (uint64_t{ 1 } << id))) {
+          return 0;
+        }
+        ids |= uint64_t{ 1 } << id;
+      }
+    }
+    if (!state.unpack(*this)) {
+      return 0;
+    }
+    return BINARY_PACKED_SIZE;
+  }
+  if (data[3] != BINARY_FULL || size < BINARY_SIZE) {
+    return 0;
+  }
+  // read and check the whole game before touching it
+  using Side = SpinPuzzleSide<>;
+  const uint8_t active_side = in.u8();
+  if (active_side > 1) {
+    return 0;
+  }
+  double spin_rotation[3];
+  for (double& angle : spin_rotation) {
+    angle = in.f64();
+    if (!std::isfinite(angle)) {
+      return 0;
+    }
+  }
+  auto valid_rest = [](int32_t rest) {
+    return -Side::RESTS_PER_TICK / 2 <= rest && rest < Side::RESTS_PER_TICK / 2;
+  };
+  std::array<BinarySide, 2> sides;
+  uint64_t ids = 0;
+  for (BinarySide& side : sides) {
+    for (int32_t& shift : side.shifts_leaves) {
+      shift = static_cast<int32_t>(in.u32());
+      if (shift < 0 || shift >= Side::TICKS_PER_TURN) {
+        return 0;
+      }
+    }
+    side.shift_cdisk = static_cast<int32_t>(in.u32());
+    if (std::abs(side.shift_cdisk) >= Side::TICKS_PER_TURN) {
+      return 0;
+    }
+    for (int32_t& rest : side.rests_leaves) {
+      rest = static_cast<int32_t>(in.u32());
+      if (!valid_rest(rest)) {
+        return 0;
+      }
+    }
+    side.rest_cdisk = static_cast<int32_t>(in.u32());
+    if (!valid_rest(side.rest_cdisk)) {
+      return 0;
+    }
+    for (TREFOIL& trefoil : side.trefoil_status) {
+      trefoil = static_cast<TREFOIL>(in.u8());
+      if (trefoil > TREFOIL::BORDER_ROTATION) {
+        return 0;
+      }
+    }
+    for (ROTATION& rotation : side.rotation_status) {
+      rotation = static_cast<ROTATION>(in.u8());
+      if (rotation > ROTATION::INVALID) {
+        return 0;
+      }
+    }
+    // every id must appear once, as in a packed game
+    for (auto& marble : side.marbles) {
+      const uint32_t id = in.u32();
+      const auto color = static_cast<Color>(in.u32());
+      if (id >= PackedState::N_MARBLES || (ids & (uint64_t{ 1 } << id))) {
+        return 0;
+      }
+      ids |= uint64_t{ 1 } << id;
+      marble = SpinMarble(static_cast<int32_t>(id), color);
+    }
+  }
+
+  m_active_side = static_cast<SIDE>(active_side);
+  std::transform(std::begin(spin_rotation),
+                 std::end(spin_rotation),
+                 std::begin(m_spin_rotation),
+                 Side::round_angle);
+  for (std::size_t s = 0; s < 2; ++s) {
+    BinarySide& values = sides[s];
+    auto& side = m_sides[s];
+    auto& status = side.m_status;
+    std::copy(std::begin(values.shifts_leaves),
+              std::end(values.shifts_leaves),
+              std::begin(status.m_shifts_leaves));
+    status.m_shift_cdisk = values.shift_cdisk;
+    std::copy(std::begin(values.rests_leaves),
+              std::end(values.rests_leaves),
+              std::begin(status.m_rests_leaves));
+    status.m_rest_cdisk = values.rest_cdisk;
+    std::copy(std::begin(values.trefoil_status),
+              std::end(values.trefoil_status),
+              std::begin(status.m_trefoil_status));
+    std::copy(std::begin(values.rotation_status),
+              std::end(values.rotation_status),
+              std::begin(status.m_rotation_status));
+    std::move(values.marbles.begin(),
+              values.marbles.end(),
+              side.m_marbles.begin());
+    status.m_discrete_cached = false;
+    status.update_first_marbles();
+  }
+  refresh();
+  return BINARY_SIZE;
+}
+
 std::FILE*
 SpinPuzzleGame::serialize(std::FILE* file) const
 {
@@ -559,29 +1461,112 @@ SpinPuzzleGame::serialize(std::string& string) const
   return string;
 }
 
-// TODO: Improve performance !!!
+std::size_t
+SpinPuzzleGame::load_text(const char* data,
+                          std::size_t size,
+                          std::size_t* error)
+{
+  constexpr std::size_t N_SIDE_MARBLES = SpinPuzzleSide<>::N_MARBLES;
+  using Side = SpinPuzzleSide<10, 3>;
+  struct SideValues
+  {
+    double shifts[4];
+    uint32_t trefoil[2];
+    uint32_t rotation[4];
+    int32_t ids[N_SIDE_MARBLES];
+    Color colors[N_SIDE_MARBLES];
+  };
+
+  // parse every value before touching the game
+  TextParser in(data, data + size);
+  uint32_t version = 0;
+  uint32_t active_side = 0;
+  double spin_rotation[3];
+  SideValues sides[2];
+  bool valid = in.expect('v') && in.number(version, 0) &&
+               in.number(active_side, 1);
+  for (double& angle : spin_rotation) {
+    valid = valid && in.number(angle);
+  }
+  for (SideValues& side : sides) {
+    for (double& shift : side.shifts) {
+      valid = valid && in.number(shift);
+    }
+    for (uint32_t& trefoil : side.trefoil) {
+      constexpr auto max = static_cast<uint32_t>(TREFOIL::BORDER_ROTATION);
+      valid = valid && in.number(trefoil, max);
+    }
+    for (uint32_t& rotation : side.rotation) {
+      valid = valid &&
+              in.number(rotation, static_cast<uint32_t>(ROTATION::INVALID));
+    }
+    for (std::size_t n = 0; n < N_SIDE_MARBLES; ++n) {
+      valid = valid && in.number(side.ids[n]) && in.number(side.colors[n]);
+    }
+  }
+  valid = valid && in.end_of_line();
+  if (!valid) {
+    if (error) {
+      *error = in.offset();
+    }
+    return 0;
+  }
+
+  m_active_side = static_cast<SIDE>(active_side);
+  // the spins are written with less digits than a double
+  std::transform(std::begin(spin_rotation),
+                 std::end(spin_rotation),
+                 std::begin(m_spin_rotation),
+                 SpinPuzzleSide<>::round_angle);
+  for (std::size_t s = 0; s < 2; ++s) {
+    const SideValues& values = sides[s];
+    auto& side = m_sides[s];
+    auto& status = side.m_status;
+    for (std::size_t n = 0; n < 3; ++n) {
+      status.m_rests_leaves[n] = 0;
+      status.m_shifts_leaves[n] =
+        Side::wrap(Side::to_ticks(values.shifts[n], status.m_rests_leaves[n]));
+    }
+    status.m_rest_cdisk = 0;
+    status.m_shift_cdisk =
+      Side::to_ticks(values.shifts[3], status.m_rest_cdisk);
+    for (std::size_t n = 0; n < 2; ++n) {
+      status.m_trefoil_status[n] = static_cast<TREFOIL>(values.trefoil[n]);
+    }
+    for (std::size_t n = 0; n < 4; ++n) {
+      status.m_rotation_status[n] = static_cast<ROTATION>(values.rotation[n]);
+    }
+    for (std::size_t n = 0; n < N_SIDE_MARBLES; ++n) {
+      side.m_marbles[n] = SpinMarble(values.ids[n], values.colors[n]);
+    }
+    status.m_discrete_cached = false;
+    status.update_first_marbles();
+  }
+  refresh();
+  return in.offset();
+}
+
 std::FILE*
 SpinPuzzleGame::load(std::FILE* file)
 {
-  std::string str;
-  char c;
-  do {
-    c = std::fgetc(file);
-  } while (c != '\0' && c != 'v');
-  // empty file
-  if (c == '\0') {
-    return file;
+  // only the line of the game is read: the next games are left in the file,
+  // even if it is a pipe
+  constexpr const char* BLANKS = " \t\r\n";
+  char buffer[1024];
+  std::string line;
+  while (std::fgets(buffer, sizeof(buffer), file)) {
+    line += buffer;
+    if (line.back() != '\n') {
+      continue;
+    }
+    if (line.find_first_not_of(BLANKS) != std::string::npos) {
+      break;
+    }
+    line.clear();
   }
-  std::stringstream s;
-  s << c;
-  c = std::fgetc(file);
-  assert(c == '0'); // version
-  s << c;
-  while (c != '\n') {
-    c = std::fgetc(file);
-    s << c;
+  if (line.find_first_not_of(BLANKS) != std::string::npos) {
+    load_text(line.data(), line.size());
   }
-  load(s);
   return file;
 }
 
@@ -619,12 +1604,66 @@ SpinPuzzleGame::get_side() const
   return get_side(get_active_side());
 }
 
+// the definition only changes the functions below: inlined in the actions
+// of this file, their checks are removed by the compiler
+#if defined(QSPIN_PUZZLE_NO_RECORDER)
+Recorder*
+SpinPuzzleGame::recorder() const
+{
+  return nullptr;
+}
+
+EventBus*
+SpinPuzzleGame::event_bus() const
+{
+  return nullptr;
+}
+
+void
+SpinPuzzleGame::attach_recorder(std::shared_ptr<Recorder>)
+{
+}
+
+void
+SpinPuzzleGame::attach_event_bus(EventBus*)
+{
+}
+
+void
+SpinPuzzleGame::start_recording()
+{
+}
+
+std::shared_ptr<Recorder>
+SpinPuzzleGame::detached_recorder()
+{
+  return nullptr;
+}
+#else
+Recorder*
+SpinPuzzleGame::recorder() const
+{
+  return m_recorder.get();
+}
+
+EventBus*
+SpinPuzzleGame::event_bus() const
+{
+  return m_event_bus;
+}
+
 void
 SpinPuzzleGame::attach_recorder(std::shared_ptr<Recorder> recorder)
 {
   m_recorder = recorder;
 }
 
+void
+SpinPuzzleGame::attach_event_bus(EventBus* bus)
+{
+  m_event_bus = bus;
+}
+
 void
 SpinPuzzleGame::start_recording()
 {
@@ -642,5 +1681,6 @@ SpinPuzzleGame::detached_recorder()
   m_recorder = nullptr;
   return tmp;
 }
+#endif
 
 } // namespace puzzle
@@ -1,16 +1,23 @@
 #ifndef SPINPUZZLEGAME_H
 #define SPINPUZZLEGAME_H
 
+#include <algorithm>
 #include <functional>
+#include <limits>
 #include <memory>
 #include <sstream>
+#include <utility>
+#include <vector>
 
 #include "spin_configuration.h"
 #include "spin_puzzle_side.h"
 
 namespace puzzle {
 
+class EventBus;
 class Recorder;
+class PackedState;
+class SpinPuzzleBatch;
 
 /**
  * @brief This class rappresent the Two-sided Trefoil, the base for the game
@@ -62,7 +69,63 @@ public:
    */
   bool process_key(int key, double fraction_angle);
 
-  bool process_command(puzzle::COMMANDS commands);
+  /**
+   * @brief  process a command
+   * @note   if the game is in a discrete state (see \ref is_discrete_state )
+   *         the command is applied directly as a permutation of the marbles,
+   *         with the same result of the corresponding sequence of keys.
+   * @param  command: command to process
+   * @retval true if the command is valid
+   */
+  bool process_command(puzzle::COMMANDS command);
+
+  /**
+   * @brief  keep a journal of the last actions for \ref undo and \ref redo
+   * @note   the journal is disabled by default (limit 0). When it is full
+   *         the oldest action is dropped. The journal is cleared by a new
+   *         limit, by \ref reset , \ref load and \ref refresh .
+   * @param  limit: maximum number of actions that can be undone
+   */
+  void set_undo_limit(std::size_t limit);
+
+  //!< maximum number of actions that can be undone (0: no journal)
+  std::size_t undo_limit() const { return m_journal ? m_journal->limit : 0; }
+
+  //!< number of actions that can be undone
+  std::size_t undo_count() const { return m_journal ? m_journal->applied : 0; }
+
+  //!< number of undone actions that can be redone
+  std::size_t redo_count() const
+  {
+    return m_journal ? m_journal->size - m_journal->applied : 0;
+  }
+
+  /**
+   * @brief  undo the last action (see \ref set_undo_limit )
+   * @note   the action is inverted in place from the data stored in the
+   *         journal: a discrete command by its inverse, any other action by
+   *         restoring the status of the sides and the marbles it moved. The
+   *         keyboard state is left untouched.
+   * @retval true if an action has been undone, false if there is none or a
+   *         recorder or an event bus is attached (they would not see the
+   *         undo)
+   */
+  bool undo();
+
+  /**
+   * @brief  apply again the last undone action
+   * @note   a new action drops the actions that can be redone
+   * @retval true if an action has been redone, false if there is none or a
+   *         recorder or an event bus is attached
+   */
+  bool redo();
+
+  /**
+   * @brief  check if both sides are in a discrete configuration
+   * @note   see \ref SpinPuzzleSide::is_discrete
+   * @retval true if the commands can be applied as permutations
+   */
+  bool is_discrete_state() const;
 
   /**
    * @brief  shuffle the marbles with a sequence of operations
@@ -97,7 +160,9 @@ public:
   /**
    * @brief rotate marbles in the leaf:
    *
-   * @note \ref SpinPuzzleSide::rotate_marbles
+   * @note \ref SpinPuzzleSide::rotate_marbles , the angles of the actions
+   *       are rounded to \ref SpinPuzzleSide::round_angle so that a
+   *       recording replays them exactly
    * @param  leaf: leaf to spin (\ref puzzle LEAF)
    * @param  angle: angle to rotate (in degree)
    * @retval true on success
@@ -170,11 +235,73 @@ public:
 
   /**
    * @brief  this function check if a game is solved
-   * @note   the game must be in LEAF_ROTATION state
+   * @note   the game must be in LEAF_ROTATION state. The check reads the
+   *         counters of \ref same_color_count and it does not scan the
+   *         marbles.
    * @retval true if the game is solved.
    */
   bool is_game_solved() const;
 
+  /**
+   * @brief  commands that change the game (see \ref process_command )
+   * @note   a command is left out if it does not move any marble or any
+   *         part of the active side, or if it does not change the active
+   *         side:
+   *           - rotations when the trefoil of the active side can not
+   *             rotate;
+   *           - spins of a leaf with \ref ROTATION::INVALID , or that stay
+   *             in the ±90° window of the spin rotation;
+   *           - INTERNAL_LEFT and INTERNAL_RIGHT (a rotation of the internal
+   *             disk by 0°) when they leave the trefoil as it is, e.g. in a
+   *             discrete state (see \ref is_discrete_state ).
+   *         The keyboard state is not considered.
+   * @retval mask with bit n set if the command n of \ref COMMANDS changes
+   *         the game
+   */
+  uint16_t legal_commands() const;
+
+  /**
+   * @brief  number of consecutive marbles of a leaf with the same color
+   * @note   the marbles of the leaf are taken in a circle: the count is
+   *         GROUP_SIZE if and only if the leaf has a single color. It is
+   *         updated incrementally by every action.
+   * @param  side: side of the leaf
+   * @param  leaf: leaf (NORTH, EAST or WEST) in LEAF_ROTATION state
+   * @retval count in [0, GROUP_SIZE]
+   */
+  std::size_t same_color_count(SIDE side, LEAF leaf) const
+  {
+    return m_same_color[3 * static_cast<size_t>(side) +
+                        static_cast<size_t>(leaf)];
+  }
+
+  /**
+   * @brief  progress of the game: sum of \ref same_color_count over the
+   *         leaves
+   * @retval count in [0, 6 * GROUP_SIZE], the maximum when the game is
+   *         solved
+   */
+  std::size_t same_color_count() const { return m_same_color_total; }
+
+  //!< number of marbles of every color (see \ref color_index ) in a section
+  using ColorHistogram = std::array<uint8_t, N_MARBLE_COLORS>;
+
+  /**
+   * @brief  colors of the first GROUP_SIZE entries of a section of
+   *         \ref current_time_step
+   * @note   in BORDER_ROTATION state the entries are 7 marbles and the 3
+   *         empty places of the section, which count as yellow (see
+   *         \ref color_index ). It is updated incrementally by every action.
+   * @param  side: side of the section
+   * @param  leaf: leaf of the section (NORTH, EAST or WEST)
+   * @retval histogram of the colors
+   */
+  const ColorHistogram& color_histogram(SIDE side, LEAF leaf) const
+  {
+    return m_color_histograms[3 * static_cast<size_t>(side) +
+                              static_cast<size_t>(leaf)];
+  }
+
   /**
    * @brief Convenient callback to be able to implement
    * tensorflow::tf_environment
@@ -194,6 +321,30 @@ public:
    */
   std::array<Color, puzzle::SIZE_STEP_ARRAY> current_time_step() const;
 
+  /**
+   * @brief  Zobrist hash of the game (see \ref Zobrist )
+   * @note   the hash is a function of \ref current_time_step : games with
+   *         the same observation have the same hash. It is updated
+   *         incrementally by every action.
+   * @retval 64-bit hash
+   */
+  uint64_t hash() const { return m_hash; }
+
+  /**
+   * @brief  recompute the hash from scratch
+   * @note   it is needed only after modifying a side directly (e.g. via
+   *         get_side() ), see also \ref refresh
+   */
+  void rehash();
+
+  /**
+   * @brief  recompute from scratch everything that is updated incrementally
+   *         by the actions (\ref hash , \ref same_color_count ,
+   *         \ref color_histogram ) and clear the journal of \ref undo
+   * @note   it is needed only after modifying a side directly
+   */
+  void refresh();
+
   /**
    * @brief  set parameter form the configuration
    * @note
@@ -210,6 +361,10 @@ public:
   template<typename Buffer>
   Buffer& serialize(Buffer& buffer) const
   {
+    // the angles that are not a whole number of ticks are kept with their
+    // rest, the others are written as before (e.g. 354.45)
+    const auto precision = buffer.precision(std::max<std::streamsize>(
+      buffer.precision(), std::numeric_limits<double>::digits10));
     buffer << "v0"
            << " " << static_cast<uint32_t>(m_active_side) << " "
            << m_spin_rotation[0] << " " << m_spin_rotation[1] << " "
@@ -217,6 +372,7 @@ public:
     m_sides[static_cast<uint8_t>(SIDE::FRONT)].serialize(buffer);
     m_sides[static_cast<uint8_t>(SIDE::BACK)].serialize(buffer);
     buffer << "\n";
+    buffer.precision(precision);
     return buffer;
   }
 
@@ -229,30 +385,119 @@ public:
     buffer >> version;
     buffer >> active_side;
     m_active_side = static_cast<SIDE>(active_side);
-    buffer >> m_spin_rotation[0];
-    buffer >> m_spin_rotation[1];
-    buffer >> m_spin_rotation[2];
+    // the spins are written with less digits than a double
+    for (double& angle : m_spin_rotation) {
+      buffer >> angle;
+      angle = SpinPuzzleSide<>::round_angle(angle);
+    }
 
     m_sides[static_cast<uint8_t>(SIDE::FRONT)].load(buffer);
     m_sides[static_cast<uint8_t>(SIDE::BACK)].load(buffer);
+    refresh();
 
     return buffer;
   }
 
+  //!< version of the binary format
+  static constexpr uint8_t BINARY_VERSION = 1;
+  //!< bytes of a game stored as a \ref PackedState
+  static constexpr std::size_t BINARY_PACKED_SIZE = 76;
+  //!< bytes of any game in the binary format
+  static constexpr std::size_t BINARY_SIZE = 585;
+
+  /**
+   * @brief  store the game in the binary format (little-endian)
+   * @note   after a header of 4 bytes, the game is stored as the words of a
+   *         \ref PackedState (BINARY_PACKED_SIZE bytes) if it can be packed,
+   *         otherwise with the exact spin rotations, the rests of the
+   *         rotations of the sides and every id and color of the marbles.
+   *         As in \ref serialize the tollerance, the keyboard and the
+   *         recorder are not stored.
+   * @param  data: buffer to write
+   * @param  size: size of the buffer, BINARY_SIZE is enough for any game
+   * @retval bytes written, 0 if the buffer is too small
+   */
+  std::size_t serialize_binary(uint8_t* data, std::size_t size) const;
+
+  /**
+   * @brief  load a game stored by \ref serialize_binary
+   * @note   nothing is allocated. The whole game is checked before it is
+   *         loaded: the ids of the marbles must be unique and below
+   *         \ref PackedState::N_MARBLES , the shifts within a turn, the
+   *         spins finite and the statuses valid
+   * @param  data: buffer to read
+   * @param  size: bytes available in the buffer
+   * @retval bytes read, 0 if the data is not valid (the game is then left
+   *         untouched)
+   */
+  std::size_t load_binary(const uint8_t* data, std::size_t size);
+
+  /**
+   * @brief  load a game stored by \ref serialize from a text buffer
+   * @note   the numbers are parsed with std::from_chars (std::strtod for
+   *         the angles if the standard library lacks it), nothing is
+   *         allocated. The buffer may hold further games after this one.
+   * @param  data: text to read
+   * @param  size: characters available in the buffer
+   * @param  error: if not null, it is set to the offset in the buffer of
+   *         the first invalid character when the game can not be loaded
+   * @retval characters read (up to the end of the line of the game), 0 if
+   *         the text is not a valid game (the game is then left untouched)
+   */
+  std::size_t load_text(const char* data,
+                        std::size_t size,
+                        std::size_t* error = nullptr);
+
   std::FILE* serialize(std::FILE* file) const;
 
   std::string serialize(std::string& string) const;
 
+  /**
+   * @brief  load the next game stored by \ref serialize in a file
+   * @note   only the line of the game is read, blank lines are skipped:
+   *         the next games are left in the file. Use a \ref GameReader to
+   *         load the games of a whole file in blocks and to know where an
+   *         invalid game is.
+   * @param  file: file to read
+   * @retval the file; the game is left untouched if no valid game is found
+   */
   std::FILE* load(std::FILE* file);
 
   std::string load(std::string& string);
 
+  /**
+   * @brief  attach a recorder that receives every action of the game
+   * @note   with QSPIN_PUZZLE_NO_RECORDER defined when building the game
+   *         (e.g. for the solver and the training) the recording is
+   *         compiled out of the actions: the recorder is ignored and
+   *         \ref detached_recorder returns nullptr. The layout of the game
+   *         does not depend on the definition. While a recorder is attached
+   *         \ref undo and \ref redo do nothing.
+   * @param  recorder: recorder to attach
+   */
   void attach_recorder(std::shared_ptr<Recorder> recorder);
   void start_recording();
 
   std::shared_ptr<Recorder> detached_recorder();
 
+  /**
+   * @brief  publish every action on a bus, see \ref EventBus
+   * @note   the events carry the angles applied by the game (see
+   *         \ref rotate_marbles ). Like the recorder, the bus is compiled out
+   *         with QSPIN_PUZZLE_NO_RECORDER and, while attached, it disables
+   *         \ref undo and \ref redo . A copy of the game is not attached to
+   *         the bus.
+   * @param  bus: bus that outlives the game, nullptr to detach it
+   */
+  void attach_event_bus(EventBus* bus);
+
+  //!< bus the actions are published on
+  EventBus* event_bus() const;
+
 private:
+  friend class PackedState;
+  friend class SpinPuzzleBatch;
+
   class KeyboardState
   {
   public:
@@ -266,8 +511,6 @@ private:
     puzzle::LEAF section = puzzle::LEAF::INVALID;
   };
 
-  bool is_leaf_complete(const puzzle::SpinPuzzleSide<>& side, LEAF leaf) const;
-
   //!< sides of a trefoil
   std::array<puzzle::SpinPuzzleSide<>, 2> m_sides;
   //!< which side of a trefoil is currently active
@@ -281,6 +524,35 @@ private:
   //!< state when input is given by a batch
   KeyboardState keyboard;
 
+  //!< hash of the observation, see \ref hash
+  uint64_t m_hash = 0;
+  //!< contribution to the hash of every section (side, leaf)
+  std::array<uint64_t, 6> m_section_hash{};
+
+  //!< compute the contribution to the hash of a section of the observation
+  uint64_t section_hash(SIDE side, LEAF leaf) const;
+  //!< update the hash after the marbles in a section have changed
+  void rehash_section(SIDE side, LEAF leaf);
+  //!< update the hash after the marbles of a side have changed
+  void rehash_side(SIDE side);
+
+  //!< see \ref same_color_count , for every section (side, leaf)
+  std::array<uint8_t, 6> m_same_color{};
+  //!< sum of m_same_color
+  std::size_t m_same_color_total = 0;
+
+  //!< see \ref color_histogram , for every section (side, leaf)
+  std::array<ColorHistogram, 6> m_color_histograms{};
+
+  //!< update the same color count after the marbles of a leaf have changed
+  void recount_section(SIDE side, LEAF leaf);
+  //!< update the histogram after the marbles of a section have changed
+  void recount_colors(SIDE side, LEAF leaf);
+  //!< update the trackers after the marbles in a section have changed
+  void update_section(SIDE side, LEAF leaf);
+  //!< update the trackers after the marbles of a side have changed
+  void update_side(SIDE side);
+
   /**
    * @brief  get opposite leave for for the spin
    * @param  leaf: leaf to spin
@@ -297,9 +569,155 @@ private:
 
   void update_spin_rotation_angle(LEAF leaf, double angle);
   void update_spin_rotation_angle(LEAF leaf);
+  /**
+   * @brief  add an angle to the spin of a leaf
+   * @param  leaf: leaf to spin
+   * @param  angle: angle to add (in degree)
+   * @param  updated_spin_angle: new spin angle of the leaf
+   * @retval true if the marbles have to be swapped
+   */
+  bool add_spin_rotation(LEAF leaf, double angle, double& updated_spin_angle);
+  //!< process a command when the game is in a discrete state
+  void process_discrete_command(puzzle::COMMANDS command);
   bool check_consistency_side(SIDE side, bool verbose);
+  //!< \ref refresh without clearing the journal
+  void recompute();
+
+  //!< action stored in the journal
+  enum class JournalAction : uint8_t
+  {
+    COMMAND, //!< command applied by \ref process_discrete_command
+    ROTATE_MARBLES,
+    ROTATE_INTERNAL_DISK,
+    SPIN_LEAF,
+    SWAP_SIDE
+  };
+
+  //!< entry of the journal: an action and the data to invert it
+  struct JournalEntry
+  {
+    JournalAction action = JournalAction::COMMAND;
+    COMMANDS command = COMMANDS::N_COMMANDS;
+    LEAF leaf = LEAF::INVALID;
+    double angle = 0.0;
+    //!< active side and spin rotation before the action
+    SIDE active_side = SIDE::FRONT;
+    std::array<double, 3> spin_rotation{};
+    //!< status of the sides before the action, see \ref is_invertible
+    std::array<SpinPuzzleSide<>::Status, 2> status;
+    //!< marbles moved by the action: position (side * N_MARBLES + index)
+    //!< and previous marble, see \ref is_invertible
+    std::vector<std::pair<uint8_t, SpinMarble>> marbles;
+
+    //!< check if the action is undone without the status and the marbles
+    bool is_invertible() const
+    {
+      return action == JournalAction::SWAP_SIDE ||
+             (action == JournalAction::COMMAND &&
+              command < COMMANDS::INTERNAL_LEFT);
+    }
+  };
+
+  //!< journal of the actions, it exists only while \ref undo is enabled
+  struct Journal
+  {
+    //!< entries in a circular buffer of limit entries
+    std::vector<JournalEntry> entries;
+    std::size_t limit = 0;
+    //!< index of the oldest entry
+    std::size_t first = 0;
+    //!< number of entries
+    std::size_t size = 0;
+    //!< number of entries applied to the game (the others can be redone)
+    std::size_t applied = 0;
+    //!< true while an action is redone: it is already in the journal
+    bool replaying = false;
+    //!< state before the current action
+    JournalEntry pending;
+    //!< marbles of the sides saved by journal_begin (side * N_MARBLES +
+    //!< index) and the sides saved (one bit for every side)
+    std::array<SpinMarble, 2 * SpinPuzzleSide<>::N_MARBLES> marbles;
+    uint8_t saved_sides = 0;
+  };
+
+  //!< owner of the journal: a copy of the game has a copy of the journal,
+  //!< a game without journal only carries a null pointer
+  class JournalPtr
+  {
+  public:
+    JournalPtr() = default;
+    JournalPtr(const JournalPtr& other)
+      : m_journal(other ? std::make_unique<Journal>(*other) : nullptr)
+    {
+    }
+    JournalPtr& operator=(const JournalPtr& other)
+    {
+      if (this != &other) {
+        m_journal = other ? std::make_unique<Journal>(*other) : nullptr;
+      }
+      return *this;
+    }
+    void reset(Journal* journal = nullptr) { m_journal.reset(journal); }
+    explicit operator bool() const { return m_journal != nullptr; }
+    Journal& operator*() const { return *m_journal; }
+    Journal* operator->() const { return m_journal.get(); }
+
+  private:
+    std::unique_ptr<Journal> m_journal;
+  };
+
+  JournalPtr m_journal;
+
+  bool is_journaling() const { return m_journal && !m_journal->replaying; }
+  //!< remove all the entries of the journal
+  void clear_journal();
+  /**
+   * @brief  save the state before an action
+   * @param  snapshot: save the status of the sides and the marbles, needed
+   *         unless the action is invertible (see \ref JournalEntry )
+   * @param  both_sides: the action can move the marbles of both sides,
+   *         otherwise only the marbles of the active side are saved
+   */
+  void journal_begin(bool snapshot, bool both_sides = false);
+  //!< add the action to the journal, with the state saved by journal_begin
+  void journal_end(JournalAction action,
+                   LEAF leaf = LEAF::INVALID,
+                   double angle = 0.0,
+                   COMMANDS command = COMMANDS::N_COMMANDS);
+  //!< entry of the journal at the given position from the oldest one
+  JournalEntry& journal_entry(std::size_t n)
+  {
+    return m_journal->entries[(m_journal->first + n) % m_journal->limit];
+  }
+  //!< swap the marbles exchanged by the discrete spin of a leaf
+  void swap_spin_marbles(LEAF leaf);
+
+  //!< nullptr when the recording is compiled out, see \ref attach_recorder
+  Recorder* recorder() const;
 
   std::shared_ptr<Recorder> m_recorder = nullptr;
+
+  //!< bus of a game, that is not copied: a copy of the game (e.g. in a
+  //!< search) does not publish its moves, an assignment keeps the bus of
+  //!< the game assigned
+  class BusPtr
+  {
+  public:
+    BusPtr() = default;
+    BusPtr(const BusPtr&) {}
+    BusPtr& operator=(const BusPtr&) { return *this; }
+    BusPtr& operator=(EventBus* bus)
+    {
+      m_bus = bus;
+      return *this;
+    }
+    operator EventBus*() const { return m_bus; }
+
+  private:
+    EventBus* m_bus = nullptr;
+  };
+
+  BusPtr m_event_bus;
 };
 
 } // namespace puzzle
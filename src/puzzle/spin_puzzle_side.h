@@ -3,15 +3,22 @@
 
 #include <math.h>
 
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <cmath>
+#include <cstdint>
 #include <iostream>
+#include <limits>
+#include <utility>
 
 #include "spin_marble.h"
 
 namespace puzzle {
 
+class PackedState;
+class SpinPuzzleGame;
+
 /**
  * @brief SpinPuzzleSide deals with a single side of a Trefoil.
  *
@@ -86,6 +93,72 @@ private:
   //!< angle between two consecutive marbles
   static constexpr double DTHETA = 360.0 / N;
 
+public:
+  //!< resolution of the angles stored in \ref Status
+  static constexpr int32_t TICKS_PER_DEGREE = 20;
+  //!< ticks of a complete turn
+  static constexpr int32_t TICKS_PER_TURN = 360 * TICKS_PER_DEGREE;
+  //!< resolution of the angles of the rotations given to a game (see
+  //!< \ref round_angle ): a tick divided by 12
+  static constexpr int32_t ANGLE_SCALE = 12 * TICKS_PER_DEGREE;
+  //!< parts of a tick of \ref Status::m_rests_leaves : a rotation of the
+  //!< border moves the leaves by 1/12 of an angle of 1/ANGLE_SCALE degree
+  static constexpr int32_t RESTS_PER_TICK = 12 * 12;
+
+  //!< angle in degree rounded to the resolution of the rotations of a game,
+  //!< that is stored exactly in the parts of a tick of \ref Status
+  static double round_angle(double angle)
+  {
+    constexpr double MAX = std::numeric_limits<int32_t>::max();
+    return std::round(std::clamp(angle * ANGLE_SCALE, -MAX, MAX)) /
+           ANGLE_SCALE;
+  }
+
+private:
+  //!< ticks between two consecutive marbles
+  static constexpr int32_t DTHETA_TICKS = TICKS_PER_TURN / N;
+  //!< ticks between two consecutive marbles during a border rotation
+  static constexpr int32_t DTHETA12_TICKS = DTHETA_TICKS / 12;
+  static_assert(TICKS_PER_TURN % (12 * N) == 0,
+                "The steps of the marbles must be a whole number of ticks");
+
+  //!< nearest number of ticks of an angle in degree
+  static int32_t to_ticks(double angle)
+  {
+    return static_cast<int32_t>(std::lround(angle * TICKS_PER_DEGREE));
+  }
+  //!< whole ticks of an angle in degree plus the rest of the previous
+  //!< rotations: the part of a tick left is kept in the rest (in parts of
+  //!< a tick, in [-RESTS_PER_TICK / 2, RESTS_PER_TICK / 2)) for the next
+  //!< rotation, so that small rotations are not lost
+  static int32_t to_ticks(double angle, int32_t& rest)
+  {
+    constexpr int64_t PARTS = RESTS_PER_TICK;
+    const int64_t parts =
+      std::llround(angle * TICKS_PER_DEGREE * PARTS) + rest + PARTS / 2;
+    // division rounded down, also for the negative rotations
+    const int64_t whole = parts / PARTS - (parts % PARTS < 0);
+    rest = static_cast<int32_t>(parts - whole * PARTS - PARTS / 2);
+    return static_cast<int32_t>(whole);
+  }
+  //!< angle in degree of a number of ticks
+  static double to_degree(int32_t ticks)
+  {
+    return ticks * (1.0 / TICKS_PER_DEGREE);
+  }
+  //!< angle in degree of a number of ticks and of parts of a tick
+  static double to_degree(int32_t ticks, int32_t rest)
+  {
+    return to_degree(ticks) +
+           rest * (1.0 / (TICKS_PER_DEGREE * RESTS_PER_TICK));
+  }
+  //!< reduce ticks to [0, TICKS_PER_TURN)
+  static int32_t wrap(int32_t ticks)
+  {
+    ticks %= TICKS_PER_TURN;
+    return ticks + (TICKS_PER_TURN & -static_cast<int32_t>(ticks < 0));
+  }
+
 public:
   //!< tollerance of an angle in degree when checking conditions.
   static constexpr int TOLLERANCE_ANGLE = 5;
@@ -100,11 +173,18 @@ public:
    */
   class Status
   {
+    friend class puzzle::PackedState;
+    friend class puzzle::SpinPuzzleGame;
+
     int m_tollerance = SpinPuzzleSide::TOLLERANCE_ANGLE;
-    //!< phase schifts of the different leaves
-    double m_shifts_leaves[N_LEAVES] = { 0.0, 0.0, 0.0 };
-    //!< phase schifts of the central disk
-    double m_shift_cdisk = 0.0;
+    //!< phase schifts of the different leaves in ticks [0, TICKS_PER_TURN)
+    int32_t m_shifts_leaves[N_LEAVES] = { 0, 0, 0 };
+    //!< phase schifts of the central disk in ticks
+    int32_t m_shift_cdisk = 0;
+    //!< part of a tick of the rotations of the leaves and of the central
+    //!< disk not applied yet, see \ref to_ticks
+    int32_t m_rests_leaves[N_LEAVES] = { 0, 0, 0 };
+    int32_t m_rest_cdisk = 0;
     //!< iterators to keep track of the start position of every section
     // typename SpinPuzzleSide<N, M>::const_iterator m_start_sections[N_LEAVES];
     //!< last 2 states of of the mechanical parts
@@ -114,6 +194,62 @@ public:
                                                  ROTATION::OK,
                                                  ROTATION::OK,
                                                  ROTATION::INVALID };
+    //!< cache of \ref is_discrete: it is invalidated by every setter
+    mutable bool m_discrete_cached = false;
+    mutable bool m_discrete = false;
+    //!< steps (of a marble or of a border marble) of the shift of every leaf,
+    //!< rounded: see \ref SpinPuzzleSide::begin(LEAF)
+    int32_t m_first_steps[N_LEAVES] = { 0, 0, 0 };
+    //!< offset of the first marble of every leaf inside the leaf, and of the
+    //!< first marble of the trefoil (last entry)
+    uint8_t m_first_offsets[N_LEAVES + 1] = { 0, 0, 0, 0 };
+
+    //!< update the cache of the first marble of a leaf (and of the trefoil)
+    void update_first_marble(std::size_t n)
+    {
+      const int32_t dtheta = (m_trefoil_status[1] != TREFOIL::BORDER_ROTATION)
+                               ? DTHETA_TICKS
+                               : DTHETA12_TICKS;
+      const int32_t steps = wrap(m_shifts_leaves[n] + dtheta / 2) / dtheta;
+      m_first_steps[n] = steps;
+      constexpr int32_t LEAF_SIZE = static_cast<int32_t>(N);
+      m_first_offsets[n] =
+        static_cast<uint8_t>((LEAF_SIZE - steps % LEAF_SIZE) % LEAF_SIZE);
+      if (n == 0) {
+        constexpr int32_t TREFOIL_SIZE = static_cast<int32_t>(N_MARBLES);
+        m_first_offsets[N_LEAVES] = static_cast<uint8_t>(
+          (TREFOIL_SIZE - steps % TREFOIL_SIZE) % TREFOIL_SIZE);
+      }
+    }
+
+    //!< update the cache of the first marble of every leaf
+    void update_first_marbles()
+    {
+      for (std::size_t n = 0; n < N_LEAVES; ++n) {
+        update_first_marble(n);
+      }
+    }
+
+    //!< check the conditions of \ref SpinPuzzleSide::is_discrete
+    bool check_discrete() const
+    {
+      // with a tollerance outside (0, DTHETA / 2) a rotation by STEP would
+      // not leave the leaves in a valid state.
+      if (m_trefoil_status[1] != TREFOIL::LEAF_ROTATION ||
+          m_shift_cdisk != 0 || m_tollerance <= 0 ||
+          m_tollerance >= DTHETA / 2) {
+        return false;
+      }
+      for (std::size_t n = 0; n < N_LEAVES; ++n) {
+        const int32_t shift = m_shifts_leaves[n];
+        if (!(0 <= shift && shift < TICKS_PER_TURN) ||
+            shift % DTHETA_TICKS != 0 ||
+            m_rotation_status[n] != ROTATION::OK) {
+          return false;
+        }
+      }
+      return true;
+    }
 
   public:
     template<typename Buffer>
@@ -127,9 +263,11 @@ public:
       auto n4 = static_cast<int32_t>(m_rotation_status[1]);
       auto n5 = static_cast<int32_t>(m_rotation_status[2]);
       auto n6 = static_cast<int32_t>(m_rotation_status[3]);
-      buffer << m_shifts_leaves[0] << " " << m_shifts_leaves[1] << " "
-             << m_shifts_leaves[2] << " " << m_shift_cdisk << " " << n1 << " "
-             << n2 << " " << n3 << " " << n4 << " " << n5 << " " << n6 << " ";
+      buffer << get_shift_of_leaf(LEAF::NORTH) << " "
+             << get_shift_of_leaf(LEAF::EAST) << " "
+             << get_shift_of_leaf(LEAF::WEST) << " "
+             << get_central_disk_shift() << " " << n1 << " " << n2 << " " << n3
+             << " " << n4 << " " << n5 << " " << n6 << " ";
       return buffer;
     }
 
@@ -142,26 +280,46 @@ public:
       uint32_t n4;
       uint32_t n5;
       uint32_t n6;
+      double shifts[N_LEAVES];
+      double shift_cdisk;
 
-      buffer >> m_shifts_leaves[0] >> m_shifts_leaves[1] >>
-        m_shifts_leaves[2] >> m_shift_cdisk >> n1 >> n2 >> n3 >> n4 >> n5 >> n6;
+      buffer >> shifts[0] >> shifts[1] >> shifts[2] >> shift_cdisk >> n1 >>
+        n2 >> n3 >> n4 >> n5 >> n6;
 
+      for (std::size_t n = 0; n < N_LEAVES; ++n) {
+        m_rests_leaves[n] = 0;
+        m_shifts_leaves[n] = wrap(to_ticks(shifts[n], m_rests_leaves[n]));
+      }
+      m_rest_cdisk = 0;
+      m_shift_cdisk = to_ticks(shift_cdisk, m_rest_cdisk);
       m_trefoil_status[0] = static_cast<TREFOIL>(n1);
       m_trefoil_status[1] = static_cast<TREFOIL>(n2);
       m_rotation_status[0] = static_cast<ROTATION>(n3);
       m_rotation_status[1] = static_cast<ROTATION>(n4);
       m_rotation_status[2] = static_cast<ROTATION>(n5);
       m_rotation_status[3] = static_cast<ROTATION>(n6);
+      m_discrete_cached = false;
+      update_first_marbles();
       return buffer;
     }
 
   public:
     //!< set tollerance for realism
-    void set_tollerance(int t) { m_tollerance = t; }
+    void set_tollerance(int t)
+    {
+      m_tollerance = t;
+      m_discrete_cached = false;
+    }
     //!< retieve tollerance
     int tollerance() const { return m_tollerance; }
     //!< getter for the local shift in degree of the first marble of the section
     double get_shift_of_leaf(LEAF leaf) const
+    {
+      return to_degree(get_shift_ticks_of_leaf(leaf),
+                       m_rests_leaves[static_cast<uint8_t>(leaf)]);
+    }
+    //!< local shift of the first marble of the section in ticks
+    int32_t get_shift_ticks_of_leaf(LEAF leaf) const
     {
       return m_shifts_leaves[static_cast<uint8_t>(leaf)];
     }
@@ -169,22 +327,28 @@ public:
     double update_shift_for_leaf(LEAF leaf, double angle)
     {
       uint8_t n = static_cast<uint8_t>(leaf);
-      const double alpha = get_shift_of_leaf(leaf);
-      m_shifts_leaves[n] = std::fmod(alpha + angle + 360.0, 360.0);
-      return m_shifts_leaves[n];
+      m_shifts_leaves[n] =
+        wrap(m_shifts_leaves[n] + to_ticks(angle, m_rests_leaves[n]));
+      m_discrete_cached = false;
+      update_first_marble(n);
+      return to_degree(m_shifts_leaves[n]);
     }
     //!< set the local shift for the given leaf
     double set_shift_for_leaf(LEAF leaf, double angle)
     {
       uint8_t n = static_cast<uint8_t>(leaf);
-      m_shifts_leaves[n] = std::fmod(angle + 360.0, 360.0);
-      return m_shifts_leaves[n];
+      m_rests_leaves[n] = 0;
+      m_shifts_leaves[n] = wrap(to_ticks(angle, m_rests_leaves[n]));
+      m_discrete_cached = false;
+      update_first_marble(n);
+      return to_degree(m_shifts_leaves[n]);
     }
     //!< setter for the status of \ref puzzle::ROTATION for a leaf
     bool set_rotation_status(LEAF leaf, ROTATION status)
     {
       const auto n = static_cast<uint8_t>(leaf);
       m_rotation_status[n] = status;
+      m_discrete_cached = false;
       return true;
     }
     //!< getter for the status of rotation for a leaf
@@ -206,9 +370,35 @@ public:
     }
 
     //!< getter for the current shift of the central disk
-    double get_central_disk_shift() const { return m_shift_cdisk; }
+    double get_central_disk_shift() const
+    {
+      return to_degree(m_shift_cdisk, m_rest_cdisk);
+    }
+    //!< current shift of the central disk in ticks
+    int32_t get_central_disk_ticks() const { return m_shift_cdisk; }
     //!< setter for central disk shift.
-    void set_central_disk_shift(double angle) { m_shift_cdisk = angle; }
+    void set_central_disk_shift(double angle)
+    {
+      m_rest_cdisk = 0;
+      set_central_disk_ticks(to_ticks(angle, m_rest_cdisk));
+    }
+    //!< ticks of a rotation of the central disk, see \ref to_ticks
+    int32_t central_disk_rotation_ticks(double angle)
+    {
+      return to_ticks(angle, m_rest_cdisk);
+    }
+    //!< check if a part of a tick of a rotation is not applied yet
+    bool has_rests() const
+    {
+      return m_rest_cdisk != 0 || m_rests_leaves[0] != 0 ||
+             m_rests_leaves[1] != 0 || m_rests_leaves[2] != 0;
+    }
+    //!< setter for central disk shift in ticks.
+    void set_central_disk_ticks(int32_t ticks)
+    {
+      m_shift_cdisk = ticks;
+      m_discrete_cached = false;
+    }
 
     /**
      * @brief  retrieve the status of a rotation \ref puzzle::ROTATION for a
@@ -240,6 +430,60 @@ public:
       int8_t n_1 = static_cast<uint8_t>(TIME::CURRENT);
       m_trefoil_status[n_0] = m_trefoil_status[n_1];
       m_trefoil_status[n_1] = status;
+      m_discrete_cached = false;
+      if ((status == TREFOIL::BORDER_ROTATION) !=
+          (m_trefoil_status[n_0] == TREFOIL::BORDER_ROTATION)) {
+        update_first_marbles();
+      }
+    }
+
+    //!< steps of the shift of a leaf, see \ref SpinPuzzleSide::begin(LEAF)
+    int32_t get_first_steps_of_leaf(LEAF leaf) const
+    {
+      return m_first_steps[static_cast<uint8_t>(leaf)];
+    }
+    //!< see \ref SpinPuzzleSide::first_index
+    uint8_t get_first_offset(LEAF leaf) const
+    {
+      return m_first_offsets[static_cast<uint8_t>(leaf)];
+    }
+
+    //!< see \ref SpinPuzzleSide::is_discrete
+    bool is_discrete() const
+    {
+      if (!m_discrete_cached) {
+        m_discrete = check_discrete();
+        m_discrete_cached = true;
+      }
+      return m_discrete;
+    }
+    //!< number of steps of the local shift of a leaf (rounded)
+    std::size_t get_steps_of_leaf(LEAF leaf) const
+    {
+      const int32_t shift = get_shift_ticks_of_leaf(leaf);
+      return static_cast<std::size_t>((shift + DTHETA_TICKS / 2) /
+                                      DTHETA_TICKS);
+    }
+    //!< set the local shift of a discrete leaf as a number of steps [0, N)
+    //!< @note the side stays discrete
+    void set_shift_steps_for_leaf(LEAF leaf, std::size_t steps)
+    {
+      m_shifts_leaves[static_cast<uint8_t>(leaf)] =
+        static_cast<int32_t>(steps) * DTHETA_TICKS;
+      m_rests_leaves[static_cast<uint8_t>(leaf)] = 0;
+      update_first_marble(static_cast<uint8_t>(leaf));
+    }
+    //!< move the trefoil of a discrete side from INVALID to LEAF_ROTATION
+    //!< with the central disk in phase (i.e. rotate it by 0°)
+    //!< @note the side stays discrete
+    void rotate_central_disk_in_phase()
+    {
+      m_trefoil_status[static_cast<uint8_t>(TIME::PREVIOUS)] = TREFOIL::INVALID;
+      m_trefoil_status[static_cast<uint8_t>(TIME::CURRENT)] =
+        TREFOIL::LEAF_ROTATION;
+      m_shift_cdisk = 0;
+      m_rest_cdisk = 0;
+      update_first_marbles();
     }
   };
 
@@ -286,7 +530,7 @@ public:
     // callback for north, east, west, border.
     const_iterator(LEAF leaf,
                    const std::array<SpinMarble, N_MARBLES>& marbles,
-                   Status status,
+                   const Status& status,
                    difference_type pos = 0,
                    double angle = 0.0)
       : m_begin_range(marbles.begin())
@@ -418,7 +662,7 @@ public:
     // callback for north, east, west, border.
     iterator(LEAF leaf,
              std::array<SpinMarble, N_MARBLES>& marbles,
-             Status status,
+             const Status& status,
              difference_type pos = 0,
              double angle = 0.0)
       : m_begin_range(marbles.begin())
@@ -641,23 +885,8 @@ public:
     if (leaf == LEAF::TREFOIL) {
       return begin();
     }
-    if (m_status.get_trefoil_status(TIME::CURRENT) !=
-        TREFOIL::BORDER_ROTATION) {
-      const double theta = m_status.get_shift_of_leaf(leaf);
-      const double theta0 = theta + DTHETA / 2;
-      const double t = fmod(theta0 + 360.0, 360.0);
-      const int pos = -floor(t / DTHETA);
-      const double alpha = theta + pos * DTHETA;
-      return marbles(leaf, pos, alpha);
-    } else {
-      const double DTHETA12 = DTHETA / 12.0;
-      const double theta = m_status.get_shift_of_leaf(leaf);
-      const double theta0 = theta + DTHETA12 / 2;
-      const double t = fmod(theta0 + 360.0, 360.0);
-      const int pos = -floor(t / DTHETA12);
-      const double alpha = theta + pos * DTHETA12;
-      return marbles(leaf, pos, alpha);
-    }
+    const auto [pos, alpha] = first_marble(leaf);
+    return marbles(leaf, pos, alpha);
   }
 
   /**
@@ -666,23 +895,8 @@ public:
    */
   const_iterator begin() const
   {
-    if (m_status.get_trefoil_status(TIME::CURRENT) !=
-        TREFOIL::BORDER_ROTATION) {
-      const double theta = m_status.get_shift_of_leaf(LEAF::NORTH);
-      const double theta0 = theta + DTHETA / 2;
-      const double t = fmod(theta0 + 360.0, 360.0);
-      const int pos = -floor(t / DTHETA);
-      const double alpha = theta + pos * DTHETA;
-      return marbles(LEAF::TREFOIL, pos, alpha);
-    } else {
-      const double DTHETA12 = DTHETA / 12.0;
-      const double theta = m_status.get_shift_of_leaf(LEAF::NORTH);
-      const double theta0 = theta + DTHETA12 / 2;
-      const double t = fmod(theta0 + 360.0, 360.0);
-      const int pos = -floor(t / DTHETA12);
-      const double alpha = theta + pos * DTHETA12;
-      return marbles(LEAF::TREFOIL, pos, alpha);
-    }
+    const auto [pos, alpha] = first_marble(LEAF::TREFOIL);
+    return marbles(LEAF::TREFOIL, pos, alpha);
   }
 
   iterator begin(LEAF leaf)
@@ -690,23 +904,8 @@ public:
     if (leaf == LEAF::TREFOIL) {
       return begin();
     }
-    if (m_status.get_trefoil_status(TIME::CURRENT) !=
-        TREFOIL::BORDER_ROTATION) {
-      const double theta = m_status.get_shift_of_leaf(leaf);
-      const double theta0 = theta + DTHETA / 2;
-      const double t = fmod(theta0 + 360.0, 360.0);
-      const int pos = -floor(t / DTHETA);
-      const double alpha = theta + pos * DTHETA;
-      return marbles(leaf, pos, alpha);
-    } else {
-      const double DTHETA12 = DTHETA / 12.0;
-      const double theta = m_status.get_shift_of_leaf(leaf);
-      const double theta0 = theta + DTHETA12 / 2;
-      const double t = fmod(theta0 + 360.0, 360.0);
-      const int pos = -floor(t / DTHETA12);
-      const double alpha = theta + pos * DTHETA12;
-      return marbles(leaf, pos, alpha);
-    }
+    const auto [pos, alpha] = first_marble(leaf);
+    return marbles(leaf, pos, alpha);
   }
 
   /**
@@ -715,23 +914,8 @@ public:
    */
   iterator begin()
   {
-    if (m_status.get_trefoil_status(TIME::CURRENT) !=
-        TREFOIL::BORDER_ROTATION) {
-      const double theta = m_status.get_shift_of_leaf(LEAF::NORTH);
-      const double theta0 = theta + DTHETA / 2;
-      const double t = fmod(theta0 + 360.0, 360.0);
-      const int pos = -floor(t / DTHETA);
-      const double alpha = theta + pos * DTHETA;
-      return marbles(LEAF::TREFOIL, pos, alpha);
-    } else {
-      const double DTHETA12 = DTHETA / 12.0;
-      const double theta = m_status.get_shift_of_leaf(LEAF::NORTH);
-      const double theta0 = theta + DTHETA12 / 2;
-      const double t = fmod(theta0 + 360.0, 360.0);
-      const int pos = -floor(t / DTHETA12);
-      const double alpha = theta + pos * DTHETA12;
-      return marbles(LEAF::TREFOIL, pos, alpha);
-    }
+    const auto [pos, alpha] = first_marble(LEAF::TREFOIL);
+    return marbles(LEAF::TREFOIL, pos, alpha);
   }
 
   /**
@@ -840,6 +1024,149 @@ public:
     return m_status.get_rotation_status(leaf) == ROTATION::OK;
   }
 
+  /**
+   * @brief  check if \ref rotate_marbles with a non null angle (smaller than
+   *         a turn) changes the side
+   * @retval false if the trefoil does not allow any rotation
+   */
+  bool is_marbles_rotation_effective() const
+  {
+    const auto status = m_status.get_trefoil_status(TIME::CURRENT);
+    return status == TREFOIL::LEAF_ROTATION ||
+           status == TREFOIL::BORDER_ROTATION || is_border_rotation_possible();
+  }
+
+  /**
+   * @brief  check if rotate_internal_disk(0.0) changes the side, i.e. the
+   *         marbles, the shift of the internal disk or the current state of
+   *         the trefoil (see \ref rotate_internal_disk )
+   * @retval false if the rotation is not possible or it has no effect
+   */
+  bool is_internal_disk_rotation_effective() const
+  {
+    if (!m_status.is_internal_disk_rotation_possible()) {
+      return false;
+    }
+    const auto status = m_status.get_trefoil_status(TIME::CURRENT);
+    if (status == TREFOIL::BORDER_ROTATION) {
+      return true;
+    }
+    constexpr int32_t DEGREE = TICKS_PER_DEGREE;
+    const int32_t tollerance = m_status.tollerance() * DEGREE;
+    const int32_t shift = m_status.get_central_disk_ticks();
+    const int32_t alpha = wrap(shift);
+    if (alpha != shift) {
+      // the shift is normalized
+      return true;
+    }
+    if (120 * DEGREE - tollerance <= alpha &&
+        alpha <= 240 * DEGREE + tollerance) {
+      // the marbles move across the leaves
+      return true;
+    }
+    const bool in_phase =
+      alpha <= tollerance || TICKS_PER_TURN - tollerance <= alpha;
+    return status != (in_phase ? TREFOIL::LEAF_ROTATION : TREFOIL::INVALID);
+  }
+
+  // ======================================================================== //
+  // DISCRETE MOVES
+
+  /**
+   * @brief  check if the side is in a discrete configuration
+   *
+   * The side is discrete if it is in \ref TREFOIL::LEAF_ROTATION with the
+   * internal disk at zero phase, every leaf shifted by a whole number of
+   * \ref STEP and all rotations possible. In this configuration the
+   * functions below give the same result of the generic ones without any
+   * angle normalization.
+   * @note the result is cached until the status changes.
+   * @retval true if the side is discrete
+   */
+  bool is_discrete() const { return m_status.is_discrete(); }
+
+  /**
+   * @brief  number of \ref STEP a leaf is shifted by
+   * @note   the side must be discrete (see \ref is_discrete )
+   * @param  leaf: leaf of the side
+   * @retval steps in [0, N)
+   */
+  std::size_t leaf_steps(LEAF leaf) const
+  {
+    return m_status.get_steps_of_leaf(leaf);
+  }
+
+  /**
+   * @brief  rotate the marbles in a leaf by one \ref STEP
+   * @note   equivalent to rotate_marbles(leaf, direction * STEP) on a
+   *         discrete side
+   * @param  leaf: leaf to rotate
+   * @param  clockwise: direction of the rotation
+   */
+  void rotate_leaf_step(LEAF leaf, bool clockwise)
+  {
+    const std::size_t steps = leaf_steps(leaf) + (clockwise ? 1 : N - 1);
+    m_status.set_shift_steps_for_leaf(leaf, steps % N);
+  }
+
+  /**
+   * @brief  rotate the internal disk without moving it out of phase
+   * @note   equivalent to rotate_internal_disk(0.0) on a discrete side
+   */
+  void rotate_internal_disk_in_phase()
+  {
+    m_status.rotate_central_disk_in_phase();
+  }
+
+  /**
+   * @brief  direct access to a marble of a leaf
+   * @param  leaf: section of the marble
+   * @param  offset: position inside the section (without phase shift)
+   * @retval the marble
+   */
+  SpinMarble& marble(LEAF leaf, std::size_t offset)
+  {
+    return m_marbles[static_cast<std::size_t>(leaf) * N + offset];
+  }
+
+  //!< direct access to a marble of a leaf (const version)
+  const SpinMarble& marble(LEAF leaf, std::size_t offset) const
+  {
+    return m_marbles[static_cast<std::size_t>(leaf) * N + offset];
+  }
+
+  /**
+   * @brief  index in the marbles of the first marble of a section
+   * @note   it is the marble of \ref begin(LEAF) , read from the offsets
+   *         cached in the status without any floating point computation
+   * @param  leaf: section of the trefoil, \ref LEAF::TREFOIL for the border
+   * @retval index of the marble
+   */
+  std::size_t first_index(LEAF leaf) const
+  {
+    const std::size_t base =
+      (leaf == LEAF::TREFOIL) ? 0 : static_cast<std::size_t>(leaf) * N;
+    return base + m_status.get_first_offset(leaf);
+  }
+
+  /**
+   * @brief  marble of a section, counted from the first one
+   * @note   same as *(begin(leaf) + n) , see \ref first_index
+   * @param  leaf: section of the trefoil, \ref LEAF::TREFOIL for the border
+   * @param  n: position after the first marble, smaller than the number of
+   *         marbles in the section
+   * @retval the marble
+   */
+  const SpinMarble& section_marble(LEAF leaf, std::size_t n) const
+  {
+    const bool trefoil = leaf == LEAF::TREFOIL;
+    const std::size_t size = trefoil ? N_MARBLES : N;
+    std::size_t offset = m_status.get_first_offset(leaf) + n;
+    offset -= size & -static_cast<std::size_t>(offset >= size);
+    return m_marbles[(trefoil ? 0 : static_cast<std::size_t>(leaf) * N) +
+                     offset];
+  }
+
   std::string to_string() const
   {
     std::string str;
@@ -917,6 +1244,9 @@ public:
   }
 
 private:
+  friend class puzzle::PackedState;
+  friend class puzzle::SpinPuzzleGame;
+
   static_assert(N_LEAVES == static_cast<std::size_t>(LEAF::TREFOIL));
 
   //!< list of marbles in this side of the game
@@ -961,13 +1291,32 @@ private:
   //!< update shift angle, after resetting 1° marble at origin
   double get_angle_for_origin(LEAF leaf) const
   {
-    const double DTHETA12 = DTHETA / 1.0;
-    const double theta = m_status.get_shift_of_leaf(leaf);
-    const double theta0 = theta + DTHETA12 / 2;
-    const double t = fmod(theta0 + 360.0, 360.0);
-    const int pos = -floor(t / DTHETA12);
-    const double alpha = theta + pos * DTHETA12;
-    return alpha;
+    const int32_t theta = m_status.get_shift_ticks_of_leaf(leaf);
+    const int32_t t = wrap(theta + DTHETA_TICKS / 2);
+    const int32_t pos = -(t / DTHETA_TICKS);
+    return to_degree(theta + pos * DTHETA_TICKS);
+  }
+
+  /**
+   * @brief  position of the first marble of a leaf, see \ref begin(LEAF)
+   * @note   the position is cached in the status and it changes only when
+   *         the shift of the leaf crosses half a step
+   * @param  leaf: section of the trefoil
+   * @retval offset of the first marble from the first one of \ref marbles
+   *         and its local shift in degree
+   */
+  std::pair<std::size_t, double> first_marble(LEAF leaf) const
+  {
+    const int32_t dtheta = (m_status.get_trefoil_status(TIME::CURRENT) !=
+                            TREFOIL::BORDER_ROTATION)
+                             ? DTHETA_TICKS
+                             : DTHETA12_TICKS;
+    // the trefoil starts with the marbles of NORTH
+    const LEAF shifted = (leaf == LEAF::TREFOIL) ? LEAF::NORTH : leaf;
+    const int32_t theta = m_status.get_shift_ticks_of_leaf(shifted);
+    const int32_t steps = m_status.get_first_steps_of_leaf(shifted);
+    return { m_status.get_first_offset(leaf),
+             to_degree(theta - steps * dtheta) };
   }
 };
 
@@ -991,12 +1340,12 @@ SpinPuzzleSide<N, M>::is_border_rotation_possible() const
   auto status = m_status.get_trefoil_status(TIME::CURRENT);
   // check if we move from internal disk rotation to border rotation
   if (status == TREFOIL::INVALID) {
-    const double shift = m_status.get_central_disk_shift();
-    const double idisk_shift = fmod(shift + 360.0, 360.0);
-    if ((300 - m_status.tollerance() <= idisk_shift &&
-         idisk_shift <= 300 + m_status.tollerance()) ||
-        (60 - m_status.tollerance() <= idisk_shift &&
-         idisk_shift <= 60 + m_status.tollerance())) {
+    const int32_t idisk_shift = wrap(m_status.get_central_disk_ticks());
+    const int32_t tollerance = m_status.tollerance() * TICKS_PER_DEGREE;
+    if ((300 * TICKS_PER_DEGREE - tollerance <= idisk_shift &&
+         idisk_shift <= 300 * TICKS_PER_DEGREE + tollerance) ||
+        (60 * TICKS_PER_DEGREE - tollerance <= idisk_shift &&
+         idisk_shift <= 60 * TICKS_PER_DEGREE + tollerance)) {
       return true;
     }
   }
@@ -1031,14 +1380,18 @@ template<std::size_t N, std::size_t M>
 void
 SpinPuzzleSide<N, M>::update_rotation_status(LEAF leaf)
 {
-  double dtheta = DTHETA;
-  double tollerance = m_status.tollerance();
+  // the tollerance is compared scaled by the divisor of the step, so that it
+  // does not need to be a whole number of ticks
+  int32_t dtheta = DTHETA_TICKS;
+  int32_t divisor = 1;
   if (m_status.get_trefoil_status(TIME::CURRENT) == TREFOIL::BORDER_ROTATION) {
-    dtheta /= 12;
-    tollerance /= 12;
+    dtheta = DTHETA12_TICKS;
+    divisor = 12;
   }
-  double alpha = std::fmod(
-    std::fmod(m_status.get_shift_of_leaf(leaf) + 360.0, 360.0), dtheta);
+  const int32_t tollerance = m_status.tollerance() * TICKS_PER_DEGREE;
+  const int32_t alpha =
+    (m_status.get_shift_ticks_of_leaf(leaf) % dtheta) * divisor;
+  dtheta *= divisor;
   m_status.set_rotation_status(
     leaf,
     (alpha < tollerance || alpha > dtheta - tollerance) ? ROTATION::OK
@@ -1067,26 +1420,27 @@ SpinPuzzleSide<N, M>::rotate_internal_disk(double angle)
   if (!m_status.is_internal_disk_rotation_possible()) {
     return false;
   }
+  constexpr int32_t DEGREE = TICKS_PER_DEGREE;
+  const int32_t tollerance = m_status.tollerance() * DEGREE;
   // normalize the angle
-  const double alpha =
-    std::fmod(m_status.get_central_disk_shift() + 360.0, 360.0);
-  const double new_shift_cdisk = std::fmod(alpha + angle + 360.0, 360.0);
+  const int32_t alpha = wrap(m_status.get_central_disk_ticks());
+  const int32_t new_shift_cdisk =
+    wrap(alpha + m_status.central_disk_rotation_ticks(angle));
   // ======================================================================== //
   // FROM BORDER ROTATION TO INTERNAL DISK ROTATION
   if (m_status.get_trefoil_status(TIME::CURRENT) == TREFOIL::BORDER_ROTATION) {
-    if ((300 - m_status.tollerance() <= alpha &&
-         alpha <= 300 + m_status.tollerance()) ||
-        (60 - m_status.tollerance() <= alpha &&
-         alpha <= 60 + m_status.tollerance())) {
+    if ((300 * DEGREE - tollerance <= alpha &&
+         alpha <= 300 * DEGREE + tollerance) ||
+        (60 * DEGREE - tollerance <= alpha &&
+         alpha <= 60 * DEGREE + tollerance)) {
       prepare_from_border_rotation();
     }
   }
 
-  angle = fmod(angle + 360.0, 360.0);
   m_status.set_trefoil_status(TREFOIL::INVALID);
 
-  if (120 - m_status.tollerance() <= new_shift_cdisk &&
-      new_shift_cdisk < 240 - m_status.tollerance()) {
+  if (120 * DEGREE - tollerance <= new_shift_cdisk &&
+      new_shift_cdisk < 240 * DEGREE - tollerance) {
     // ROTATE marbles NORTH->EAST->WEST
     auto north_it = this->begin(LEAF::NORTH) - 1;
     auto east_it = this->begin(LEAF::EAST) - 1;
@@ -1096,10 +1450,9 @@ SpinPuzzleSide<N, M>::rotate_internal_disk(double angle)
       std::iter_swap(east_it, west_it);
     }
     // recalcualte the shift angle
-    const double updated_angle = new_shift_cdisk - 120;
-    m_status.set_central_disk_shift(updated_angle);
-  } else if (240 - m_status.tollerance() <= new_shift_cdisk &&
-             new_shift_cdisk <= 240 + m_status.tollerance()) {
+    m_status.set_central_disk_ticks(new_shift_cdisk - 120 * DEGREE);
+  } else if (240 * DEGREE - tollerance <= new_shift_cdisk &&
+             new_shift_cdisk <= 240 * DEGREE + tollerance) {
     // ROTATE marbles WEST->EAST->NORTH
     auto north_it = this->begin(LEAF::NORTH) - 1;
     auto east_it = this->begin(LEAF::EAST) - 1;
@@ -1109,18 +1462,17 @@ SpinPuzzleSide<N, M>::rotate_internal_disk(double angle)
       std::iter_swap(east_it, west_it);
     }
     // recalcualte the shift angle
-    const double updated_angle = new_shift_cdisk - 240;
-    m_status.set_central_disk_shift(updated_angle);
+    m_status.set_central_disk_ticks(new_shift_cdisk - 240 * DEGREE);
   } else {
-    m_status.set_central_disk_shift(new_shift_cdisk);
+    m_status.set_central_disk_ticks(new_shift_cdisk);
   }
-  if ((0 <= new_shift_cdisk && new_shift_cdisk <= m_status.tollerance()) ||
-      ((360 - m_status.tollerance()) <= new_shift_cdisk &&
-       new_shift_cdisk <= 360) ||
-      (120 - m_status.tollerance() <= new_shift_cdisk &&
-       new_shift_cdisk <= 120 + m_status.tollerance()) ||
-      ((240 - m_status.tollerance()) <= new_shift_cdisk &&
-       new_shift_cdisk <= 240 + m_status.tollerance())) {
+  if ((0 <= new_shift_cdisk && new_shift_cdisk <= tollerance) ||
+      ((TICKS_PER_TURN - tollerance) <= new_shift_cdisk &&
+       new_shift_cdisk <= TICKS_PER_TURN) ||
+      (120 * DEGREE - tollerance <= new_shift_cdisk &&
+       new_shift_cdisk <= 120 * DEGREE + tollerance) ||
+      ((240 * DEGREE - tollerance) <= new_shift_cdisk &&
+       new_shift_cdisk <= 240 * DEGREE + tollerance)) {
     m_status.set_trefoil_status(TREFOIL::LEAF_ROTATION);
   }
 
@@ -1149,19 +1501,20 @@ SpinPuzzleSide<N, M>::reorder_marbles_after_border_reset()
 {
   // depending if the central disk is +60° or -60° we have swap the marbles
   // across the section differently
-  const double disk_shift = m_status.get_central_disk_shift();
-  const double shift = fmod(disk_shift + 360.0, 360.0);
+  constexpr int32_t DEGREE = TICKS_PER_DEGREE;
+  const int32_t tollerance = m_status.tollerance() * DEGREE;
+  const int32_t shift = wrap(m_status.get_central_disk_ticks());
   // reset iterators
   auto it_north = begin(LEAF::NORTH);
   auto it_east = begin(LEAF::EAST);
   auto it_west = begin(LEAF::WEST);
-  if ((60 - m_status.tollerance() <= shift &&
-       shift <= 60 + m_status.tollerance())) {
+  if ((60 * DEGREE - tollerance <= shift &&
+       shift <= 60 * DEGREE + tollerance)) {
     std::iter_swap(it_north + N - 3, it_north + N - 1);
     std::iter_swap(it_east + N - 3, it_east + N - 1);
     std::iter_swap(it_west + N - 3, it_west + N - 1);
-  } else if ((300 - m_status.tollerance() <= shift &&
-              shift <= 300 + m_status.tollerance())) {
+  } else if ((300 * DEGREE - tollerance <= shift &&
+              shift <= 300 * DEGREE + tollerance)) {
     std::iter_swap(it_north + N - 3, it_east + N - 1);
     std::iter_swap(it_north + N - 2, it_east + N - 2);
     std::iter_swap(it_north + N - 1, it_east + N - 3);
@@ -1173,9 +1526,8 @@ SpinPuzzleSide<N, M>::reorder_marbles_after_border_reset()
     std::iter_swap(it_west + N - 1, it_west + N - 3);
 
     // CHECK ME !!
-    double shift = m_status.get_central_disk_shift();
-    shift = fmod(shift + 120, 360.0);
-    m_status.set_central_disk_shift(shift);
+    m_status.set_central_disk_ticks(
+      (m_status.get_central_disk_ticks() + 120 * DEGREE) % TICKS_PER_TURN);
   } else {
     assert(false);
   }
@@ -1232,30 +1584,28 @@ SpinPuzzleSide<N, M>::current_time_step(
   std::array<Color, puzzle::SIZE_STEP_ARRAY>& out) const
 {
   if (get_trifoild_status() == puzzle::TREFOIL::BORDER_ROTATION) {
-    auto it = begin(LEAF::TREFOIL);
+    size_t n = 0;
     for (size_t n_leaf = 0; n_leaf < 3; ++n_leaf) {
-      for (size_t n = 0; n < N - M; ++n, ++it, ++start_index) {
-        out[start_index] = it->color();
+      for (size_t i = 0; i < N - M; ++i, ++n, ++start_index) {
+        out[start_index] = section_marble(LEAF::TREFOIL, n).color();
       }
       start_index += 3;
-      for (size_t n = N - M; n < N; ++n, ++it, ++start_index) {
-        out[start_index] = it->color();
+      for (size_t i = N - M; i < N; ++i, ++n, ++start_index) {
+        out[start_index] = section_marble(LEAF::TREFOIL, n).color();
       }
     }
   } else {
-    auto it = begin(LEAF::NORTH);
-    for (size_t n = 0; n < N; ++n, ++it, ++start_index) {
-      out[start_index] = it->color();
-    }
-    start_index += 3;
-    it = begin(LEAF::EAST);
-    for (size_t n = 0; n < N; ++n, ++it, ++start_index) {
-      out[start_index] = it->color();
-    }
-    start_index += 3;
-    it = begin(LEAF::WEST);
-    for (size_t n = 0; n < N; ++n, ++it, ++start_index) {
-      out[start_index] = it->color();
+    for (size_t n_leaf = 0; n_leaf < 3; ++n_leaf) {
+      // the leaf from its first marble to the end, then from its beginning
+      const size_t base = n_leaf * N;
+      const size_t first = first_index(static_cast<LEAF>(n_leaf));
+      for (size_t i = first; i < base + N; ++i, ++start_index) {
+        out[start_index] = m_marbles[i].color();
+      }
+      for (size_t i = base; i < first; ++i, ++start_index) {
+        out[start_index] = m_marbles[i].color();
+      }
+      start_index += 3;
     }
   }
 }
@@ -0,0 +1,771 @@
+#include "spin_solver.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "spin_pattern_database.h"
+#include "spin_puzzle_game.h"
+#include "spin_transposition_table.h"
+#include "spin_zobrist.h"
+
+namespace puzzle {
+
+namespace {
+
+constexpr uint8_t N_COMMANDS = static_cast<uint8_t>(COMMANDS::N_COMMANDS);
+
+//!< a node in the path of the depth-first search
+struct Frame
+{
+  //!< command applied to reach the node
+  COMMANDS command;
+  //!< next command to expand
+  uint8_t next;
+  //!< number of times command has been repeated
+  uint8_t run;
+  //!< lower bound of the commands to solve the node
+  int8_t bound;
+};
+
+bool
+is_rotation(COMMANDS command)
+{
+  return command <= COMMANDS::WEST_LEFT;
+}
+
+bool
+is_spin(COMMANDS command)
+{
+  return command >= COMMANDS::NORTH_SPIN && command <= COMMANDS::WEST_SPIN;
+}
+
+COMMANDS
+inverse(COMMANDS command)
+{
+  const auto n = static_cast<uint8_t>(command);
+  if (command <= COMMANDS::WEST_RIGHT) {
+    return static_cast<COMMANDS>(n + 3);
+  } else if (command <= COMMANDS::WEST_LEFT) {
+    return static_cast<COMMANDS>(n - 3);
+  }
+  // spins and swap are their own inverse
+  return command;
+}
+
+SIDE
+opposite(SIDE side)
+{
+  return (side == SIDE::FRONT) ? SIDE::BACK : SIDE::FRONT;
+}
+
+//!< lower bound of the commands to solve a layout
+int
+lower_bound(const MetricProvider::Layout& layout,
+            SIDE side,
+            const PatternDatabase* database)
+{
+  const int bound = MetricProvider::commands_lower_bound(layout);
+  if (database && bound > 0) {
+    return std::max(bound, database->distance(layout, side));
+  }
+  return bound;
+}
+
+//!< lower bound of a child, parent_bound is the bound of its parent
+int
+child_lower_bound(const MetricProvider::Layout& layout,
+                  SIDE side,
+                  COMMANDS command,
+                  int parent_bound,
+                  const PatternDatabase* database)
+{
+  // without a database only a spin, that moves marbles between leaves,
+  // changes the bound
+  if (database || is_spin(command)) {
+    return lower_bound(layout, side, database);
+  }
+  return parent_bound;
+}
+
+// ========================================================================== //
+//                              PARALLEL SEARCH                               //
+// ========================================================================== //
+
+using Layout = MetricProvider::Layout;
+//!< subtree of the search: the commands from the root to its node
+using Subtree = std::vector<COMMANDS>;
+
+//!< hash of the colors of a layout and of the active side
+uint64_t
+layout_hash(const Layout& layout, SIDE side)
+{
+  uint64_t hash = Zobrist::key(0, static_cast<Color>(side));
+  for (std::size_t p = 0; p < layout.size(); ++p) {
+    hash ^= Zobrist::key(p + 1, layout[p]);
+  }
+  return hash;
+}
+
+//!< apply a command to a layout and update its hash
+void
+apply(COMMANDS command, Layout& layout, SIDE& side, uint64_t& hash)
+{
+  if (command == COMMANDS::SWAP_SIDE) {
+    hash ^= Zobrist::key(0, static_cast<Color>(side));
+    side = opposite(side);
+    hash ^= Zobrist::key(0, static_cast<Color>(side));
+    return;
+  }
+  // the unused entries of the moves are fixed points: their keys cancel out
+  const auto& moves = DiscreteMoves::moves(side, command);
+  for (auto target : moves.target) {
+    hash ^= Zobrist::key(target + 1, layout[target]);
+  }
+  DiscreteMoves::apply(moves, layout.data());
+  for (auto target : moves.target) {
+    hash ^= Zobrist::key(target + 1, layout[target]);
+  }
+}
+
+//!< key of a node in the transposition table
+uint64_t
+node_key(uint64_t hash, COMMANDS command, uint8_t run)
+{
+  // the children of a node depend on the last command (see is_allowed)
+  uint64_t z = hash + ((static_cast<uint64_t>(command) << 8) | run) *
+                        0x9e3779b97f4a7c15ull;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+//!< deque of subtrees owned by a thread
+class WorkQueue
+{
+public:
+  //!< add a subtree at the back (owner)
+  void push(Subtree subtree)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_bytes += sizeof(Subtree) + subtree.capacity() * sizeof(COMMANDS);
+    m_peak_bytes = std::max(m_peak_bytes, m_bytes);
+    m_subtrees.push_back(std::move(subtree));
+    m_size.store(m_subtrees.size(), std::memory_order_relaxed);
+  }
+
+  //!< take the last subtree (owner)
+  bool pop(Subtree& subtree) { return take(subtree, false); }
+
+  //!< take the first subtree (other threads)
+  bool steal(Subtree& subtree) { return take(subtree, true); }
+
+  bool empty() const { return m_size.load(std::memory_order_relaxed) == 0; }
+
+  //!< peak memory used by the queued subtrees
+  std::size_t peak_bytes() const { return m_peak_bytes; }
+
+private:
+  std::mutex m_mutex;
+  std::deque<Subtree> m_subtrees;
+  std::atomic<std::size_t> m_size{ 0 };
+  std::size_t m_bytes = 0;
+  std::size_t m_peak_bytes = 0;
+
+  bool take(Subtree& subtree, bool front)
+  {
+    if (empty()) {
+      return false;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_subtrees.empty()) {
+      return false;
+    }
+    if (front) {
+      subtree = std::move(m_subtrees.front());
+      m_subtrees.pop_front();
+    } else {
+      subtree = std::move(m_subtrees.back());
+      m_subtrees.pop_back();
+    }
+    m_bytes -= sizeof(Subtree) + subtree.capacity() * sizeof(COMMANDS);
+    m_size.store(m_subtrees.size(), std::memory_order_relaxed);
+    return true;
+  }
+};
+
+//!< one iteration of IDA* shared by several threads
+class ParallelSearch
+{
+public:
+  //!< nodes generated by a thread before updating the shared counter
+  static constexpr uint64_t NODES_BATCH = 1024;
+
+  ParallelSearch(const Layout& layout,
+                 SIDE side,
+                 int threshold,
+                 uint8_t iteration,
+                 TranspositionTable& table,
+                 uint64_t max_nodes,
+                 std::size_t threads,
+                 const PatternDatabase* database)
+    : m_layout(layout)
+    , m_side(side)
+    , m_threshold(threshold)
+    , m_iteration(iteration)
+    , m_table(table)
+    , m_max_nodes(max_nodes)
+    , m_database(database)
+    , m_queues(threads)
+    , m_peak_frames(threads, 0)
+  {
+    // root splitting: the first thread starts from the root
+    push(0, Subtree());
+  }
+
+  //!< search the subtrees of the iteration until the queues are empty
+  void work(std::size_t id, SpinSolver::ThreadStatistics& statistics);
+
+  bool found() const { return m_found; }
+  bool aborted() const { return m_aborted; }
+  int next_threshold() const { return m_next_threshold.load(); }
+  const Subtree& solution() const { return m_solution; }
+
+  //!< peak memory of the paths and of the queued subtrees
+  std::size_t peak_memory() const
+  {
+    std::size_t memory = 0;
+    for (std::size_t n = 0; n < m_queues.size(); ++n) {
+      memory += sizeof(Layout) + m_peak_frames[n] * sizeof(Frame) +
+                m_queues[n].peak_bytes();
+    }
+    return memory;
+  }
+
+private:
+  const Layout& m_layout;
+  const SIDE m_side;
+  const int m_threshold;
+  const uint8_t m_iteration;
+  TranspositionTable& m_table;
+  const uint64_t m_max_nodes;
+  const PatternDatabase* m_database;
+
+  std::vector<WorkQueue> m_queues;
+  std::vector<std::size_t> m_peak_frames;
+  //!< subtrees in the queues or being searched
+  std::atomic<std::size_t> m_pending{ 0 };
+  //!< threads looking for a subtree
+  std::atomic<std::size_t> m_idle{ 0 };
+  std::atomic<bool> m_stop{ false };
+  std::atomic<uint64_t> m_nodes{ 0 };
+  std::atomic<int> m_next_threshold{ std::numeric_limits<int>::max() };
+
+  //!< idle threads wait on it for a subtree, the end or a stop
+  std::mutex m_idle_mutex;
+  std::condition_variable m_work;
+
+  std::mutex m_solution_mutex;
+  bool m_found = false;
+  bool m_aborted = false;
+  Subtree m_solution;
+
+  void push(std::size_t id, Subtree subtree)
+  {
+    m_pending.fetch_add(1, std::memory_order_acq_rel);
+    m_queues[id].push(std::move(subtree));
+    wake();
+  }
+
+  //!< wake up the idle threads after a change of the state they wait for
+  void wake()
+  {
+    // taking the mutex orders the change before the check of the waiters
+    {
+      std::lock_guard<std::mutex> lock(m_idle_mutex);
+    }
+    m_work.notify_all();
+  }
+
+  void stop()
+  {
+    m_stop.store(true);
+    wake();
+  }
+
+  //!< check if an idle thread has something to do
+  bool has_work() const
+  {
+    if (m_stop.load(std::memory_order_relaxed) ||
+        m_pending.load(std::memory_order_acquire) == 0) {
+      return true;
+    }
+    for (const auto& queue : m_queues) {
+      if (!queue.empty()) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  //!< search a subtree
+  void search(std::size_t id,
+              const Subtree& subtree,
+              SpinSolver::ThreadStatistics& statistics);
+
+  //!< give the unexplored children of the shallowest node to the queue
+  bool split(std::size_t id, const Subtree& subtree, std::vector<Frame>& path);
+
+  //!< count the generated nodes, false if the search has to stop
+  bool count_nodes(uint64_t nodes);
+
+  void update_next_threshold(int threshold)
+  {
+    int current = m_next_threshold.load(std::memory_order_relaxed);
+    while (threshold < current &&
+           !m_next_threshold.compare_exchange_weak(current, threshold)) {
+    }
+  }
+};
+
+void
+ParallelSearch::work(std::size_t id, SpinSolver::ThreadStatistics& statistics)
+{
+  using clock = std::chrono::steady_clock;
+  const std::size_t n_queues = m_queues.size();
+  bool idle = false;
+  Subtree subtree;
+  while (!m_stop.load(std::memory_order_relaxed)) {
+    bool taken = m_queues[id].pop(subtree);
+    for (std::size_t n = 1; !taken && n < n_queues; ++n) {
+      taken = m_queues[(id + n) % n_queues].steal(subtree);
+      statistics.steals += taken;
+    }
+    if (!taken) {
+      if (m_pending.load(std::memory_order_acquire) == 0) {
+        break;
+      }
+      if (!idle) {
+        idle = true;
+        m_idle.fetch_add(1, std::memory_order_relaxed);
+      }
+      std::unique_lock<std::mutex> lock(m_idle_mutex);
+      m_work.wait(lock, [this] { return has_work(); });
+      continue;
+    }
+    if (idle) {
+      idle = false;
+      m_idle.fetch_sub(1, std::memory_order_relaxed);
+    }
+    const auto start = clock::now();
+    ++statistics.subtrees;
+    search(id, subtree, statistics);
+    statistics.seconds +=
+      std::chrono::duration<double>(clock::now() - start).count();
+    if (m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      wake();
+    }
+  }
+  if (idle) {
+    m_idle.fetch_sub(1, std::memory_order_relaxed);
+  }
+}
+
+bool
+ParallelSearch::count_nodes(uint64_t nodes)
+{
+  const uint64_t total =
+    m_nodes.fetch_add(nodes, std::memory_order_relaxed) + nodes;
+  if (m_max_nodes > 0 && total >= m_max_nodes) {
+    std::lock_guard<std::mutex> lock(m_solution_mutex);
+    m_aborted = !m_found;
+    stop();
+    return false;
+  }
+  return !m_stop.load(std::memory_order_relaxed);
+}
+
+bool
+ParallelSearch::split(std::size_t id,
+                      const Subtree& subtree,
+                      std::vector<Frame>& path)
+{
+  const int depth = static_cast<int>(subtree.size());
+  for (std::size_t n = 0; n < path.size(); ++n) {
+    // do not give away subtrees that are too small
+    if (depth + static_cast<int>(n) + 2 >= m_threshold) {
+      return false;
+    }
+    Frame& node = path[n];
+    bool pushed = false;
+    for (uint8_t c = node.next; c < N_COMMANDS; ++c) {
+      const auto command = static_cast<COMMANDS>(c);
+      if (!SpinSolver::is_allowed(node.command, node.run, command)) {
+        continue;
+      }
+      Subtree child(subtree);
+      for (std::size_t p = 1; p <= n; ++p) {
+        child.push_back(path[p].command);
+      }
+      child.push_back(command);
+      push(id, std::move(child));
+      pushed = true;
+    }
+    node.next = N_COMMANDS;
+    if (pushed) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void
+ParallelSearch::search(std::size_t id,
+                       const Subtree& subtree,
+                       SpinSolver::ThreadStatistics& statistics)
+{
+  Layout layout = m_layout;
+  SIDE side = m_side;
+  uint64_t hash = layout_hash(layout, side);
+  COMMANDS previous = COMMANDS::N_COMMANDS;
+  uint8_t run = 0;
+  for (auto command : subtree) {
+    apply(command, layout, side, hash);
+    run = (command == previous) ? run + 1 : 1;
+    previous = command;
+  }
+  const int depth = static_cast<int>(subtree.size());
+  const int bound = lower_bound(layout, side, m_database);
+  if (depth + bound > m_threshold) {
+    update_next_threshold(depth + bound);
+    return;
+  }
+  if (depth > 0 && m_table.visit(node_key(hash, previous, run),
+                                 m_iteration,
+                                 static_cast<uint8_t>(depth))) {
+    ++statistics.table_hits;
+    return;
+  }
+
+  int next_threshold = std::numeric_limits<int>::max();
+  uint64_t nodes = 0;
+  std::vector<Frame> path;
+  path.reserve(static_cast<std::size_t>(m_threshold - depth) + 1);
+  path.push_back({ previous, 0, run, static_cast<int8_t>(bound) });
+  m_peak_frames[id] = std::max(m_peak_frames[id], path.capacity());
+
+  auto undo = [&layout, &side, &hash](COMMANDS command) {
+    apply(inverse(command), layout, side, hash);
+  };
+
+  while (!path.empty()) {
+    Frame& node = path.back();
+    if (node.bound == 0) {
+      std::lock_guard<std::mutex> lock(m_solution_mutex);
+      if (!m_found && !m_aborted) {
+        m_found = true;
+        m_solution = subtree;
+        for (std::size_t n = 1; n < path.size(); ++n) {
+          m_solution.push_back(path[n].command);
+        }
+      }
+      stop();
+      break;
+    }
+    if (m_idle.load(std::memory_order_relaxed) > 0 && m_queues[id].empty() &&
+        split(id, subtree, path)) {
+      ++statistics.splits;
+    }
+    while (node.next < N_COMMANDS &&
+           !SpinSolver::is_allowed(
+             node.command, node.run, static_cast<COMMANDS>(node.next))) {
+      ++node.next;
+    }
+    if (node.next == N_COMMANDS) {
+      if (path.size() > 1) {
+        undo(node.command);
+      }
+      path.pop_back();
+      continue;
+    }
+
+    const auto command = static_cast<COMMANDS>(node.next++);
+    apply(command, layout, side, hash);
+    ++statistics.nodes;
+    if (++nodes == NODES_BATCH) {
+      if (!count_nodes(nodes)) {
+        nodes = 0;
+        break;
+      }
+      nodes = 0;
+    }
+
+    const int child_depth = depth + static_cast<int>(path.size());
+    const int child_bound =
+      child_lower_bound(layout, side, command, node.bound, m_database);
+    if (child_depth + child_bound > m_threshold) {
+      next_threshold = std::min(next_threshold, child_depth + child_bound);
+      undo(command);
+      continue;
+    }
+    const uint8_t child_run = (command == node.command) ? node.run + 1 : 1;
+    if (m_table.visit(node_key(hash, command, child_run),
+                      m_iteration,
+                      static_cast<uint8_t>(child_depth))) {
+      ++statistics.table_hits;
+      undo(command);
+      continue;
+    }
+    path.push_back({ command, 0, child_run, static_cast<int8_t>(child_bound) });
+  }
+  count_nodes(nodes);
+  update_next_threshold(next_threshold);
+}
+
+} // namespace
+
+SpinSolver::SpinSolver(std::size_t max_depth, uint64_t max_nodes)
+  : m_max_depth(std::min<std::size_t>(max_depth,
+                                      std::numeric_limits<int8_t>::max()))
+  , m_max_nodes(max_nodes)
+{
+}
+
+void
+SpinSolver::set_threads(std::size_t threads)
+{
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  m_threads = threads;
+}
+
+bool
+SpinSolver::is_allowed(COMMANDS previous, std::size_t run, COMMANDS command)
+{
+  if (command == COMMANDS::INTERNAL_LEFT ||
+      command == COMMANDS::INTERNAL_RIGHT) {
+    return false;
+  }
+  if (previous == COMMANDS::N_COMMANDS) {
+    return true;
+  }
+  if (command == COMMANDS::SWAP_SIDE) {
+    return previous != COMMANDS::SWAP_SIDE;
+  }
+  const auto leaf = static_cast<uint8_t>(DiscreteMoves::leaf(command));
+  const auto previous_leaf =
+    static_cast<uint8_t>(DiscreteMoves::leaf(previous));
+  if (is_spin(command)) {
+    if (previous == COMMANDS::SWAP_SIDE) {
+      return false;
+    }
+    return !is_spin(previous) || leaf > previous_leaf;
+  }
+  // rotation
+  if (!is_rotation(previous) || leaf > previous_leaf) {
+    return true;
+  }
+  if (leaf < previous_leaf || command != previous) {
+    return false;
+  }
+  // 5 rotations to the left are the same as 5 to the right
+  const std::size_t max_run = (command <= COMMANDS::WEST_RIGHT) ? 5 : 4;
+  return run < max_run;
+}
+
+bool
+SpinSolver::solve(const SpinPuzzleGame& game, std::vector<COMMANDS>& solution)
+{
+  using clock = std::chrono::steady_clock;
+  const auto start = clock::now();
+  m_statistics = Statistics();
+  m_thread_statistics.assign(m_threads, ThreadStatistics());
+  solution.clear();
+
+  if (!game.is_discrete_state()) {
+    return false;
+  }
+  Layout layout = MetricProvider::layout(game);
+  const int bound = lower_bound(layout, game.get_active_side(), m_database);
+  if (bound < 0) {
+    return false;
+  }
+  m_statistics.peak_memory = sizeof(layout) + sizeof(Frame);
+
+  std::unique_ptr<TranspositionTable> table;
+  if (m_threads > 1) {
+    table = std::make_unique<TranspositionTable>(m_table_size);
+  }
+
+  Result result = Result::NOT_FOUND;
+  int threshold = bound;
+  while (threshold <= static_cast<int>(m_max_depth)) {
+    ++m_statistics.iterations;
+    int next_threshold = std::numeric_limits<int>::max();
+    if (table) {
+      // the iteration 0 marks the empty entries of the table
+      const auto iteration =
+        static_cast<uint8_t>(1 + (m_statistics.iterations - 1) % 255);
+      result = parallel_search(layout,
+                               game.get_active_side(),
+                               threshold,
+                               iteration,
+                               *table,
+                               next_threshold,
+                               solution);
+    } else {
+      result = search(layout,
+                      game.get_active_side(),
+                      bound,
+                      threshold,
+                      next_threshold,
+                      solution);
+    }
+    if (result != Result::NOT_FOUND) {
+      break;
+    }
+    threshold = next_threshold;
+  }
+
+  m_statistics.seconds =
+    std::chrono::duration<double>(clock::now() - start).count();
+  if (!table) {
+    m_thread_statistics[0].nodes = m_statistics.nodes;
+    m_thread_statistics[0].subtrees = m_statistics.iterations;
+    m_thread_statistics[0].seconds = m_statistics.seconds;
+  }
+  return result == Result::FOUND;
+}
+
+SpinSolver::Result
+SpinSolver::search(Layout& layout,
+                   SIDE side,
+                   int bound,
+                   int threshold,
+                   int& next_threshold,
+                   std::vector<COMMANDS>& solution)
+{
+  std::vector<Frame> path;
+  path.reserve(static_cast<std::size_t>(threshold) + 1);
+  path.push_back({ COMMANDS::N_COMMANDS, 0, 0, static_cast<int8_t>(bound) });
+
+  auto undo = [&layout, &side](COMMANDS command) {
+    if (command == COMMANDS::SWAP_SIDE) {
+      side = opposite(side);
+    } else {
+      DiscreteMoves::apply(DiscreteMoves::moves(side, inverse(command)),
+                           layout.data());
+    }
+  };
+
+  while (!path.empty()) {
+    Frame& node = path.back();
+    if (node.bound == 0) {
+      // every leaf has a single color
+      for (std::size_t n = 1; n < path.size(); ++n) {
+        solution.push_back(path[n].command);
+      }
+      return Result::FOUND;
+    }
+    while (node.next < N_COMMANDS &&
+           !is_allowed(node.command,
+                       node.run,
+                       static_cast<COMMANDS>(node.next))) {
+      ++node.next;
+    }
+    if (node.next == N_COMMANDS) {
+      if (path.size() > 1) {
+        undo(node.command);
+      }
+      path.pop_back();
+      continue;
+    }
+
+    const auto command = static_cast<COMMANDS>(node.next++);
+    if (command == COMMANDS::SWAP_SIDE) {
+      side = opposite(side);
+    } else {
+      DiscreteMoves::apply(DiscreteMoves::moves(side, command), layout.data());
+    }
+    ++m_statistics.nodes;
+    if (m_max_nodes > 0 && m_statistics.nodes >= m_max_nodes) {
+      return Result::ABORTED;
+    }
+
+    const int child_bound =
+      child_lower_bound(layout, side, command, node.bound, m_database);
+    const int cost = static_cast<int>(path.size()) + child_bound;
+    if (cost > threshold) {
+      next_threshold = std::min(next_threshold, cost);
+      undo(command);
+      continue;
+    }
+    const uint8_t run = (command == node.command) ? node.run + 1 : 1;
+    path.push_back({ command, 0, run, static_cast<int8_t>(child_bound) });
+    m_statistics.peak_memory =
+      std::max(m_statistics.peak_memory,
+               sizeof(layout) + path.size() * sizeof(Frame));
+  }
+  return Result::NOT_FOUND;
+}
+
+SpinSolver::Result
+SpinSolver::parallel_search(const Layout& layout,
+                            SIDE side,
+                            int threshold,
+                            uint8_t iteration,
+                            TranspositionTable& table,
+                            int& next_threshold,
+                            std::vector<COMMANDS>& solution)
+{
+  const uint64_t max_nodes =
+    (m_max_nodes > 0) ? m_max_nodes - m_statistics.nodes : 0;
+  ParallelSearch search(layout,
+                        side,
+                        threshold,
+                        iteration,
+                        table,
+                        max_nodes,
+                        m_threads,
+                        m_database);
+
+  std::vector<ThreadStatistics> statistics(m_threads);
+  std::vector<std::thread> threads;
+  for (std::size_t id = 1; id < m_threads; ++id) {
+    threads.emplace_back(
+      [&search, &statistics, id]() { search.work(id, statistics[id]); });
+  }
+  search.work(0, statistics[0]);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  for (std::size_t id = 0; id < m_threads; ++id) {
+    auto& total = m_thread_statistics[id];
+    total.nodes += statistics[id].nodes;
+    total.subtrees += statistics[id].subtrees;
+    total.steals += statistics[id].steals;
+    total.splits += statistics[id].splits;
+    total.table_hits += statistics[id].table_hits;
+    total.seconds += statistics[id].seconds;
+    m_statistics.nodes += statistics[id].nodes;
+  }
+  m_statistics.peak_memory =
+    std::max(m_statistics.peak_memory, search.peak_memory() + table.memory());
+
+  next_threshold = search.next_threshold();
+  if (search.found()) {
+    solution = search.solution();
+    return Result::FOUND;
+  }
+  return search.aborted() ? Result::ABORTED : Result::NOT_FOUND;
+}
+
+} // namespace puzzle
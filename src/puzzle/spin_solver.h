@@ -0,0 +1,187 @@
+#ifndef SPIN_SOLVER_H
+#define SPIN_SOLVER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "spin_metrics.h"
+#include "spin_puzzle_definitions.h"
+
+namespace puzzle {
+
+class PatternDatabase;
+class SpinPuzzleGame;
+class TranspositionTable;
+
+/**
+ * @brief IDA* solver over the discrete \ref COMMANDS .
+ *
+ * The search runs on the colors of the marbles in the logical layout of
+ * \ref DiscreteMoves , moved with the same tables used by
+ * \ref SpinPuzzleGame::process_command , and it is guided by the admissible
+ * \ref MetricProvider::commands_lower_bound , or by a
+ * \ref PatternDatabase if one is given (see \ref set_pattern_database ):
+ * the solution found within \ref max_depth commands is the shortest one.
+ *
+ * Sequences that are equivalent to a shorter (or to a previous) one are
+ * pruned:
+ *   - INTERNAL_LEFT and INTERNAL_RIGHT, which do not move any marble;
+ *   - a command followed by its inverse, and two SWAP_SIDE in a row;
+ *   - commuting commands (rotations of different leaves, spins of different
+ *     leaves) in decreasing leaf order;
+ *   - more than 5 rotations of a leaf (4 to the left) in a row;
+ *   - a spin after SWAP_SIDE, equivalent to the spin of the opposite leaf
+ *     before it.
+ *
+ * The depth-first search uses an explicit stack: the memory is the stack
+ * of the deepest path and it is reported in \ref Statistics .
+ *
+ * With more than one thread (see \ref set_threads ) every iteration of
+ * IDA* is split in subtrees:
+ *   - the root is the first subtree, the threads split the shallowest node
+ *     of their path with unexplored children whenever a thread is idle;
+ *   - every thread owns a deque of subtrees: it takes the deepest one from
+ *     the back of its deque, an idle thread steals the shallowest one from
+ *     the front of another deque;
+ *   - the threads share a lock-free \ref TranspositionTable : a node
+ *     already reached in the same iteration at the same or at a lower depth
+ *     (after the same command) is not expanded again.
+ *
+ * The solution is still the shortest one, but when there are several of
+ * them the one that is found may change from run to run.
+ */
+class SpinSolver
+{
+public:
+  //!< statistics of the last search
+  struct Statistics
+  {
+    //!< nodes generated
+    uint64_t nodes = 0;
+    //!< iterations of IDA* (number of thresholds tried)
+    uint32_t iterations = 0;
+    //!< duration of the search
+    double seconds = 0.0;
+    //!< peak memory used by the search in bytes
+    std::size_t peak_memory = 0;
+
+    double nodes_per_second() const
+    {
+      return (seconds > 0.0) ? static_cast<double>(nodes) / seconds : 0.0;
+    }
+  };
+
+  //!< statistics of a thread in the last search
+  struct ThreadStatistics
+  {
+    //!< nodes generated
+    uint64_t nodes = 0;
+    //!< subtrees searched
+    uint64_t subtrees = 0;
+    //!< subtrees stolen from the other threads
+    uint64_t steals = 0;
+    //!< subtrees given to the other threads
+    uint64_t splits = 0;
+    //!< nodes pruned by the transposition table
+    uint64_t table_hits = 0;
+    //!< time spent searching subtrees
+    double seconds = 0.0;
+  };
+
+  /**
+   * @brief  create a solver
+   * @param  max_depth: maximum length of a solution
+   * @param  max_nodes: maximum number of nodes to generate (0: no limit)
+   */
+  explicit SpinSolver(std::size_t max_depth = 30, uint64_t max_nodes = 0);
+
+  /**
+   * @brief  find the shortest sequence of commands that solves a game
+   * @param  game: game to solve, it must be in a discrete state (see
+   *         \ref SpinPuzzleGame::is_discrete_state )
+   * @param  solution: commands to give to \ref SpinPuzzleGame::process_command
+   * @retval true if a solution has been found, otherwise solution is empty
+   */
+  bool solve(const SpinPuzzleGame& game, std::vector<COMMANDS>& solution);
+
+  //!< statistics of the last call to \ref solve
+  const Statistics& statistics() const { return m_statistics; }
+
+  /**
+   * @brief  set the number of threads used by \ref solve
+   * @param  threads: number of threads, 0 for one thread for every core
+   */
+  void set_threads(std::size_t threads);
+
+  //!< number of threads used by \ref solve
+  std::size_t threads() const { return m_threads; }
+
+  //!< statistics of every thread in the last call to \ref solve
+  const std::vector<ThreadStatistics>& thread_statistics() const
+  {
+    return m_thread_statistics;
+  }
+
+  //!< size of the transposition table (2^log2_size slots) with threads
+  void set_table_size(std::size_t log2_size) { m_table_size = log2_size; }
+
+  /**
+   * @brief  use the distances of a pattern database as heuristic
+   * @param  database: loaded database that outlives the solver, nullptr
+   *         to use only \ref MetricProvider::commands_lower_bound
+   */
+  void set_pattern_database(const PatternDatabase* database)
+  {
+    m_database = database;
+  }
+
+  /**
+   * @brief  check if a command is expanded after the previous one
+   * @param  previous: last command of the path (N_COMMANDS at the root)
+   * @param  run: number of times previous has been repeated
+   * @param  command: next command
+   * @retval false if the command is pruned
+   */
+  static bool is_allowed(COMMANDS previous, std::size_t run, COMMANDS command);
+
+private:
+  using Layout = MetricProvider::Layout;
+
+  std::size_t m_max_depth;
+  uint64_t m_max_nodes;
+  std::size_t m_threads = 1;
+  std::size_t m_table_size = 20;
+  const PatternDatabase* m_database = nullptr;
+  Statistics m_statistics;
+  std::vector<ThreadStatistics> m_thread_statistics;
+
+  //!< result of an iteration of IDA*
+  enum class Result
+  {
+    FOUND,
+    NOT_FOUND,
+    ABORTED
+  };
+
+  //!< depth-first search of the nodes with cost up to the threshold
+  Result search(Layout& layout,
+                SIDE side,
+                int bound,
+                int threshold,
+                int& next_threshold,
+                std::vector<COMMANDS>& solution);
+
+  //!< \ref search with \ref threads threads
+  Result parallel_search(const Layout& layout,
+                         SIDE side,
+                         int threshold,
+                         uint8_t iteration,
+                         TranspositionTable& table,
+                         int& next_threshold,
+                         std::vector<COMMANDS>& solution);
+};
+
+} // namespace puzzle
+
+#endif // SPIN_SOLVER_H
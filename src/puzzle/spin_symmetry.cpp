@@ -0,0 +1,188 @@
+#include "spin_symmetry.h"
+
+#include <algorithm>
+
+#include "spin_discrete_moves.h"
+#include "spin_packed_state.h"
+#include "spin_puzzle_game.h"
+
+namespace puzzle {
+
+namespace {
+
+constexpr std::size_t N = DiscreteMoves::GROUP_SIZE;
+constexpr std::size_t N_POSITIONS = DiscreteMoves::N_POSITIONS;
+
+using Destinations = std::array<uint8_t, N_POSITIONS>;
+
+//!< leaf reached by a leaf of a side after a number of rotations
+std::size_t
+rotate(SIDE side, std::size_t leaf, std::size_t rotations)
+{
+  // seen from the back the trefoil rotates the other way
+  const std::size_t step = (side == SIDE::FRONT) ? 1 : 2;
+  return (leaf + step * rotations) % 3;
+}
+
+std::size_t
+rotations(std::size_t symmetry)
+{
+  return symmetry % Symmetry::N_ROTATIONS;
+}
+
+bool
+swaps(std::size_t symmetry)
+{
+  return symmetry >= Symmetry::N_ROTATIONS;
+}
+
+SIDE
+image(SIDE side, std::size_t symmetry)
+{
+  if (!swaps(symmetry)) {
+    return side;
+  }
+  return (side == SIDE::FRONT) ? SIDE::BACK : SIDE::FRONT;
+}
+
+//!< position reached by every position of the layout, for every symmetry
+const std::array<Destinations, Symmetry::N_GEOMETRIC>&
+destinations()
+{
+  static const auto destinations = []() {
+    std::array<Destinations, Symmetry::N_GEOMETRIC> destinations;
+    for (std::size_t g = 0; g < Symmetry::N_GEOMETRIC; ++g) {
+      for (uint8_t s = 0; s < 2; ++s) {
+        const auto side = static_cast<SIDE>(s);
+        for (std::size_t l = 0; l < 3; ++l) {
+          const auto leaf = static_cast<LEAF>(rotate(side, l, rotations(g)));
+          for (std::size_t i = 0; i < N; ++i) {
+            destinations[g][DiscreteMoves::position(
+              side, static_cast<LEAF>(l), i)] = static_cast<uint8_t>(
+              DiscreteMoves::position(image(side, g), leaf, i));
+          }
+        }
+      }
+    }
+    return destinations;
+  }();
+  return destinations;
+}
+
+} // namespace
+
+SIDE
+Symmetry::transform(std::size_t symmetry,
+                    const Layout& layout,
+                    SIDE side,
+                    Layout& out)
+{
+  const auto& destination = destinations()[symmetry];
+  for (std::size_t p = 0; p < N_POSITIONS; ++p) {
+    out[destination[p]] = layout[p];
+  }
+  return image(side, symmetry);
+}
+
+COMMANDS
+Symmetry::transform(std::size_t symmetry, SIDE side, COMMANDS command)
+{
+  if (command > COMMANDS::WEST_SPIN) {
+    // internal disk and swap
+    return command;
+  }
+  const auto n = static_cast<uint8_t>(command);
+  const std::size_t leaf = n % 3;
+  return static_cast<COMMANDS>(n - leaf +
+                               rotate(side, leaf, rotations(symmetry)));
+}
+
+bool
+Symmetry::canonicalize(Layout& layout, SIDE& side)
+{
+  std::array<uint8_t, N_POSITIONS> best;
+  bool found = false;
+
+  Layout transformed;
+  std::array<uint8_t, N_POSITIONS> labels;
+  std::array<Color, N_COLORS> colors;
+  for (std::size_t g = 0; g < N_GEOMETRIC; ++g) {
+    if (image(side, g) != SIDE::FRONT) {
+      continue;
+    }
+    transform(g, layout, side, transformed);
+    // label the colors in order of appearance
+    std::size_t n_colors = 0;
+    for (std::size_t p = 0; p < N_POSITIONS; ++p) {
+      std::size_t label = 0;
+      while (label < n_colors && colors[label] != transformed[p]) {
+        ++label;
+      }
+      if (label == n_colors) {
+        if (n_colors == N_COLORS) {
+          return false;
+        }
+        colors[n_colors++] = transformed[p];
+      }
+      labels[p] = static_cast<uint8_t>(label);
+    }
+    if (!found || labels < best) {
+      best = labels;
+      found = true;
+    }
+  }
+
+  // the colors of the representative are the ones of the initial game
+  for (std::size_t p = 0; p < N_POSITIONS; ++p) {
+    layout[p] = PackedState::color_of(static_cast<int32_t>(best[p] * N));
+  }
+  side = SIDE::FRONT;
+  return true;
+}
+
+bool
+Symmetry::canonicalize(const SpinPuzzleGame& game, PackedState& state)
+{
+  if (!game.is_discrete_state()) {
+    return false;
+  }
+  Layout layout = MetricProvider::layout(game);
+  SIDE side = game.get_active_side();
+  if (!canonicalize(layout, side)) {
+    return false;
+  }
+  // the ids of a color are given in order of position
+  std::array<int32_t, N_COLORS> next_id;
+  for (std::size_t c = 0; c < N_COLORS; ++c) {
+    next_id[c] = static_cast<int32_t>(c * N);
+  }
+  constexpr std::size_t SIDE_SIZE = DiscreteMoves::SIDE_SIZE;
+  std::array<SpinMarble, SIDE_SIZE> sides[2];
+  for (std::size_t p = 0; p < N_POSITIONS; ++p) {
+    std::size_t c = 0;
+    while (PackedState::color_of(static_cast<int32_t>(c * N)) != layout[p]) {
+      ++c;
+    }
+    const int32_t id = next_id[c]++;
+    if (id >= static_cast<int32_t>((c + 1) * N)) {
+      // more than N marbles of a color
+      return false;
+    }
+    // at zero phase the logical layout of a side is its marble array
+    sides[p / SIDE_SIZE][p % SIDE_SIZE] = SpinMarble(id, layout[p]);
+  }
+  SpinPuzzleGame canonical(std::move(sides[0]), std::move(sides[1]));
+  return state.pack(canonical);
+}
+
+bool
+Symmetry::canonicalize(PackedState& state)
+{
+  SpinPuzzleGame game;
+  if (!state.unpack(game)) {
+    return false;
+  }
+  return canonicalize(game, state);
+}
+
+} // namespace puzzle
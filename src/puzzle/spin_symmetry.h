@@ -0,0 +1,99 @@
+#ifndef SPIN_SYMMETRY_H
+#define SPIN_SYMMETRY_H
+
+#include <array>
+#include <cstddef>
+
+#include "spin_metrics.h"
+#include "spin_puzzle_definitions.h"
+
+namespace puzzle {
+
+class PackedState;
+class SpinPuzzleGame;
+
+/**
+ * @brief Symmetries of the discrete states of the puzzle.
+ *
+ * A symmetry maps every state to a state with the same distance to the
+ * goal, and it maps the states reached by the commands to the ones reached
+ * by the commands from the image. On the logical layout of
+ * \ref DiscreteMoves the symmetries are generated by:
+ *   - the 120° rotation of the trefoil: the leaves of the front side move
+ *     NORTH -> EAST -> WEST, the ones of the back side (seen from the back)
+ *     NORTH -> WEST -> EAST, every marble keeps its place in the leaf;
+ *   - the swap of the front and the back side, together with the active
+ *     side;
+ *   - any relabelling of the colors.
+ *
+ * The geometric symmetries (rotations and swap) are numbered from 0 (the
+ * identity) to \ref N_GEOMETRIC - 1 , see \ref transform .
+ *
+ * \ref canonicalize maps every state to a representative of its class:
+ * the smallest layout, with the colors labelled in order of appearance,
+ * among the images with the front as active side. The representative has
+ * the colors of \ref SpinPuzzleGame::createFrontMarbles and
+ * \ref SpinPuzzleGame::createBackMarbles , in the order of their ids.
+ */
+class Symmetry
+{
+public:
+  using Layout = MetricProvider::Layout;
+
+  //!< number of rotations of the trefoil
+  static constexpr std::size_t N_ROTATIONS = 3;
+  //!< number of geometric symmetries (rotations and swap of the sides)
+  static constexpr std::size_t N_GEOMETRIC = 2 * N_ROTATIONS;
+  //!< number of colors of the game
+  static constexpr std::size_t N_COLORS = 6;
+
+  /**
+   * @brief  apply a geometric symmetry
+   * @param  symmetry: index of the symmetry [0, N_GEOMETRIC): rotation by
+   *         (symmetry % N_ROTATIONS) * 120°, then swap of the sides if
+   *         symmetry >= N_ROTATIONS
+   * @param  layout: layout to transform
+   * @param  side: active side
+   * @param  out: transformed layout (must not alias layout)
+   * @retval active side of the transformed state
+   */
+  static SIDE transform(std::size_t symmetry,
+                        const Layout& layout,
+                        SIDE side,
+                        Layout& out);
+
+  /**
+   * @brief  command that has on the image of a state the same effect of
+   *         a command on the state
+   * @param  symmetry: index of the geometric symmetry
+   * @param  side: active side of the state
+   * @param  command: command given to the state
+   * @retval command to give to the transformed state
+   */
+  static COMMANDS transform(std::size_t symmetry, SIDE side, COMMANDS command);
+
+  /**
+   * @brief  representative of the class of a state
+   * @param  layout: layout to canonicalize, updated in place
+   * @param  side: active side, updated in place (always SIDE::FRONT)
+   * @retval false if the layout has more than N_COLORS colors (it is left
+   *         untouched)
+   */
+  static bool canonicalize(Layout& layout, SIDE& side);
+
+  /**
+   * @brief  representative of the class of a game
+   * @note   the representative is at zero phase with no spin rotation
+   * @param  game: game in a discrete state with 10 marbles for each color
+   * @param  state: representative
+   * @retval false if the game can not be represented
+   */
+  static bool canonicalize(const SpinPuzzleGame& game, PackedState& state);
+
+  //!< canonicalize a packed state in place, see \ref canonicalize
+  static bool canonicalize(PackedState& state);
+};
+
+} // namespace puzzle
+
+#endif // SPIN_SYMMETRY_H
@@ -0,0 +1,38 @@
+#include "spin_transposition_table.h"
+
+namespace puzzle {
+
+TranspositionTable::TranspositionTable(std::size_t log2_size)
+  : m_mask((std::size_t{ 1 } << log2_size) - 1)
+  , m_slots(new std::atomic<uint64_t>[m_mask + 1])
+{
+  clear();
+}
+
+void
+TranspositionTable::clear()
+{
+  for (std::size_t n = 0; n < size(); ++n) {
+    m_slots[n].store(0, std::memory_order_relaxed);
+  }
+}
+
+bool
+TranspositionTable::visit(uint64_t key, uint8_t iteration, uint8_t depth)
+{
+  auto& slot = m_slots[key & m_mask];
+  const uint64_t tag = (key & KEY_MASK) | (uint64_t{ iteration } << 8);
+  const uint64_t entry = tag | depth;
+  uint64_t current = slot.load(std::memory_order_relaxed);
+  while (true) {
+    // the empty slot has iteration 0, the iterations start from 1
+    if ((current & ~uint64_t{ 0xff }) == tag && (current & 0xff) <= depth) {
+      return true;
+    }
+    if (slot.compare_exchange_weak(current, entry, std::memory_order_relaxed)) {
+      return false;
+    }
+  }
+}
+
+} // namespace puzzle
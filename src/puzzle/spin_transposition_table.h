@@ -0,0 +1,63 @@
+#ifndef SPIN_TRANSPOSITION_TABLE_H
+#define SPIN_TRANSPOSITION_TABLE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace puzzle {
+
+/**
+ * @brief Lock-free table of the nodes visited by a search.
+ *
+ * Every slot is a single 64-bit atomic word holding the upper 48 bits of
+ * the key of a node, the iteration of the search that stored it and the
+ * depth it has been reached at:
+ * \code{.cpp}
+ *    [ key (63..16) | iteration (15..8) | depth (7..0) ]
+ * \endcode
+ * The table is direct mapped and a slot is always replaced by the last
+ * node that has not been pruned: a lost entry only costs a duplicate
+ * expansion. Entries of a previous iteration are ignored, so the table
+ * does not need to be cleared between the iterations of IDA*.
+ */
+class TranspositionTable
+{
+public:
+  /**
+   * @brief  create an empty table
+   * @param  log2_size: the table has 2^log2_size slots
+   */
+  explicit TranspositionTable(std::size_t log2_size = 20);
+
+  //!< remove every entry
+  void clear();
+
+  /**
+   * @brief  record the visit of a node
+   * @note   it is safe to call it from several threads at once
+   * @param  key: hash of the node
+   * @param  iteration: current iteration of the search
+   * @param  depth: number of commands from the root to the node
+   * @retval true if the node has already been reached in this iteration
+   *         at the same or at a lower depth: its subtree can be pruned
+   */
+  bool visit(uint64_t key, uint8_t iteration, uint8_t depth);
+
+  //!< number of slots
+  std::size_t size() const { return m_mask + 1; }
+
+  //!< memory used by the table in bytes
+  std::size_t memory() const { return size() * sizeof(std::atomic<uint64_t>); }
+
+private:
+  static constexpr uint64_t KEY_MASK = ~uint64_t{ 0xffff };
+
+  std::size_t m_mask;
+  std::unique_ptr<std::atomic<uint64_t>[]> m_slots;
+};
+
+} // namespace puzzle
+
+#endif // SPIN_TRANSPOSITION_TABLE_H
@@ -0,0 +1,51 @@
+#include "spin_zobrist.h"
+
+#include <array>
+
+#include "spin_marble.h"
+
+namespace puzzle {
+
+namespace {
+
+//!< splitmix64 generator
+uint64_t
+next(uint64_t& state)
+{
+  uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+using Keys = std::array<std::array<uint64_t, Zobrist::N_COLORS>,
+                        puzzle::SIZE_STEP_ARRAY>;
+
+} // namespace
+
+uint64_t
+Zobrist::key(std::size_t index, Color color)
+{
+  static const Keys keys = []() {
+    Keys keys;
+    uint64_t state = 0x5350494e50555a5aull;
+    for (auto& index_keys : keys) {
+      for (auto& k : index_keys) {
+        k = next(state);
+      }
+    }
+    return keys;
+  }();
+  if (color == SpinMarble::INVALID_COLOR) {
+    return 0;
+  }
+  const auto c = static_cast<uint64_t>(static_cast<uint32_t>(color));
+  if (c < N_COLORS) {
+    return keys[index][c];
+  }
+  // colors outside of the table (custom marbles)
+  uint64_t state = keys[index][0] ^ c;
+  return next(state);
+}
+
+} // namespace puzzle
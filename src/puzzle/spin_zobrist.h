@@ -0,0 +1,39 @@
+#ifndef SPIN_ZOBRIST_H
+#define SPIN_ZOBRIST_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "spin_puzzle_definitions.h"
+
+namespace puzzle {
+
+/**
+ * @brief Random keys for the Zobrist hash of a game.
+ *
+ * The hash of a game is the xor of the keys of every entry of its
+ * observation (see \ref SpinPuzzleGame::current_time_step ): one key for
+ * every pair (index, color). Entries with \ref SpinMarble::INVALID_COLOR
+ * are not part of the hash.
+ *
+ * @note the keys are generated with a fixed seed: hashes are stable across
+ * runs and processes.
+ */
+class Zobrist
+{
+public:
+  //!< number of colors with a precomputed key for every index
+  static constexpr std::size_t N_COLORS = 32;
+
+  /**
+   * @brief  key of an entry of the observation
+   * @param  index: index in the observation [0, SIZE_STEP_ARRAY)
+   * @param  color: color of the entry (the active side for index 0)
+   * @retval key of the entry
+   */
+  static uint64_t key(std::size_t index, Color color);
+};
+
+} // namespace puzzle
+
+#endif // SPIN_ZOBRIST_H
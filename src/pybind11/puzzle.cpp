@@ -156,6 +156,10 @@ PYBIND11_MODULE(spinbind11_puzzle, m)
     // =================================================================== //
     .def(py::init<>())
     .def("is_game_solved", &puzzle::SpinPuzzleGame::is_game_solved)
+    .def("legal_commands", &puzzle::SpinPuzzleGame::legal_commands)
+    .def("set_undo_limit", &puzzle::SpinPuzzleGame::set_undo_limit)
+    .def("undo", &puzzle::SpinPuzzleGame::undo)
+    .def("redo", &puzzle::SpinPuzzleGame::redo)
     .def("process_key", &puzzle::SpinPuzzleGame::process_key)
     .def("get_keybord_state", &puzzle::SpinPuzzleGame::get_keybord_state)
     .def("rotate_marbles", &puzzle::SpinPuzzleGame::rotate_marbles)
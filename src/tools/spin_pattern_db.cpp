@@ -0,0 +1,32 @@
+#include <chrono>
+#include <iostream>
+
+#include "puzzle/spin_pattern_database.h"
+
+/**
+ * @brief Generate the pattern database used by the solver.
+ *
+ * usage: spin_pattern_db <file>
+ */
+int
+main(int argc, char* argv[])
+{
+  if (argc != 2) {
+    std::cerr << "usage: " << argv[0] << " <file>\n";
+    return 1;
+  }
+  const auto start = std::chrono::steady_clock::now();
+  puzzle::PatternDatabase database;
+  database.build();
+  const double seconds = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+  if (!database.save(argv[1])) {
+    std::cerr << "unable to write " << argv[1] << "\n";
+    return 1;
+  }
+  std::cout << "patterns: " << puzzle::PatternDatabase::N_PATTERNS
+            << ", max distance: " << database.max_distance()
+            << ", built in " << seconds << " s\n";
+  return 0;
+}
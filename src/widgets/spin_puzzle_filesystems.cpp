@@ -49,7 +49,7 @@ FileSystem::get_recoding_puzzle_name() const
   auto in_time_t = std::chrono::system_clock::to_time_t(now);
   std::stringstream datetime;
   datetime << std::put_time(std::localtime(&in_time_t), "%Y_%m_%d_%H_%M_%S");
-  std::string name{ "recording_" + datetime.str() + ".txt" };
+  std::string name{ "recording_" + datetime.str() + ".rec" };
   return name;
 }
 
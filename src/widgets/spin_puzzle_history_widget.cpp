@@ -194,8 +194,14 @@ SpinPuzzleHistoryWidget::setup_replay_btn(QPushButton* replay_btn)
     auto record = m_games.begin() + m_stackedWidget->currentIndex();
     std::string name_recording = record->file_recording();
     puzzle::Recorder recorder;
-    std::ifstream f(m_parent->files().get_recoding_puzzle(name_recording));
-    recorder.load(f);
+    std::ifstream f(m_parent->files().get_recoding_puzzle(name_recording),
+                    std::ios::binary);
+    if (!recorder.load_binary(f)) {
+      // recording stored as text
+      f.clear();
+      f.seekg(0, std::ios::beg);
+      recorder.load(f);
+    }
     auto w1 =
       new SpinPuzzleReplayWidget(m_win_width, m_win_heigth, m_parent, recorder);
     w1->exec();
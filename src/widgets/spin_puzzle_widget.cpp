@@ -180,13 +180,28 @@ SpinPuzzleWidget::save_progress()
   }
 }
 
+SpinPuzzleWidget::~SpinPuzzleWidget()
+{
+  reset_recording();
+}
+
 void
 SpinPuzzleWidget::reset_recording()
 {
   this->stop_recording();
+  discard_recording();
   // m_rec_btn->setText("REC");
 }
 
+void
+SpinPuzzleWidget::discard_recording()
+{
+  if (!m_recording_name.empty()) {
+    QFile::remove(m_files.get_recoding_puzzle(m_recording_name).c_str());
+    m_recording_name.clear();
+  }
+}
+
 void
 SpinPuzzleWidget::exec_puzzle_records_dialog()
 {
@@ -353,12 +368,19 @@ SpinPuzzleWidget::quit()
 bool
 SpinPuzzleWidget::start_recording()
 {
+  // the recording of the previous game, if it has not been solved
+  reset_recording();
   if (m_recorderPtr == nullptr) {
     m_recorderPtr = std::make_shared<puzzle::Recorder>();
   }
   m_recorderPtr->reset();
   m_game.attach_recorder(m_recorderPtr);
-  m_recorderPtr->rec(m_game);
+  // the events are written while playing, a crash does not lose them
+  m_recording_name = m_files.get_recoding_puzzle_name();
+  if (!m_recorderPtr->rec(m_game,
+                          m_files.get_recoding_puzzle(m_recording_name))) {
+    m_recording_name.clear();
+  }
   return true;
 }
 
@@ -391,6 +413,10 @@ SpinPuzzleWidget::store_recorded_game() const
   if (m_recorderPtr == nullptr || m_recorderPtr->isRecording()) {
     return "NONE";
   }
+  if (!m_recording_name.empty()) {
+    // already written by the stream of the recorder
+    return m_recording_name;
+  }
   std::cout << "[INFO] storing file into "
             << m_files.get_recoding_puzzle_directory() << "\n";
   std::string name = m_files.get_recoding_puzzle_name();
@@ -494,12 +520,13 @@ SpinPuzzleWidget::store_puzzle_record(
   }
 
   auto game = record.game();
+  const auto hash = game.hash();
   auto current = game.current_time_step();
-  // check for duplicates
+  // check for duplicates: the hash filters out the different games
   bool found_duplicate = false;
   for (auto& p : games) {
     auto g = p.game();
-    if (g.current_time_step() == current) {
+    if (g.hash() == hash && g.current_time_step() == current) {
       if (p.time() > record.time()) {
         p.update_time(record.time());
         p.update_username(record.username());
@@ -776,6 +803,8 @@ SpinPuzzleWidget::paint_timer()
       this->stop_recording();
       auto name = store_recorded_game();
       store_puzzle_record(name);
+      // the file belongs to the record now
+      m_recording_name.clear();
       m_solved = true;
       m_paint_congratulations = true;
       m_congratulation_timer->start(10);
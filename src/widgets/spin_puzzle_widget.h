@@ -59,6 +59,8 @@ public:
                    int win_heigth,
                    TypePuzzle typePuzzle = TypePuzzle::GAME,
                    QWidget* parent = nullptr);
+  //!< the recording of a game left unsolved is deleted
+  ~SpinPuzzleWidget() override;
 
   void paintEvent(QPaintEvent* ev) override;
   void mouseMoveEvent(QMouseEvent* ev) override;
@@ -123,6 +125,8 @@ private:
   void reset_recording();
   bool start_recording();
   bool stop_recording();
+  //!< delete the file of a recording that no record refers to
+  void discard_recording();
 
   void update_configuration(const puzzle::Configuration& config);
   bool load_configuration();
@@ -230,6 +234,9 @@ private:
   puzzle::Configuration m_config;
   puzzle::FileSystem m_files;
   std::shared_ptr<puzzle::Recorder> m_recorderPtr{ nullptr };
+  //!< file the recording is streamed to (empty if it is kept in memory or
+  //!< if it belongs to the record of a solved game)
+  std::string m_recording_name;
 };
 
 #endif // SPIN_PUZZLE_WIDGET_H
@@ -0,0 +1,194 @@
+#include <gtest/gtest.h>
+
+#include <random>
+#include <sstream>
+
+#include "puzzle/spin_discrete_moves.h"
+#include "puzzle/spin_game_recorder.h"
+#include "puzzle/spin_puzzle_game.h"
+
+#include "t_helpers.h"
+
+using namespace puzzle;
+
+namespace {
+
+// the sequence of keys corresponding to a command
+void
+process_keys(SpinPuzzleGame& game, COMMANDS command)
+{
+  const int keys[] = { Key_N, Key_E, Key_W };
+  const auto n = static_cast<uint8_t>(command);
+  if (command <= COMMANDS::WEST_RIGHT) {
+    game.process_key(keys[n], 1);
+    game.process_key(Key_Right, 1);
+  } else if (command <= COMMANDS::WEST_LEFT) {
+    game.process_key(keys[n - 3], 1);
+    game.process_key(Key_Left, 1);
+  } else if (command <= COMMANDS::WEST_SPIN) {
+    game.process_key(keys[n - 6], 1);
+    game.process_key(Key_PageDown, 1);
+  } else if (command == COMMANDS::INTERNAL_LEFT) {
+    game.process_key(Key_I, 1);
+    game.process_key(Key_Left, 0);
+  } else if (command == COMMANDS::INTERNAL_RIGHT) {
+    game.process_key(Key_I, 1);
+    game.process_key(Key_Right, 0);
+  } else {
+    game.process_key(Key_P, 1);
+  }
+}
+
+// ids of the marbles in the logical layout of DiscreteMoves
+std::array<int32_t, DiscreteMoves::N_POSITIONS>
+logical_layout(const SpinPuzzleGame& game)
+{
+  std::array<int32_t, DiscreteMoves::N_POSITIONS> layout;
+  for (uint8_t s = 0; s < 2; ++s) {
+    const auto side = static_cast<SIDE>(s);
+    for (uint8_t l = 0; l < 3; ++l) {
+      const auto leaf = static_cast<LEAF>(l);
+      auto it = game.get_side(side).begin(leaf);
+      for (size_t i = 0; i < DiscreteMoves::GROUP_SIZE; ++i, ++it) {
+        layout[DiscreteMoves::position(side, leaf, i)] = it->id();
+      }
+    }
+  }
+  return layout;
+}
+}
+
+TEST(DiscreteMoves, discrete_state)
+{
+  SpinPuzzleGame game;
+  ASSERT_TRUE(game.is_discrete_state());
+  game.rotate_marbles(LEAF::NORTH, 1.0);
+  ASSERT_FALSE(game.is_discrete_state());
+  game.rotate_marbles(LEAF::NORTH, -1.0);
+  ASSERT_TRUE(game.is_discrete_state());
+  game.swap_side();
+  game.rotate_internal_disk(10.0);
+  ASSERT_FALSE(game.is_discrete_state());
+  game.rotate_internal_disk(-10.0);
+  ASSERT_TRUE(game.is_discrete_state());
+  game.get_side(SIDE::BACK).set_tollerance(0);
+  ASSERT_FALSE(game.is_discrete_state());
+}
+
+TEST(DiscreteMoves, commands_match_keys)
+{
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<int> dist(
+    0, static_cast<int>(COMMANDS::N_COMMANDS) - 1);
+  for (int n_game = 0; n_game < 5; ++n_game) {
+    SpinPuzzleGame game;
+    SpinPuzzleGame expected;
+    auto recorder = std::make_shared<Recorder>();
+    auto expected_recorder = std::make_shared<Recorder>();
+    game.attach_recorder(recorder);
+    expected.attach_recorder(expected_recorder);
+    game.start_recording();
+    expected.start_recording();
+    for (int n = 0; n < 1000; ++n) {
+      const auto command = static_cast<COMMANDS>(dist(gen));
+      ASSERT_TRUE(game.is_discrete_state());
+      ASSERT_TRUE(game.process_command(command));
+      process_keys(expected, command);
+      ASSERT_EQ(serialized(game), serialized(expected));
+      ASSERT_EQ(game.get_keybord_state(), expected.get_keybord_state());
+    }
+#if !defined(QSPIN_PUZZLE_NO_RECORDER)
+    std::stringstream events;
+    std::stringstream expected_events;
+    game.detached_recorder()->serialize(events, false);
+    expected.detached_recorder()->serialize(expected_events, false);
+    ASSERT_EQ(events.str(), expected_events.str());
+#endif
+  }
+}
+
+TEST(DiscreteMoves, commands_from_a_generic_state)
+{
+  // out of a discrete state the commands follow the generic path
+  SpinPuzzleGame game;
+  game.shuffle(5, 300);
+  game.rotate_marbles(LEAF::NORTH, 10.0);
+  ASSERT_FALSE(game.is_discrete_state());
+  SpinPuzzleGame expected(game);
+  std::mt19937 gen(5);
+  std::uniform_int_distribution<int> dist(
+    0, static_cast<int>(COMMANDS::N_COMMANDS) - 1);
+  for (int n = 0; n < 500; ++n) {
+    const auto command = static_cast<COMMANDS>(dist(gen));
+    game.process_command(command);
+    process_keys(expected, command);
+    ASSERT_EQ(serialized(game), serialized(expected));
+  }
+}
+
+TEST(DiscreteMoves, permutations_match_game)
+{
+  SpinPuzzleGame game;
+  game.shuffle_with_commands(7, 300);
+  ASSERT_TRUE(game.is_discrete_state());
+  for (uint8_t c = 0; c < static_cast<uint8_t>(COMMANDS::N_COMMANDS); ++c) {
+    const auto command = static_cast<COMMANDS>(c);
+    for (int n = 0; n < 2; ++n) {
+      SpinPuzzleGame moved(game);
+      const auto before = logical_layout(moved);
+      std::array<int32_t, DiscreteMoves::N_POSITIONS> after;
+      DiscreteMoves::apply(
+        DiscreteMoves::permutation(moved.get_active_side(), command),
+        before,
+        after);
+      moved.process_command(command);
+      ASSERT_EQ(after, logical_layout(moved)) << "command " << int(c);
+      game.swap_side();
+    }
+  }
+}
+
+TEST(DiscreteMoves, rotations_are_inverse)
+{
+  const std::pair<COMMANDS, COMMANDS> inverse[] = {
+    { COMMANDS::NORTH_RIGHT, COMMANDS::NORTH_LEFT },
+    { COMMANDS::EAST_RIGHT, COMMANDS::EAST_LEFT },
+    { COMMANDS::WEST_RIGHT, COMMANDS::WEST_LEFT },
+    { COMMANDS::NORTH_SPIN, COMMANDS::NORTH_SPIN },
+    { COMMANDS::EAST_SPIN, COMMANDS::EAST_SPIN },
+    { COMMANDS::WEST_SPIN, COMMANDS::WEST_SPIN },
+  };
+  std::array<int32_t, DiscreteMoves::N_POSITIONS> layout;
+  for (size_t n = 0; n < layout.size(); ++n) {
+    layout[n] = static_cast<int32_t>(n);
+  }
+  for (auto side : { SIDE::FRONT, SIDE::BACK }) {
+    for (const auto& [c1, c2] : inverse) {
+      std::array<int32_t, DiscreteMoves::N_POSITIONS> tmp;
+      std::array<int32_t, DiscreteMoves::N_POSITIONS> out;
+      DiscreteMoves::apply(DiscreteMoves::permutation(side, c1), layout, tmp);
+      ASSERT_NE(tmp, layout);
+      DiscreteMoves::apply(DiscreteMoves::permutation(side, c2), tmp, out);
+      ASSERT_EQ(out, layout);
+    }
+  }
+}
+
+TEST(DiscreteMoves, moves_match_permutations)
+{
+  std::array<int32_t, DiscreteMoves::N_POSITIONS> layout;
+  for (size_t n = 0; n < layout.size(); ++n) {
+    layout[n] = static_cast<int32_t>(n);
+  }
+  for (auto side : { SIDE::FRONT, SIDE::BACK }) {
+    for (uint8_t c = 0; c < static_cast<uint8_t>(COMMANDS::N_COMMANDS); ++c) {
+      const auto command = static_cast<COMMANDS>(c);
+      std::array<int32_t, DiscreteMoves::N_POSITIONS> expected;
+      DiscreteMoves::apply(
+        DiscreteMoves::permutation(side, command), layout, expected);
+      auto moved = layout;
+      DiscreteMoves::apply(DiscreteMoves::moves(side, command), moved.data());
+      ASSERT_EQ(moved, expected) << "command " << int(c);
+    }
+  }
+}
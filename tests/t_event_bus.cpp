@@ -0,0 +1,184 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "puzzle/spin_event_bus.h"
+#include "puzzle/spin_puzzle_game.h"
+
+#include "t_helpers.h"
+
+using namespace puzzle;
+
+namespace {
+
+EventQueue::Message
+message(uint32_t sequence)
+{
+  EventQueue::Message message;
+  message.event =
+    Recorder::Event(Recorder::EventType::ROTATE_MARBLES, sequence * 0.5);
+  message.sequence = sequence;
+  return message;
+}
+
+} // namespace
+
+TEST(EventBus, queue)
+{
+  EventQueue queue(3);
+  ASSERT_EQ(queue.capacity(), 8ul);
+  EventQueue::Message taken;
+  ASSERT_FALSE(queue.pop(taken));
+
+  uint32_t pushed = 0;
+  uint32_t expected = 0;
+  for (int round = 0; round < 10; ++round) {
+    // fill the queue, the messages that do not fit are dropped
+    for (int n = 0; n < 10; ++n, ++pushed) {
+      ASSERT_EQ(queue.push(message(pushed)), n < 8);
+    }
+    ASSERT_EQ(queue.dropped(), (round + 1) * 2ul);
+    ASSERT_TRUE(queue.pop(taken));
+    ASSERT_EQ(taken.sequence, expected);
+    ASSERT_DOUBLE_EQ(taken.event.angle(), expected * 0.5);
+    ++expected;
+    std::size_t n = queue.drain([&](const EventQueue::Message& m) {
+      ASSERT_EQ(m.sequence, expected++);
+    });
+    ASSERT_EQ(n, 7ul);
+    ASSERT_FALSE(queue.pop(taken));
+    // the dropped messages are a gap in the sequence
+    expected += 2;
+  }
+}
+
+#if !defined(QSPIN_PUZZLE_NO_RECORDER)
+TEST(EventBus, consumers)
+{
+  EventBus bus;
+  SpinPuzzleGame game;
+  game.shuffle_with_commands(5, 50);
+  const std::string start = serialized(game);
+  std::vector<std::shared_ptr<EventQueue>> queues{ bus.subscribe(16),
+                                                   bus.subscribe(16) };
+  game.attach_event_bus(&bus);
+  ASSERT_FALSE(game.undo());
+
+  // every consumer applies the events to its copy of the game
+  std::atomic<bool> done{ false };
+  std::vector<std::string> replayed(queues.size());
+  std::vector<std::thread> consumers;
+  for (std::size_t c = 0; c < queues.size(); ++c) {
+    consumers.emplace_back([&, c]() {
+      SpinPuzzleGame copy;
+      std::stringstream s(start);
+      copy.load(s);
+      uint32_t expected = 0;
+      auto apply = [&](const EventQueue::Message& message) {
+        EXPECT_EQ(message.sequence, expected++);
+        Recorder::apply(copy, message.event);
+      };
+      while (!done.load()) {
+        queues[c]->drain(apply);
+        std::this_thread::yield();
+      }
+      queues[c]->drain(apply);
+      replayed[c] = serialized(copy);
+    });
+  }
+
+  std::mt19937 gen(3);
+  std::uniform_real_distribution<double> angle(-4.0, 4.0);
+  std::uniform_int_distribution<int> leaf(0, 2);
+  for (int n = 0; n < 5000; ++n) {
+    if (n % 100 == 0) {
+      game.shuffle_with_commands(n, 10);
+    } else {
+      game.rotate_marbles(static_cast<LEAF>(leaf(gen)), angle(gen));
+    }
+  }
+  done.store(true);
+  for (auto& consumer : consumers) {
+    consumer.join();
+  }
+  ASSERT_GT(bus.published(), 5000u);
+  for (std::size_t c = 0; c < queues.size(); ++c) {
+    ASSERT_EQ(queues[c]->dropped(), 0u);
+    ASSERT_EQ(replayed[c], serialized(game));
+  }
+
+  bus.unsubscribe(queues[0]);
+  ASSERT_EQ(bus.subscribers(), 1ul);
+  game.swap_side();
+  EventQueue::Message taken;
+  ASSERT_FALSE(queues[0]->pop(taken));
+  ASSERT_TRUE(queues[1]->pop(taken));
+  ASSERT_EQ(taken.event.type(), Recorder::EventType::SWAP_SIDE);
+}
+
+TEST(EventBus, spins)
+{
+  // a complete spin is the same event for the command and for spin_leaf
+  EventBus bus;
+  const auto queue = bus.subscribe(16);
+  SpinPuzzleGame command;
+  SpinPuzzleGame spin;
+  for (auto* game : { &command, &spin }) {
+    game->attach_recorder(std::make_shared<Recorder>());
+    game->start_recording();
+    game->attach_event_bus(&bus);
+  }
+  ASSERT_TRUE(command.is_discrete_state());
+  ASSERT_TRUE(command.process_command(COMMANDS::EAST_SPIN));
+  ASSERT_TRUE(spin.spin_leaf(LEAF::EAST));
+  ASSERT_EQ(serialized(command), serialized(spin));
+  std::stringstream command_events;
+  command.detached_recorder()->serialize(command_events, false);
+  std::stringstream spin_events;
+  spin.detached_recorder()->serialize(spin_events, false);
+  ASSERT_EQ(command_events.str(), spin_events.str());
+
+  // a partial spin is replayed with its angle
+  const auto recorder = std::make_shared<Recorder>();
+  spin.attach_recorder(recorder);
+  spin.start_recording();
+  spin.spin_leaf(LEAF::EAST, 45.0);
+  SpinPuzzleGame replayed;
+  spin.detached_recorder()->replay(replayed);
+  ASSERT_EQ(serialized(replayed), serialized(spin));
+
+  const Recorder::EventType expected[] = {
+    Recorder::EventType::SPIN_LEAF,
+    Recorder::EventType::SPIN_LEAF,
+    Recorder::EventType::SPIN_LEAF_ANGLE,
+  };
+  for (const auto type : expected) {
+    EventQueue::Message taken;
+    ASSERT_TRUE(queue->pop(taken));
+    ASSERT_EQ(taken.event.type(), type);
+    ASSERT_EQ(taken.event.leaf(), LEAF::EAST);
+  }
+}
+
+TEST(EventBus, copy)
+{
+  EventBus bus;
+  auto queue = bus.subscribe(16);
+  SpinPuzzleGame game;
+  game.attach_event_bus(&bus);
+  // a copy does not publish on the bus of the game
+  SpinPuzzleGame copy(game);
+  ASSERT_EQ(copy.event_bus(), nullptr);
+  copy.swap_side();
+  ASSERT_EQ(bus.published(), 0u);
+  // an assignment keeps the bus of the game
+  game = copy;
+  ASSERT_EQ(game.event_bus(), &bus);
+  game.swap_side();
+  ASSERT_EQ(bus.published(), 1u);
+}
+#endif
@@ -0,0 +1,161 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <sstream>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+#include "puzzle/spin_game_reader.h"
+#include "puzzle/spin_puzzle_game.h"
+
+#include "t_helpers.h"
+
+using namespace puzzle;
+
+TEST(GameReader, many_games)
+{
+  // enough games to span several blocks
+  std::FILE* tmpf = std::tmpfile();
+  std::vector<std::string> games;
+  SpinPuzzleGame game;
+  game.shuffle();
+  for (int n = 0; n < 300; ++n) {
+    game.process_command(static_cast<COMMANDS>(n % 6));
+    if (n % 7 == 0) {
+      // a game in the middle of a spin, after a blank line
+      game.spin_leaf(LEAF::NORTH, 12.34);
+      std::fputs("\n", tmpf);
+    }
+    games.push_back(serialized(game));
+    game.serialize(tmpf);
+    if (n % 7 == 0) {
+      game.spin_leaf(LEAF::NORTH, -12.34);
+    }
+  }
+  ASSERT_GT(std::ftell(tmpf), static_cast<long>(GameReader::BLOCK_SIZE));
+  std::rewind(tmpf);
+
+  GameReader reader(tmpf);
+  SpinPuzzleGame loaded;
+  for (const std::string& expected : games) {
+    ASSERT_TRUE(reader.read(loaded));
+    ASSERT_EQ(serialized(loaded), expected);
+  }
+  ASSERT_FALSE(reader.read(loaded));
+  ASSERT_FALSE(reader.failed());
+  ASSERT_EQ(reader.games(), games.size());
+  ASSERT_EQ(reader.unread(), 0ul);
+  ASSERT_EQ(reader.offset(), static_cast<std::size_t>(std::ftell(tmpf)));
+  std::fclose(tmpf);
+}
+
+TEST(GameReader, errors)
+{
+  SpinPuzzleGame game;
+  game.shuffle();
+  const std::string first = serialized(game);
+  game.shuffle();
+  const std::string last = serialized(game);
+  // unknown version
+  std::string version = last;
+  version[1] = '1';
+  // truncated game
+  const std::size_t cut = last.find(' ', 100) + 1;
+  const std::string truncated = last.substr(0, cut) + "\n";
+  // invalid number
+  std::string number = last;
+  const std::size_t letter = last.find(' ', 200) + 1;
+  number[letter] = 'x';
+
+  std::FILE* tmpf = std::tmpfile();
+  for (const std::string& line : { first, version, truncated, number, last }) {
+    std::fputs(line.c_str(), tmpf);
+  }
+  std::rewind(tmpf);
+
+  GameReader reader(tmpf);
+  SpinPuzzleGame loaded;
+  ASSERT_TRUE(reader.read(loaded));
+  ASSERT_EQ(serialized(loaded), first);
+
+  ASSERT_FALSE(reader.read(loaded));
+  ASSERT_TRUE(reader.failed());
+  ASSERT_EQ(reader.error_line(), 2ul);
+  ASSERT_EQ(reader.error_column(), 2ul);
+  ASSERT_EQ(reader.error_offset(), first.size() + 1);
+  ASSERT_EQ(serialized(loaded), first);
+
+  ASSERT_FALSE(reader.read(loaded));
+  ASSERT_EQ(reader.error_line(), 3ul);
+  ASSERT_EQ(reader.error_column(), cut + 1);
+
+  ASSERT_FALSE(reader.read(loaded));
+  ASSERT_EQ(reader.error_line(), 4ul);
+  ASSERT_EQ(reader.error_column(), letter + 1);
+  ASSERT_EQ(reader.error_offset(),
+            first.size() + version.size() + truncated.size() + letter);
+
+  ASSERT_TRUE(reader.read(loaded));
+  ASSERT_FALSE(reader.failed());
+  ASSERT_EQ(serialized(loaded), last);
+  ASSERT_FALSE(reader.read(loaded));
+  ASSERT_FALSE(reader.failed());
+  ASSERT_EQ(reader.games(), 2ul);
+  std::fclose(tmpf);
+}
+
+TEST(GameReader, load_file)
+{
+  // the game loaded from a file leaves the following games in the file
+  std::FILE* tmpf = std::tmpfile();
+  SpinPuzzleGame game;
+  game.shuffle();
+  const std::string first = serialized(game);
+  game.serialize(tmpf);
+  std::fputs("v1 garbage\n", tmpf);
+  game.shuffle();
+  const std::string last = serialized(game);
+  game.serialize(tmpf);
+  std::rewind(tmpf);
+
+  SpinPuzzleGame loaded;
+  loaded.load(tmpf);
+  ASSERT_EQ(serialized(loaded), first);
+  ASSERT_EQ(std::ftell(tmpf), static_cast<long>(first.size()));
+  loaded.load(tmpf);
+  ASSERT_EQ(serialized(loaded), first);
+  loaded.load(tmpf);
+  ASSERT_EQ(serialized(loaded), last);
+  loaded.load(tmpf);
+  ASSERT_EQ(serialized(loaded), last);
+  std::fclose(tmpf);
+}
+
+#if !defined(_WIN32)
+TEST(GameReader, load_pipe)
+{
+  // a pipe can not seek: only the line of the game must be read
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+  SpinPuzzleGame game;
+  game.shuffle();
+  const std::string first = serialized(game);
+  game.shuffle();
+  const std::string last = serialized(game);
+  const std::string text = first + "\n" + last;
+  ASSERT_EQ(write(fds[1], text.data(), text.size()),
+            static_cast<ssize_t>(text.size()));
+  close(fds[1]);
+
+  std::FILE* pipe = fdopen(fds[0], "r");
+  SpinPuzzleGame loaded;
+  loaded.load(pipe);
+  ASSERT_EQ(serialized(loaded), first);
+  loaded.load(pipe);
+  ASSERT_EQ(serialized(loaded), last);
+  std::fclose(pipe);
+}
+#endif
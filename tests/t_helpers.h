@@ -0,0 +1,20 @@
+#ifndef T_HELPERS_H
+#define T_HELPERS_H
+
+#include <sstream>
+#include <string>
+
+#include "puzzle/spin_puzzle_game.h"
+
+/**
+ * @brief The text serialization of a game, to compare two games.
+ */
+inline std::string
+serialized(const puzzle::SpinPuzzleGame& game)
+{
+  std::stringstream s;
+  game.serialize(s);
+  return s.str();
+}
+
+#endif // T_HELPERS_H
@@ -0,0 +1,166 @@
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <unordered_set>
+
+#include "puzzle/spin_packed_state.h"
+#include "puzzle/spin_puzzle_game.h"
+
+#include "t_helpers.h"
+
+using namespace puzzle;
+
+TEST(PackedState, size)
+{
+  ASSERT_EQ(sizeof(PackedState), PackedState::N_WORDS * sizeof(uint64_t));
+}
+
+TEST(PackedState, colors)
+{
+  for (const auto& m : SpinPuzzleGame::createFrontMarbles()) {
+    ASSERT_EQ(PackedState::color_of(m.id()), m.color());
+  }
+  for (const auto& m : SpinPuzzleGame::createBackMarbles()) {
+    ASSERT_EQ(PackedState::color_of(m.id()), m.color());
+  }
+  ASSERT_EQ(PackedState::color_of(-1), SpinMarble::INVALID_COLOR);
+  ASSERT_EQ(PackedState::color_of(60), SpinMarble::INVALID_COLOR);
+}
+
+TEST(PackedState, pack_unpack_initial_game)
+{
+  SpinPuzzleGame game;
+  PackedState state;
+  ASSERT_TRUE(state.pack(game));
+  ASSERT_EQ(state.active_side(), SIDE::FRONT);
+  for (size_t n = 0; n < 30; ++n) {
+    ASSERT_EQ(state.marble_id(SIDE::FRONT, n), static_cast<int32_t>(n));
+    ASSERT_EQ(state.marble_id(SIDE::BACK, n), static_cast<int32_t>(30 + n));
+  }
+
+  SpinPuzzleGame other;
+  other.shuffle(42, 1000);
+  ASSERT_TRUE(state.unpack(other));
+  ASSERT_EQ(serialized(other), serialized(game));
+  ASSERT_EQ(other.to_string(), game.to_string());
+}
+
+TEST(PackedState, pack_unpack_shuffled_games)
+{
+  for (int seed = 1; seed < 50; ++seed) {
+    SpinPuzzleGame game;
+    // keyboard shuffles visit border rotations and internal disk phases
+    game.shuffle(seed, 500);
+    PackedState state;
+    ASSERT_TRUE(state.pack(game));
+
+    SpinPuzzleGame other;
+    ASSERT_TRUE(state.unpack(other));
+    ASSERT_EQ(serialized(other), serialized(game));
+    ASSERT_EQ(other.current_time_step(), game.current_time_step());
+
+    PackedState repacked;
+    ASSERT_TRUE(repacked.pack(other));
+    ASSERT_EQ(repacked, state);
+    ASSERT_EQ(repacked.hash(), state.hash());
+  }
+}
+
+TEST(PackedState, unpacked_game_evolves_as_original)
+{
+  SpinPuzzleGame game;
+  game.shuffle(7, 300);
+  PackedState state;
+  ASSERT_TRUE(state.pack(game));
+  SpinPuzzleGame other;
+  ASSERT_TRUE(state.unpack(other));
+
+  game.shuffle_with_commands(11, 300);
+  other.shuffle_with_commands(11, 300);
+  ASSERT_EQ(serialized(other), serialized(game));
+}
+
+TEST(PackedState, equality_and_hash)
+{
+  SpinPuzzleGame game;
+  PackedState initial;
+  ASSERT_TRUE(initial.pack(game));
+
+  std::unordered_set<PackedState> states;
+  states.insert(initial);
+  for (int n = 0; n < 10; ++n) {
+    game.process_command(COMMANDS::NORTH_RIGHT);
+    PackedState state;
+    ASSERT_TRUE(state.pack(game));
+    if (n < 9) {
+      ASSERT_NE(state, initial);
+    } else {
+      ASSERT_EQ(state, initial);
+    }
+    states.insert(state);
+  }
+  ASSERT_EQ(states.size(), 10ul);
+}
+
+TEST(PackedState, not_representable)
+{
+  SpinPuzzleGame game;
+  PackedState state;
+  ASSERT_FALSE(state.unpack(game));
+
+  game.rotate_marbles(LEAF::NORTH, 0.01);
+  ASSERT_FALSE(state.pack(game));
+
+  auto marbles = SpinPuzzleGame::createFrontMarbles();
+  marbles[0] = SpinMarble(0, puzzle::red);
+  SpinPuzzleGame custom(marbles);
+  ASSERT_FALSE(state.pack(custom));
+}
+
+TEST(PackedState, expand)
+{
+  auto check = [](const SpinPuzzleGame& game) {
+    PackedState state;
+    ASSERT_TRUE(state.pack(game));
+    PackedState::Successors successors;
+    const std::size_t count = PackedState::expand(state, successors);
+
+    std::size_t n = 0;
+    const uint16_t legal = game.legal_commands();
+    for (uint8_t c = 0; c < static_cast<uint8_t>(COMMANDS::N_COMMANDS); ++c) {
+      if (!(legal & (1u << c))) {
+        continue;
+      }
+      SpinPuzzleGame child;
+      ASSERT_TRUE(state.unpack(child));
+      child.process_command(static_cast<COMMANDS>(c));
+      PackedState expected;
+      if (!expected.pack(child)) {
+        continue;
+      }
+      ASSERT_LT(n, count);
+      ASSERT_EQ(successors[n].command, static_cast<COMMANDS>(c));
+      ASSERT_EQ(successors[n].state, expected);
+      ++n;
+    }
+    ASSERT_EQ(n, count);
+  };
+
+  SpinPuzzleGame game;
+  ASSERT_TRUE(game.is_discrete_state());
+  check(game);
+  for (int seed = 1; seed < 30; ++seed) {
+    SpinPuzzleGame discrete;
+    discrete.shuffle_with_commands(seed, 100);
+    ASSERT_TRUE(discrete.is_discrete_state());
+    check(discrete);
+
+    SpinPuzzleGame keyboard;
+    keyboard.shuffle(seed, 100);
+    check(keyboard);
+  }
+
+  PackedState empty;
+  PackedState::Successors successors;
+  ASSERT_EQ(PackedState::expand(empty, successors), 0ul);
+}
@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+
+#include "puzzle/spin_action_provider.h"
+#include "puzzle/spin_pattern_database.h"
+#include "puzzle/spin_puzzle_game.h"
+#include "puzzle/spin_solver.h"
+
+using namespace puzzle;
+
+namespace {
+const PatternDatabase&
+database()
+{
+  static PatternDatabase database;
+  if (!database.is_loaded()) {
+    database.build();
+  }
+  return database;
+}
+
+std::vector<COMMANDS>
+solve(const SpinPuzzleGame& game, const PatternDatabase* database)
+{
+  SpinSolver solver;
+  solver.set_pattern_database(database);
+  std::vector<COMMANDS> solution;
+  EXPECT_TRUE(solver.solve(game, solution));
+  return solution;
+}
+} // namespace
+
+TEST(PatternDatabase, build)
+{
+  const auto& db = database();
+  ASSERT_TRUE(db.is_loaded());
+  ASSERT_FALSE(db.is_mapped());
+  // every pattern has been reached
+  ASSERT_LT(db.max_distance(), 0xff);
+
+  SpinPuzzleGame game;
+  auto layout = MetricProvider::layout(game);
+  ASSERT_EQ(db.distance(layout, SIDE::FRONT), 0);
+  ASSERT_EQ(db.distance(layout, SIDE::BACK), 0);
+}
+
+TEST(PatternDatabase, exact_on_a_pair)
+{
+  // when only a pair is scrambled, the distance is the optimal solution
+  ActionProvider ap;
+  // on the back, WEST belongs to the pair of EAST on the front
+  const COMMANDS front[] = { COMMANDS::EAST_RIGHT,
+                             COMMANDS::EAST_LEFT,
+                             COMMANDS::EAST_SPIN,
+                             COMMANDS::SWAP_SIDE };
+  const COMMANDS back[] = { COMMANDS::WEST_RIGHT,
+                            COMMANDS::WEST_LEFT,
+                            COMMANDS::WEST_SPIN,
+                            COMMANDS::SWAP_SIDE };
+  for (int seed = 1; seed <= 10; ++seed) {
+    SpinPuzzleGame game;
+    for (auto command : ap.getSequenceOfCommands(seed, 8)) {
+      const auto n = static_cast<size_t>(command) % 4;
+      game.process_command(
+        (game.get_active_side() == SIDE::FRONT) ? front[n] : back[n]);
+    }
+    const auto layout = MetricProvider::layout(game);
+    const auto side = game.get_active_side();
+    const auto solution = solve(game, nullptr);
+    ASSERT_EQ(database().pair_distance(layout, side, LEAF::EAST),
+              static_cast<int>(solution.size()))
+      << "seed " << seed;
+    ASSERT_EQ(database().pair_distance(layout, side, LEAF::NORTH), 0);
+    ASSERT_EQ(database().pair_distance(layout, side, LEAF::WEST), 0);
+  }
+}
+
+TEST(PatternDatabase, admissible)
+{
+  ActionProvider ap;
+  for (int seed = 1; seed <= 10; ++seed) {
+    SpinPuzzleGame game;
+    for (auto command : ap.getSequenceOfCommands(seed, 8)) {
+      game.process_command(command);
+    }
+    const auto expected = solve(game, nullptr);
+    const auto solution = solve(game, &database());
+    ASSERT_EQ(solution.size(), expected.size()) << "seed " << seed;
+    ASSERT_LE(database().distance(MetricProvider::layout(game),
+                                  game.get_active_side()),
+              static_cast<int>(solution.size()));
+  }
+}
+
+TEST(PatternDatabase, save_and_load)
+{
+  const std::string filename = "QSpinPuzzle_test.pdb";
+  ASSERT_TRUE(database().save(filename));
+
+  PatternDatabase loaded;
+  ASSERT_TRUE(loaded.load(filename));
+  ASSERT_TRUE(loaded.is_mapped());
+  ASSERT_EQ(loaded.max_distance(), database().max_distance());
+
+  SpinPuzzleGame game;
+  game.shuffle_with_commands(3, 50);
+  const auto layout = MetricProvider::layout(game);
+  for (auto side : { SIDE::FRONT, SIDE::BACK }) {
+    ASSERT_EQ(loaded.distance(layout, side), database().distance(layout, side));
+  }
+
+  // bytes after the tables
+  {
+    std::ofstream out(filename, std::ios::binary | std::ios::app);
+    out << '\0';
+  }
+  ASSERT_FALSE(loaded.load(filename));
+
+  // truncated file
+  {
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    out << "SPDB";
+  }
+  ASSERT_FALSE(loaded.load(filename));
+  ASSERT_FALSE(loaded.is_loaded());
+  ASSERT_FALSE(loaded.load("QSpinPuzzle_missing.pdb"));
+
+  std::remove(filename.c_str());
+}
@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+
+#include <random>
+
+#include "puzzle/spin_puzzle_batch.h"
+#include "puzzle/spin_puzzle_game.h"
+
+using namespace puzzle;
+
+TEST(PuzzleBatch, initial_games)
+{
+  SpinPuzzleBatch batch(4);
+  SpinPuzzleGame game;
+  ASSERT_EQ(batch.size(), 4ul);
+  for (size_t n = 0; n < batch.size(); ++n) {
+    ASSERT_EQ(batch.observation(n), game.current_time_step());
+    ASSERT_EQ(batch.active_side(n), SIDE::FRONT);
+    ASSERT_TRUE(batch.is_solved(n));
+  }
+}
+
+TEST(PuzzleBatch, step_as_games)
+{
+  constexpr size_t K = 32;
+  SpinPuzzleBatch batch(K);
+  std::vector<SpinPuzzleGame> games(K);
+  for (size_t n = 0; n < K; ++n) {
+    games[n].shuffle_with_commands(static_cast<int>(n) + 1, 100);
+    ASSERT_TRUE(batch.set_game(n, games[n]));
+  }
+
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<int> dist(
+    0, static_cast<int>(COMMANDS::N_COMMANDS) - 1);
+  std::vector<COMMANDS> commands(K);
+  std::vector<SpinPuzzleBatch::Observation> observations(K);
+  for (int step = 0; step < 300; ++step) {
+    for (size_t n = 0; n < K; ++n) {
+      commands[n] = static_cast<COMMANDS>(dist(gen));
+      games[n].process_command(commands[n]);
+    }
+    batch.step(commands);
+    batch.observations(observations.data());
+    for (size_t n = 0; n < K; ++n) {
+      ASSERT_EQ(observations[n], games[n].current_time_step());
+      ASSERT_EQ(batch.active_side(n), games[n].get_active_side());
+    }
+  }
+
+  // the retrieved games evolve as the original ones
+  for (size_t n = 0; n < K; ++n) {
+    auto game = batch.game(n);
+    ASSERT_TRUE(game.is_discrete_state());
+    ASSERT_EQ(game.current_time_step(), games[n].current_time_step());
+    game.shuffle_with_commands(static_cast<int>(n) + 1, 100);
+    games[n].shuffle_with_commands(static_cast<int>(n) + 1, 100);
+    ASSERT_EQ(game.current_time_step(), games[n].current_time_step());
+  }
+}
+
+TEST(PuzzleBatch, solved)
+{
+  SpinPuzzleBatch batch(2);
+  std::vector<COMMANDS> commands = { COMMANDS::NORTH_SPIN,
+                                     COMMANDS::NORTH_RIGHT };
+  batch.step(commands);
+  ASSERT_FALSE(batch.is_solved(0));
+  ASSERT_TRUE(batch.is_solved(1));
+  ASSERT_FALSE(batch.game(0).is_game_solved());
+  ASSERT_TRUE(batch.game(1).is_game_solved());
+  batch.reset(0);
+  ASSERT_TRUE(batch.is_solved(0));
+}
+
+TEST(PuzzleBatch, invalid_games)
+{
+  SpinPuzzleBatch batch(1);
+  SpinPuzzleGame game;
+  game.rotate_marbles(LEAF::NORTH, 10.0);
+  ASSERT_FALSE(batch.set_game(0, game));
+
+  game.reset();
+  game.spin_leaf(LEAF::EAST, 45.0);
+  ASSERT_FALSE(batch.set_game(0, game));
+
+  auto marbles = SpinPuzzleGame::createFrontMarbles();
+  marbles[0] = SpinMarble(0, puzzle::red);
+  ASSERT_FALSE(batch.set_game(0, SpinPuzzleGame(marbles)));
+  ASSERT_TRUE(batch.is_solved(0));
+}
@@ -1,10 +1,13 @@
 #include <gtest/gtest.h>
 
+#include <random>
 #include <sstream>
 
 #include "puzzle/spin_puzzle_game.h"
 #include "puzzle/spin_puzzle_side.h"
 
+#include "t_helpers.h"
+
 using namespace puzzle;
 
 TEST(PuzzleSide, game_creation)
@@ -227,6 +230,93 @@ TEST(PuzzleSide, game_is_complete)
   ASSERT_TRUE(game.is_game_solved());
 }
 
+TEST(PuzzleSide, same_color_count)
+{
+  constexpr size_t N = SpinPuzzleSide<>::GROUP_SIZE;
+  const int keys[] = { Key_N,     Key_E,      Key_W,        Key_I, Key_Left,
+                       Key_Right, Key_PageUp, Key_PageDown, Key_P };
+  const double fractions[] = { 1.0, 0.3, 0.5 };
+  std::mt19937 gen(5);
+  std::uniform_int_distribution<int> key(0, 8);
+  std::uniform_int_distribution<int> fraction(0, 2);
+
+  SpinPuzzleGame game;
+  ASSERT_EQ(game.same_color_count(), 6 * N);
+  for (int n = 0; n < 3000; ++n) {
+    game.process_key(keys[key(gen)], fractions[fraction(gen)]);
+    SpinPuzzleGame copy(game);
+    copy.refresh();
+    ASSERT_EQ(game.same_color_count(), copy.same_color_count())
+      << "key n. " << n;
+    size_t total = 0;
+    for (auto side : { SIDE::FRONT, SIDE::BACK }) {
+      for (auto leaf : { LEAF::NORTH, LEAF::EAST, LEAF::WEST }) {
+        ASSERT_EQ(game.same_color_count(side, leaf),
+                  copy.same_color_count(side, leaf));
+        total += game.same_color_count(side, leaf);
+      }
+    }
+    ASSERT_EQ(total, game.same_color_count());
+  }
+  // a spin leaves 5 marbles of the other color in two leaves
+  game.reset();
+  game.spin_leaf(LEAF::NORTH);
+  ASSERT_EQ(game.same_color_count(SIDE::FRONT, LEAF::NORTH), N - 2);
+  ASSERT_EQ(game.same_color_count(SIDE::BACK, LEAF::NORTH), N - 2);
+  ASSERT_EQ(game.same_color_count(), 6 * N - 4);
+}
+
+namespace {
+// marbles, angles and state of the trefoils, and active side
+std::string
+snapshot(const SpinPuzzleGame& game)
+{
+  std::stringstream s;
+  s << static_cast<int>(game.get_active_side());
+  for (auto side : { SIDE::FRONT, SIDE::BACK }) {
+    const auto& puzzle_side = game.get_side(side);
+    s << " " << static_cast<int>(puzzle_side.get_trifoild_status()) << " "
+      << puzzle_side.get_phase_shift_internal_disk();
+    for (auto leaf : { LEAF::NORTH, LEAF::EAST, LEAF::WEST }) {
+      s << " " << puzzle_side.get_phase_shift_leaf(leaf);
+      for (size_t n = 0; n < SpinPuzzleSide<>::GROUP_SIZE; ++n) {
+        s << " " << puzzle_side.marble(leaf, n).id();
+      }
+    }
+  }
+  return s.str();
+}
+} // namespace
+
+TEST(PuzzleSide, legal_commands)
+{
+  const int keys[] = { Key_N,     Key_E,      Key_W,        Key_I, Key_Left,
+                       Key_Right, Key_PageUp, Key_PageDown, Key_P };
+  const double fractions[] = { 1.0, 0.3, 0.5 };
+  std::mt19937 gen(9);
+  std::uniform_int_distribution<int> key(0, 8);
+  std::uniform_int_distribution<int> fraction(0, 2);
+
+  SpinPuzzleGame game;
+  // discrete state: the internal disk does not move
+  ASSERT_EQ(game.legal_commands(), 0x9ff);
+  for (int n = 0; n < 2000; ++n) {
+    if (n % 2) {
+      game.process_key(keys[key(gen)], fractions[fraction(gen)]);
+    } else {
+      game.process_command(static_cast<COMMANDS>(n / 2 % 12));
+    }
+    const uint16_t mask = game.legal_commands();
+    const std::string before = snapshot(game);
+    for (uint8_t c = 0; c < static_cast<uint8_t>(COMMANDS::N_COMMANDS); ++c) {
+      SpinPuzzleGame copy(game);
+      copy.process_command(static_cast<COMMANDS>(c));
+      ASSERT_EQ(((mask >> c) & 1) != 0, snapshot(copy) != before)
+        << "step " << n << ", command " << static_cast<int>(c);
+    }
+  }
+}
+
 TEST(PuzzleSide, serialize_stringstream)
 {
   size_t max_n = 99;
@@ -312,6 +402,72 @@ TEST(PuzzleSide, many_serialize_file)
   ASSERT_EQ(game.to_string(), shuffled_game3);
 }
 
+TEST(PuzzleSide, serialize_binary)
+{
+  std::vector<uint8_t> data(SpinPuzzleGame::BINARY_SIZE);
+  SpinPuzzleGame game;
+  game.shuffle();
+  const std::string shuffled_game = serialized(game);
+  ASSERT_EQ(game.serialize_binary(data.data(), data.size()),
+            SpinPuzzleGame::BINARY_PACKED_SIZE);
+  ASSERT_EQ(game.serialize_binary(data.data(), 10), 0ul);
+
+  SpinPuzzleGame loaded;
+  ASSERT_EQ(loaded.load_binary(data.data(), 10), 0ul);
+  ASSERT_EQ(loaded.load_binary(data.data(), data.size()),
+            SpinPuzzleGame::BINARY_PACKED_SIZE);
+  ASSERT_EQ(serialized(loaded), shuffled_game);
+
+  // a game in the middle of a rotation is kept as it is
+  game.reset();
+  game.rotate_marbles(LEAF::NORTH, 0.01);
+  game.spin_leaf(LEAF::EAST, 12.34);
+  const std::string rotating_game = serialized(game);
+  ASSERT_EQ(game.serialize_binary(data.data(), 100), 0ul);
+  ASSERT_EQ(game.serialize_binary(data.data(), data.size()),
+            SpinPuzzleGame::BINARY_SIZE);
+  ASSERT_EQ(loaded.load_binary(data.data(), data.size() - 1), 0ul);
+  ASSERT_EQ(serialized(loaded), shuffled_game);
+  ASSERT_EQ(loaded.load_binary(data.data(), data.size()),
+            SpinPuzzleGame::BINARY_SIZE);
+  ASSERT_EQ(serialized(loaded), rotating_game);
+
+  // corrupted data is refused
+  data[0] = 'X';
+  ASSERT_EQ(loaded.load_binary(data.data(), data.size()), 0ul);
+  data[0] = 'S';
+  data[2] = SpinPuzzleGame::BINARY_VERSION + 1;
+  ASSERT_EQ(loaded.load_binary(data.data(), data.size()), 0ul);
+  ASSERT_EQ(serialized(loaded), rotating_game);
+  data[2] = SpinPuzzleGame::BINARY_VERSION;
+
+  // the values of a game are checked before loading it: header, active
+  // side, spins, then shifts, rests, statuses and marbles of every side
+  constexpr std::size_t SPINS = 5;
+  constexpr std::size_t SHIFTS = SPINS + 3 * 8;
+  constexpr std::size_t RESTS = SHIFTS + 4 * 4;
+  constexpr std::size_t MARBLES = RESTS + 4 * 4 + 6;
+  auto corrupted = [&](std::size_t offset, std::vector<uint8_t> bytes) {
+    std::vector<uint8_t> copy(data);
+    std::copy(bytes.begin(), bytes.end(), copy.begin() + offset);
+    return loaded.load_binary(copy.data(), copy.size());
+  };
+  loaded.reset();
+  const std::string reset_game = serialized(loaded);
+  // a spin that is not a number
+  ASSERT_EQ(corrupted(SPINS, { 0, 0, 0, 0, 0, 0, 0xf8, 0x7f }), 0ul);
+  // a shift of a turn, a rest of half a tick
+  ASSERT_EQ(corrupted(SHIFTS, { 0x20, 0x1c, 0, 0 }), 0ul);
+  ASSERT_EQ(corrupted(SHIFTS, { 0xff, 0xff, 0xff, 0xff }), 0ul);
+  ASSERT_EQ(corrupted(RESTS, { 72, 0, 0, 0 }), 0ul);
+  // an id out of range, an id twice
+  ASSERT_EQ(corrupted(MARBLES, { 60, 0, 0, 0 }), 0ul);
+  ASSERT_EQ(corrupted(MARBLES, { data[MARBLES + 8], 0, 0, 0 }), 0ul);
+  ASSERT_EQ(serialized(loaded), reset_game);
+  ASSERT_EQ(corrupted(SPINS, {}), SpinPuzzleGame::BINARY_SIZE);
+  ASSERT_EQ(serialized(loaded), rotating_game);
+}
+
 TEST(PuzzleSide, retrieve_current_timestep)
 {
   std::stringstream out;
@@ -326,4 +482,86 @@ TEST(PuzzleSide, retrieve_current_timestep)
   game.load(out);
   auto v3 = game.current_time_step();
   ASSERT_EQ(v1, v3);
-}
\ No newline at end of file
+}
+
+TEST(PuzzleSide, undo_redo)
+{
+  const int keys[] = { Key_N,     Key_E,      Key_W,        Key_I, Key_Left,
+                       Key_Right, Key_PageUp, Key_PageDown, Key_P };
+  const double fractions[] = { 1.0, 0.3, 0.5 };
+  std::mt19937 gen(13);
+  std::uniform_int_distribution<int> key(0, 8);
+  std::uniform_int_distribution<int> fraction(0, 2);
+  std::uniform_int_distribution<int> command(0, 11);
+
+  auto check = [&](const SpinPuzzleGame& game, const std::string& expected) {
+    ASSERT_EQ(serialized(game), expected);
+    SpinPuzzleGame copy(game);
+    copy.refresh();
+    ASSERT_EQ(game.hash(), copy.hash());
+    ASSERT_EQ(game.same_color_count(), copy.same_color_count());
+    ASSERT_EQ(game.legal_commands(), copy.legal_commands());
+  };
+
+  SpinPuzzleGame game;
+  ASSERT_FALSE(game.undo());
+  game.set_undo_limit(5000);
+  // state after every action of the journal
+  std::vector<std::string> states{ serialized(game) };
+  for (int n = 0; n < 2000; ++n) {
+    // discrete commands and keys (border rotations, fractions of spins)
+    if (n % 3 == 0) {
+      game.process_command(static_cast<COMMANDS>(command(gen)));
+    } else {
+      game.process_key(keys[key(gen)], fractions[fraction(gen)]);
+    }
+    states.resize(game.undo_count() + 1);
+    states.back() = serialized(game);
+  }
+  const size_t count = game.undo_count();
+  ASSERT_GT(count, 500ul);
+  for (size_t n = count; n > 0; --n) {
+    ASSERT_TRUE(game.undo());
+    check(game, states[n - 1]);
+  }
+  ASSERT_FALSE(game.undo());
+  ASSERT_EQ(game.redo_count(), count);
+  for (size_t n = 1; n <= count; ++n) {
+    ASSERT_TRUE(game.redo());
+    check(game, states[n]);
+  }
+  ASSERT_FALSE(game.redo());
+
+  // a new action drops the undone ones
+  game.undo();
+  game.undo();
+  game.swap_side();
+  ASSERT_EQ(game.redo_count(), 0ul);
+  ASSERT_TRUE(game.undo());
+  check(game, states[count - 2]);
+
+  game.reset();
+  ASSERT_EQ(game.undo_count(), 0ul);
+
+  // only the last actions are kept
+  SpinPuzzleGame limited;
+  limited.set_undo_limit(3);
+  for (int n = 0; n < 5; ++n) {
+    limited.process_command(COMMANDS::NORTH_RIGHT);
+  }
+  ASSERT_EQ(limited.undo_count(), 3ul);
+  // a copy has its own journal
+  SpinPuzzleGame copy(limited);
+  ASSERT_TRUE(copy.undo());
+  ASSERT_EQ(copy.undo_count(), 2ul);
+  ASSERT_EQ(limited.undo_count(), 3ul);
+  while (limited.undo()) {
+  }
+  SpinPuzzleGame expected;
+  expected.process_command(COMMANDS::NORTH_RIGHT);
+  expected.process_command(COMMANDS::NORTH_RIGHT);
+  check(limited, serialized(expected));
+  limited.set_undo_limit(0);
+  ASSERT_EQ(limited.undo_limit(), 0ul);
+  ASSERT_FALSE(limited.redo());
+}
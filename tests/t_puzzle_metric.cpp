@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 
+#include <random>
 #include <sstream>
 
 #include "puzzle/spin_metrics.h"
@@ -16,3 +17,43 @@ TEST(PuzzleSide, naive_metrics)
   game.shuffle();
   ASSERT_LT(metric.naive_disorder(game), 1.0);
 }
+
+TEST(PuzzleSide, naive_metrics_incremental)
+{
+  const int keys[] = { Key_N,     Key_E,      Key_W,        Key_I, Key_Left,
+                       Key_Right, Key_PageUp, Key_PageDown, Key_P };
+  const double fractions[] = { 1.0, 0.3, 0.5 };
+  std::mt19937 gen(3);
+  std::uniform_int_distribution<int> key(0, 8);
+  std::uniform_int_distribution<int> fraction(0, 2);
+
+  SpinPuzzleGame game;
+  MetricProvider metric;
+  for (int n = 0; n < 3000; ++n) {
+    game.process_key(keys[key(gen)], fractions[fraction(gen)]);
+    ASSERT_EQ(metric.naive_disorder(game), metric.naive_disorder_full(game))
+      << "key n. " << n;
+  }
+  for (uint64_t seed = 1; seed < 20; ++seed) {
+    game.shuffle_with_commands(seed, 50);
+    ASSERT_EQ(metric.naive_disorder(game), metric.naive_disorder_full(game));
+  }
+}
+
+TEST(PuzzleSide, commands_lower_bound)
+{
+  SpinPuzzleGame game;
+  MetricProvider metric;
+
+  ASSERT_EQ(metric.commands_lower_bound(game), 0);
+  game.process_command(COMMANDS::NORTH_SPIN);
+  ASSERT_EQ(metric.commands_lower_bound(game), 1);
+  game.process_command(COMMANDS::NORTH_RIGHT);
+  game.process_command(COMMANDS::NORTH_SPIN);
+  ASSERT_EQ(metric.commands_lower_bound(game), 1);
+  game.process_command(COMMANDS::EAST_SPIN);
+  ASSERT_EQ(metric.commands_lower_bound(game), 2);
+
+  game.get_side(SIDE::FRONT).set_tollerance(0.0);
+  ASSERT_EQ(metric.commands_lower_bound(game), -1);
+}
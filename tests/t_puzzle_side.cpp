@@ -680,3 +680,83 @@ TEST(PuzzleSide, to_string)
     "(15:7), (16:7), (17:7), (18:7), (19:7)\nWEST: (20:8), (21:8), (22:8), "
     "(23:8), (24:8), (25:8), (26:8), (27:8), (28:8), (29:8)");
 }
+
+TEST(PuzzleSide, fixed_point_angles)
+{
+  constexpr int N = 10;
+  constexpr double DTHETA = 360.0 / N;
+  auto puzzle = getPuzzle<N>();
+  // many small rotations do not accumulate any rounding error
+  for (int n = 0; n < 3 * N; ++n) {
+    for (int i = 0; i < 8; ++i) {
+      ASSERT_TRUE(puzzle.rotate_marbles(puzzle::LEAF::NORTH, DTHETA / 8));
+    }
+  }
+  ASSERT_EQ(puzzle.get_phase_shift_leaf(puzzle::LEAF::NORTH), 0.0);
+  ASSERT_TRUE(puzzle.is_discrete());
+  // the shift of the leaves is kept in [0, 360)
+  ASSERT_TRUE(puzzle.rotate_marbles(puzzle::LEAF::EAST, -725.05));
+  ASSERT_DOUBLE_EQ(puzzle.get_phase_shift_leaf(puzzle::LEAF::EAST), 354.95);
+  ASSERT_TRUE(puzzle.rotate_marbles(puzzle::LEAF::EAST, 5.05));
+  ASSERT_EQ(puzzle.get_phase_shift_leaf(puzzle::LEAF::EAST), 0.0);
+  ASSERT_TRUE(puzzle.is_discrete());
+}
+
+TEST(PuzzleSide, rotations_below_a_tick)
+{
+  constexpr int N = 10;
+  auto puzzle = getPuzzle<N>();
+  // a rotation smaller than a tick is kept for the next one (e.g. the small
+  // steps of a drag)
+  constexpr int STEPS = puzzle::SpinPuzzleSide<N>::ANGLE_SCALE;
+  constexpr double STEP = 1.0 / STEPS;
+  ASSERT_TRUE(puzzle.rotate_marbles(puzzle::LEAF::NORTH, STEP));
+  ASSERT_DOUBLE_EQ(puzzle.get_phase_shift_leaf(puzzle::LEAF::NORTH), STEP);
+  for (int n = 1; n < STEPS; ++n) {
+    ASSERT_TRUE(puzzle.rotate_marbles(puzzle::LEAF::NORTH, STEP));
+  }
+  ASSERT_EQ(puzzle.get_phase_shift_leaf(puzzle::LEAF::NORTH), 1.0);
+  for (int n = 0; n < STEPS; ++n) {
+    ASSERT_TRUE(puzzle.rotate_marbles(puzzle::LEAF::NORTH, -STEP));
+  }
+  ASSERT_EQ(puzzle.get_phase_shift_leaf(puzzle::LEAF::NORTH), 0.0);
+  ASSERT_TRUE(puzzle.is_discrete());
+}
+
+template<std::size_t N>
+void
+check_first_marbles(const puzzle::SpinPuzzleSide<N>& puzzle)
+{
+  for (auto leaf : { puzzle::LEAF::NORTH,
+                     puzzle::LEAF::EAST,
+                     puzzle::LEAF::WEST,
+                     puzzle::LEAF::TREFOIL }) {
+    const std::size_t size = (leaf == puzzle::LEAF::TREFOIL) ? 3 * N : N;
+    auto it = puzzle.begin(leaf);
+    for (std::size_t n = 0; n < size; ++n, ++it) {
+      ASSERT_EQ(puzzle.section_marble(leaf, n).id(), it->id());
+    }
+  }
+}
+
+TEST(PuzzleSide, cached_first_marbles)
+{
+  constexpr int N = 10;
+  auto puzzle = getPuzzle<N>();
+  check_first_marbles(puzzle);
+  for (double angle : { 17.95, 18.0, 0.1, -36.15, 200.0, -400.0, 7.5 }) {
+    ASSERT_TRUE(puzzle.rotate_marbles(puzzle::LEAF::EAST, angle));
+    check_first_marbles(puzzle);
+  }
+  ASSERT_TRUE(puzzle.rotate_marbles(puzzle::LEAF::EAST, -23.65));
+  for (auto leaf : { puzzle::LEAF::NORTH, puzzle::LEAF::WEST }) {
+    ASSERT_TRUE(puzzle.rotate_marbles(leaf, 3 * 36.0));
+  }
+  // border rotation
+  ASSERT_TRUE(puzzle.rotate_internal_disk(60));
+  for (double angle : { 1.5, 36.0, -14.0, 3.0 * 36.0 }) {
+    ASSERT_TRUE(puzzle.rotate_marbles(puzzle::LEAF::NORTH, angle));
+    ASSERT_EQ(puzzle.get_trifoild_status(), puzzle::TREFOIL::BORDER_ROTATION);
+    check_first_marbles(puzzle);
+  }
+}
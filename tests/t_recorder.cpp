@@ -1,8 +1,16 @@
 #include <gtest/gtest.h>
 
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <random>
+
 #include "puzzle/spin_game_recorder.h"
 #include "puzzle/spin_puzzle_game.h"
 
+#include "t_helpers.h"
+
 TEST(PuzzleRecorder, ShuffleAndReplay)
 {
   std::stringstream out;
@@ -57,11 +65,11 @@ TEST(PuzzleRecorder, Serialize)
 0 -36 1 0
 0 36 0 0
 4 0 5 0
-1 -0 5 0
+1 0 5 0
 0 36 2 0
 1 0 5 0
 4 0 5 0
-1 -0 5 0
+1 0 5 0
 )";
   std::stringstream out;
   std::shared_ptr<puzzle::Recorder> recorder =
@@ -109,4 +117,446 @@ TEST(PuzzleRecorder, Load)
   gameStrReloaded.seekg(0, std::ios::beg);
   gameStr.seekg(0, std::ios::beg);
   ASSERT_EQ(gameStrReloaded.str(), gameStr.str());
-}
\ No newline at end of file
+}
+
+TEST(PuzzleRecorder, Seek)
+{
+  std::shared_ptr<puzzle::Recorder> recorder =
+    std::make_shared<puzzle::Recorder>();
+  puzzle::SpinPuzzleGame game;
+  game.attach_recorder(recorder);
+  game.start_recording();
+  // keys with fractions of angles and commands
+  game.shuffle(7, 1000);
+  game.shuffle_with_commands(42, 1000);
+  recorder = game.detached_recorder();
+  const size_t size = recorder->size();
+  ASSERT_GT(size, 1000ul);
+
+  // state after n events, played from the start
+  puzzle::Recorder reference(*recorder);
+  reference.set_keyframe_interval(0);
+  auto expected = [&](size_t n) {
+    puzzle::SpinPuzzleGame played;
+    reference.rewind(played);
+    reference.step_forward(played, n);
+    return serialized(played);
+  };
+
+  recorder->set_keyframe_interval(100);
+  puzzle::SpinPuzzleGame replayed;
+  ASSERT_FALSE(recorder->seek(replayed, size + 1));
+  // the first seek to the end takes the keyframes
+  ASSERT_TRUE(recorder->seek(replayed, size));
+  ASSERT_EQ(recorder->keyframes(), size / 100);
+  ASSERT_TRUE(recorder->isEnd());
+  ASSERT_EQ(serialized(replayed), serialized(game));
+
+  for (size_t n : { size_t(0), size_t(1), size_t(99), size_t(100),
+                    size_t(101), size / 2, size - 1, size_t(350) }) {
+    ASSERT_TRUE(recorder->seek(replayed, n));
+    ASSERT_EQ(recorder->current(), n);
+    ASSERT_EQ(serialized(replayed), expected(n)) << "event " << n;
+  }
+  // play forward from a seek
+  ASSERT_TRUE(recorder->seek(replayed, 250));
+  recorder->step_forward(replayed, 10);
+  ASSERT_EQ(serialized(replayed), expected(260));
+
+  ASSERT_TRUE(
+    recorder->seek_time(replayed, std::numeric_limits<size_t>::max()));
+  ASSERT_TRUE(recorder->isEnd());
+  ASSERT_EQ(serialized(replayed), serialized(game));
+}
+
+TEST(PuzzleRecorder, TimeIndex)
+{
+  puzzle::SpinPuzzleGame game;
+  std::stringstream in;
+  game.serialize(in);
+  // NORTH_RIGHT at the given times, the clock goes back once
+  const size_t times[] = { 1000, 1000, 1500, 3000, 2900, 4000 };
+  in << 6 << "\n";
+  for (size_t time : times) {
+    in << "0 36 0 " << time << "\n";
+  }
+  puzzle::Recorder recorder;
+  recorder.load(in);
+  ASSERT_EQ(recorder.size(), 6ul);
+
+  using Range = std::pair<size_t, size_t>;
+  ASSERT_EQ(recorder.time_range(0, 1), Range(0, 2));
+  ASSERT_EQ(recorder.time_range(0, 500), Range(0, 2));
+  ASSERT_EQ(recorder.time_range(1, 2000), Range(2, 3));
+  ASSERT_EQ(recorder.time_range(2000, 2001), Range(3, 5));
+  ASSERT_EQ(recorder.time_range(2001, 10000), Range(5, 6));
+  ASSERT_EQ(recorder.time_range(5000, 6000), Range(6, 6));
+
+  auto north = [](const puzzle::SpinPuzzleGame& game) {
+    return game.get_side(puzzle::SIDE::FRONT)
+      .get_phase_shift_leaf(puzzle::LEAF::NORTH);
+  };
+  puzzle::SpinPuzzleGame replayed;
+  recorder.rewind(replayed);
+  ASSERT_EQ(recorder.current_time(), 0ul);
+  // up to the first event 500 ms after the current one, included
+  ASSERT_EQ(recorder.play(replayed, 500), 3ul);
+  ASSERT_EQ(recorder.current_time(), 2000ul);
+  ASSERT_EQ(recorder.play(replayed, 0), 4ul);
+  ASSERT_EQ(recorder.play(replayed, 10000), 6ul);
+  ASSERT_TRUE(recorder.isEnd());
+  ASSERT_EQ(recorder.current_time(), 3000ul);
+  ASSERT_DOUBLE_EQ(north(replayed), 216.0);
+
+  ASSERT_TRUE(recorder.seek_time(replayed, 1999));
+  ASSERT_EQ(recorder.current(), 3ul);
+  ASSERT_DOUBLE_EQ(north(replayed), 108.0);
+}
+
+TEST(PuzzleRecorder, Binary)
+{
+  ASSERT_EQ(sizeof(puzzle::Recorder::Event), 8ul);
+
+  std::shared_ptr<puzzle::Recorder> recorder =
+    std::make_shared<puzzle::Recorder>();
+  puzzle::SpinPuzzleGame game;
+  game.attach_recorder(recorder);
+  game.start_recording();
+  // small angles and commands
+  std::mt19937 gen(3);
+  std::uniform_real_distribution<double> angle(-5.0, 5.0);
+  std::uniform_int_distribution<int> leaf(0, 3);
+  for (int n = 0; n < 2000; ++n) {
+    game.rotate_marbles(static_cast<puzzle::LEAF>(leaf(gen)), angle(gen));
+    if (n % 50 == 0) {
+      game.rotate_internal_disk(angle(gen));
+      game.spin_leaf(static_cast<puzzle::LEAF>(leaf(gen) % 3));
+    }
+  }
+  game.shuffle_with_commands(42, 500);
+  recorder = game.detached_recorder();
+
+  std::stringstream text;
+  recorder->serialize(text);
+  std::stringstream binary;
+  recorder->serialize_binary(binary);
+  ASSERT_LT(binary.str().size(), text.str().size() / 4);
+
+  puzzle::Recorder loaded;
+  ASSERT_TRUE(loaded.load_binary(binary));
+  ASSERT_EQ(loaded.size(), recorder->size());
+  std::stringstream reloaded;
+  loaded.serialize(reloaded);
+  ASSERT_EQ(reloaded.str(), text.str());
+
+  puzzle::SpinPuzzleGame replayed;
+  loaded.replay(replayed);
+  ASSERT_EQ(serialized(replayed), serialized(game));
+
+  // truncated data
+  std::stringstream truncated(binary.str().substr(0, binary.str().size() / 2));
+  ASSERT_FALSE(loaded.load_binary(truncated));
+  ASSERT_EQ(loaded.size(), recorder->size());
+}
+
+TEST(PuzzleRecorder, ExactAngles)
+{
+  // the game rounds the angles as the events, which replay it exactly
+  using Side = puzzle::SpinPuzzleSide<>;
+  puzzle::SpinPuzzleGame expected;
+  puzzle::SpinPuzzleGame game;
+  game.attach_recorder(std::make_shared<puzzle::Recorder>());
+  game.start_recording();
+  const double angles[] = { 0.001, 1.0 / 3.0, 0.0021, -1.0 / 7.0 };
+  for (const double angle : angles) {
+    game.rotate_marbles(puzzle::LEAF::NORTH, angle);
+    expected.rotate_marbles(puzzle::LEAF::NORTH, Side::round_angle(angle));
+    game.rotate_marbles(puzzle::LEAF::TREFOIL, angle);
+    expected.rotate_marbles(puzzle::LEAF::TREFOIL, Side::round_angle(angle));
+  }
+  game.rotate_internal_disk(0.0001);
+  ASSERT_EQ(serialized(game), serialized(expected));
+
+  const auto recorder = game.detached_recorder();
+  ASSERT_EQ(recorder->size(), 9ul);
+  puzzle::SpinPuzzleGame replayed;
+  recorder->replay(replayed);
+  ASSERT_EQ(serialized(replayed), serialized(game));
+}
+
+TEST(PuzzleRecorder, BinaryCorrupted)
+{
+  // a stream with the start game and the given events
+  const std::string game = serialized(puzzle::SpinPuzzleGame());
+  auto stream = [&](uint64_t game_size, const std::string& events) {
+    std::string bytes = "SPRC\x02";
+    for (; game_size >= 0x80; game_size >>= 7) {
+      bytes.push_back(static_cast<char>((game_size & 0x7f) | 0x80));
+    }
+    bytes.push_back(static_cast<char>(game_size));
+    return std::stringstream(bytes + game + events);
+  };
+  // rotation of the north leaf by 0 degree
+  const std::string event("\x00\x00\x00", 3);
+
+  puzzle::Recorder loaded;
+  auto valid = stream(game.size(), event + event);
+  ASSERT_TRUE(loaded.load_binary(valid));
+  ASSERT_EQ(loaded.size(), 2ul);
+
+  // the size of the game is larger than the data, or absurd
+  auto too_large = stream(game.size() + 10, "");
+  ASSERT_FALSE(loaded.load_binary(too_large));
+  auto huge = stream(uint64_t(1) << 40, event);
+  ASSERT_FALSE(loaded.load_binary(huge));
+  // unknown type, unknown leaf
+  auto type = stream(game.size(), event + std::string("\x05\x00\x00", 3));
+  ASSERT_FALSE(loaded.load_binary(type));
+  auto leaf = stream(game.size(), event + std::string("\x30\x00\x00", 3));
+  ASSERT_FALSE(loaded.load_binary(leaf));
+  // the recorder is left as it was
+  ASSERT_EQ(loaded.size(), 2ul);
+}
+
+TEST(PuzzleRecorder, Coalescing)
+{
+  // the same rotations with and without coalescing
+  auto record = [](puzzle::SpinPuzzleGame& game, size_t window) {
+    std::shared_ptr<puzzle::Recorder> recorder =
+      std::make_shared<puzzle::Recorder>();
+    recorder->set_coalescing(window);
+    game.attach_recorder(recorder);
+    game.start_recording();
+    // a drag of the mouse on every leaf
+    std::mt19937 gen(5);
+    std::uniform_real_distribution<double> delta(-1.0, 3.0);
+    const puzzle::LEAF leaves[] = { puzzle::LEAF::NORTH,
+                                    puzzle::LEAF::EAST,
+                                    puzzle::LEAF::WEST,
+                                    puzzle::LEAF::NORTH };
+    for (auto leaf : leaves) {
+      for (int n = 0; n < 200; ++n) {
+        game.rotate_marbles(leaf, delta(gen));
+      }
+    }
+    game.spin_leaf(puzzle::LEAF::EAST);
+    game.rotate_marbles(puzzle::LEAF::EAST, 36.0);
+    game.rotate_marbles(puzzle::LEAF::EAST, -72.0);
+    return game.detached_recorder();
+  };
+
+  puzzle::SpinPuzzleGame expected;
+  const auto all = record(expected, 0);
+  ASSERT_EQ(all->size(), 803ul);
+
+  puzzle::SpinPuzzleGame game;
+  const auto merged = record(game, 60000);
+  ASSERT_EQ(merged->size(), 6ul);
+  ASSERT_EQ(serialized(game), serialized(expected));
+  puzzle::SpinPuzzleGame replayed;
+  merged->replay(replayed);
+  ASSERT_EQ(serialized(replayed), serialized(expected));
+
+  // the rotations of the border are not merged
+  std::shared_ptr<puzzle::Recorder> recorder =
+    std::make_shared<puzzle::Recorder>();
+  recorder->set_coalescing(60000);
+  puzzle::SpinPuzzleGame border;
+  border.attach_recorder(recorder);
+  border.start_recording();
+  ASSERT_TRUE(border.rotate_internal_disk(60.0));
+  for (int n = 0; n < 50; ++n) {
+    border.rotate_marbles(puzzle::LEAF::NORTH, 1.5);
+  }
+  recorder = border.detached_recorder();
+  ASSERT_EQ(recorder->size(), 51ul);
+  recorder->replay(replayed);
+  ASSERT_EQ(serialized(replayed), serialized(border));
+}
+
+TEST(PuzzleRecorder, CoalescingBelowATick)
+{
+  // a slow drag: steps smaller than a tick (1/20 degree), not at the
+  // resolution of the events, whose sums cross the ticks
+  auto record = [](puzzle::SpinPuzzleGame& game, size_t window) {
+    std::shared_ptr<puzzle::Recorder> recorder =
+      std::make_shared<puzzle::Recorder>();
+    recorder->set_coalescing(window);
+    game.attach_recorder(recorder);
+    game.start_recording();
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<double> delta(-0.031, 0.047);
+    for (auto leaf : { puzzle::LEAF::WEST, puzzle::LEAF::NORTH }) {
+      for (int n = 0; n < 1000; ++n) {
+        game.rotate_marbles(leaf, delta(gen));
+      }
+    }
+    return game.detached_recorder();
+  };
+
+  puzzle::SpinPuzzleGame expected;
+  const auto all = record(expected, 0);
+  ASSERT_EQ(all->size(), 2000ul);
+  ASSERT_NE(serialized(expected), serialized(puzzle::SpinPuzzleGame()));
+
+  puzzle::SpinPuzzleGame game;
+  const auto merged = record(game, 60000);
+  ASSERT_EQ(merged->size(), 2ul);
+  ASSERT_EQ(serialized(game), serialized(expected));
+  for (const auto& recorder : { all, merged }) {
+    puzzle::SpinPuzzleGame replayed;
+    recorder->replay(replayed);
+    ASSERT_EQ(serialized(replayed), serialized(expected));
+  }
+}
+
+TEST(PuzzleRecorder, Stream)
+{
+  const std::string filename = "QSpinPuzzle_test_stream.rec";
+  std::shared_ptr<puzzle::Recorder> recorder =
+    std::make_shared<puzzle::Recorder>();
+  recorder->set_coalescing(60000);
+  puzzle::SpinPuzzleGame game;
+  game.attach_recorder(recorder);
+  ASSERT_TRUE(recorder->rec(game, filename));
+  for (int n = 0; n < 100; ++n) {
+    game.rotate_marbles(puzzle::LEAF::WEST, 0.35);
+  }
+  game.shuffle_with_commands(7, 300);
+  // only the last event is kept in memory
+  ASSERT_EQ(recorder->size(), 1ul);
+  recorder = game.detached_recorder();
+  ASSERT_EQ(recorder->size(), 0ul);
+
+  std::string bytes;
+  {
+    std::ifstream in(filename, std::ios::binary);
+    bytes.assign(std::istreambuf_iterator<char>(in), {});
+  }
+  puzzle::Recorder loaded;
+  std::stringstream complete(bytes);
+  ASSERT_TRUE(loaded.load_binary(complete));
+  const size_t size = loaded.size();
+  ASSERT_GT(size, 1ul);
+  puzzle::SpinPuzzleGame replayed;
+  loaded.replay(replayed);
+  ASSERT_EQ(serialized(replayed), serialized(game));
+
+  // a crash in the middle of the last event
+  std::stringstream truncated(bytes.substr(0, bytes.size() - 1));
+  ASSERT_TRUE(loaded.load_binary(truncated));
+  ASSERT_EQ(loaded.size(), size - 1);
+  ASSERT_TRUE(loaded.seek(replayed, loaded.size()));
+
+  // a recorder destroyed while recording writes the event kept in memory
+  {
+    puzzle::SpinPuzzleGame played;
+    recorder = std::make_shared<puzzle::Recorder>();
+    played.attach_recorder(recorder);
+    ASSERT_TRUE(recorder->rec(played, filename));
+    played.rotate_marbles(puzzle::LEAF::NORTH, 36.0);
+    played.rotate_marbles(puzzle::LEAF::EAST, 72.0);
+    ASSERT_EQ(recorder->size(), 1ul);
+    recorder.reset();
+  }
+  {
+    std::ifstream in(filename, std::ios::binary);
+    ASSERT_TRUE(loaded.load_binary(in));
+  }
+  ASSERT_EQ(loaded.size(), 2ul);
+
+  std::remove(filename.c_str());
+}
+
+TEST(PuzzleRecorder, Window)
+{
+  std::shared_ptr<puzzle::Recorder> recorder =
+    std::make_shared<puzzle::Recorder>();
+  recorder->set_window(100);
+  puzzle::SpinPuzzleGame game;
+  game.attach_recorder(recorder);
+  game.start_recording();
+  std::mt19937 gen(11);
+  std::uniform_real_distribution<double> angle(-4.0, 4.0);
+  std::uniform_int_distribution<int> leaf(0, 2);
+  for (int n = 0; n < 1000; ++n) {
+    if (n % 3 == 0) {
+      game.spin_leaf(static_cast<puzzle::LEAF>(leaf(gen)));
+    } else {
+      game.rotate_marbles(static_cast<puzzle::LEAF>(leaf(gen)), angle(gen));
+    }
+    ASSERT_LE(recorder->size(), 100ul);
+  }
+  recorder = game.detached_recorder();
+  ASSERT_EQ(recorder->size() + recorder->dropped(), 1000ul);
+
+  puzzle::SpinPuzzleGame replayed;
+  recorder->replay(replayed);
+  ASSERT_EQ(serialized(replayed), serialized(game));
+}
+
+TEST(PuzzleRecorder, WindowBelowATick)
+{
+  // the start game written by the window keeps the parts of a tick of the
+  // border rotations, that move the leaves by 1/12 of the angle
+  std::shared_ptr<puzzle::Recorder> recorder =
+    std::make_shared<puzzle::Recorder>();
+  recorder->set_window(40);
+  puzzle::SpinPuzzleGame game;
+  game.attach_recorder(recorder);
+  game.start_recording();
+  std::mt19937 gen(13);
+  std::uniform_real_distribution<double> angle(-0.13, 0.17);
+  std::uniform_int_distribution<int> leaf(0, 3);
+  ASSERT_TRUE(game.rotate_internal_disk(60.0));
+  for (int n = 1; n < 500; ++n) {
+    game.rotate_marbles(static_cast<puzzle::LEAF>(leaf(gen)), angle(gen));
+  }
+  ASSERT_EQ(game.get_side().get_trifoild_status(),
+            puzzle::TREFOIL::BORDER_ROTATION);
+  recorder = game.detached_recorder();
+  ASSERT_GT(recorder->dropped(), 0ul);
+  ASSERT_EQ(recorder->size() + recorder->dropped(), 500ul);
+
+  puzzle::SpinPuzzleGame replayed;
+  recorder->replay(replayed);
+  ASSERT_EQ(serialized(replayed), serialized(game));
+}
+
+TEST(PuzzleRecorder, WindowTime)
+{
+  // ten seconds of events, one every 10 milliseconds
+  std::stringstream text;
+  text << serialized(puzzle::SpinPuzzleGame()) << 1000 << "\n";
+  std::mt19937 gen(13);
+  std::uniform_int_distribution<int> ticks(-80, 80);
+  std::uniform_int_distribution<int> leaf(0, 2);
+  using EventType = puzzle::Recorder::EventType;
+  for (int n = 0; n < 1000; ++n) {
+    const bool spin = (n % 3 == 0);
+    const auto type = spin ? EventType::SPIN_LEAF : EventType::ROTATE_MARBLES;
+    const double angle = spin ? 180.0 : ticks(gen) / 20.0;
+    puzzle::Recorder::Event(type, angle, static_cast<puzzle::LEAF>(leaf(gen)))
+      .serialize(text, 10 * n);
+  }
+
+  puzzle::Recorder all;
+  std::stringstream all_text(text.str());
+  all.load(all_text);
+  ASSERT_EQ(all.size(), 1000ul);
+
+  // only the last two seconds are kept
+  puzzle::Recorder window;
+  window.set_window(0, 2000);
+  window.load(text);
+  ASSERT_GT(window.dropped(), 0ul);
+  ASSERT_LE(window.size(), 201ul);
+  ASSERT_EQ(window.size() + window.dropped(), 1000ul);
+
+  puzzle::SpinPuzzleGame expected;
+  all.replay(expected);
+  ASSERT_NE(serialized(expected), serialized(puzzle::SpinPuzzleGame()));
+  puzzle::SpinPuzzleGame replayed;
+  window.replay(replayed);
+  ASSERT_EQ(serialized(replayed), serialized(expected));
+}
@@ -0,0 +1,157 @@
+#include <gtest/gtest.h>
+
+#include "puzzle/spin_action_provider.h"
+#include "puzzle/spin_metrics.h"
+#include "puzzle/spin_puzzle_game.h"
+#include "puzzle/spin_solver.h"
+
+using namespace puzzle;
+
+namespace {
+bool
+is_solution(SpinPuzzleGame game, const std::vector<COMMANDS>& solution)
+{
+  for (auto command : solution) {
+    game.process_command(command);
+  }
+  return game.is_game_solved();
+}
+} // namespace
+
+TEST(Solver, solved_game)
+{
+  SpinPuzzleGame game;
+  SpinSolver solver;
+  std::vector<COMMANDS> solution{ COMMANDS::NORTH_SPIN };
+  ASSERT_TRUE(solver.solve(game, solution));
+  ASSERT_TRUE(solution.empty());
+  ASSERT_EQ(solver.statistics().nodes, 0u);
+}
+
+TEST(Solver, one_spin)
+{
+  SpinPuzzleGame game;
+  game.process_command(COMMANDS::EAST_SPIN);
+  game.process_command(COMMANDS::SWAP_SIDE);
+  SpinSolver solver;
+  std::vector<COMMANDS> solution;
+  ASSERT_TRUE(solver.solve(game, solution));
+  ASSERT_EQ(solution, std::vector<COMMANDS>{ COMMANDS::WEST_SPIN });
+}
+
+TEST(Solver, scrambles)
+{
+  ActionProvider ap;
+  for (int seed = 1; seed <= 10; ++seed) {
+    SpinPuzzleGame game;
+    int scramble = 0;
+    for (auto command : ap.getSequenceOfCommands(seed, 6)) {
+      game.process_command(command);
+      scramble += (command != COMMANDS::INTERNAL_LEFT &&
+                   command != COMMANDS::INTERNAL_RIGHT);
+    }
+    SpinSolver solver;
+    std::vector<COMMANDS> solution;
+    ASSERT_TRUE(solver.solve(game, solution)) << "seed " << seed;
+    ASSERT_TRUE(is_solution(game, solution)) << "seed " << seed;
+    ASSERT_LE(static_cast<int>(solution.size()), scramble);
+    ASSERT_LE(MetricProvider().commands_lower_bound(game),
+              static_cast<int>(solution.size()));
+    const auto& statistics = solver.statistics();
+    ASSERT_GE(statistics.iterations, 1u);
+    ASSERT_GT(statistics.peak_memory, 0u);
+    ASSERT_GE(statistics.nodes, solution.size());
+  }
+}
+
+TEST(Solver, limits)
+{
+  SpinPuzzleGame game;
+  game.shuffle_with_commands(4, 200);
+  std::vector<COMMANDS> solution;
+  SpinSolver shallow(2);
+  ASSERT_FALSE(shallow.solve(game, solution));
+  ASSERT_TRUE(solution.empty());
+
+  SpinSolver limited(30, 1000);
+  ASSERT_FALSE(limited.solve(game, solution));
+  ASSERT_EQ(limited.statistics().nodes, 1000u);
+
+  // the internal disk moves the marbles out of the pairs of leaves
+  SpinPuzzleGame mixed;
+  mixed.rotate_internal_disk(60.0);
+  mixed.rotate_internal_disk(-60.0 + 120.0);
+  ASSERT_FALSE(SpinSolver().solve(mixed, solution));
+}
+
+TEST(Solver, pruning)
+{
+  ASSERT_FALSE(SpinSolver::is_allowed(
+    COMMANDS::N_COMMANDS, 0, COMMANDS::INTERNAL_LEFT));
+  ASSERT_FALSE(
+    SpinSolver::is_allowed(COMMANDS::SWAP_SIDE, 1, COMMANDS::SWAP_SIDE));
+  ASSERT_FALSE(
+    SpinSolver::is_allowed(COMMANDS::EAST_RIGHT, 1, COMMANDS::EAST_LEFT));
+  ASSERT_FALSE(
+    SpinSolver::is_allowed(COMMANDS::EAST_RIGHT, 1, COMMANDS::NORTH_RIGHT));
+  ASSERT_TRUE(
+    SpinSolver::is_allowed(COMMANDS::NORTH_RIGHT, 1, COMMANDS::EAST_LEFT));
+  ASSERT_TRUE(
+    SpinSolver::is_allowed(COMMANDS::NORTH_RIGHT, 4, COMMANDS::NORTH_RIGHT));
+  ASSERT_FALSE(
+    SpinSolver::is_allowed(COMMANDS::NORTH_RIGHT, 5, COMMANDS::NORTH_RIGHT));
+  ASSERT_FALSE(
+    SpinSolver::is_allowed(COMMANDS::NORTH_LEFT, 4, COMMANDS::NORTH_LEFT));
+  ASSERT_FALSE(
+    SpinSolver::is_allowed(COMMANDS::EAST_SPIN, 1, COMMANDS::EAST_SPIN));
+  ASSERT_FALSE(
+    SpinSolver::is_allowed(COMMANDS::SWAP_SIDE, 1, COMMANDS::NORTH_SPIN));
+}
+
+TEST(Solver, parallel)
+{
+  ActionProvider ap;
+  for (int seed = 1; seed <= 10; ++seed) {
+    SpinPuzzleGame game;
+    for (auto command : ap.getSequenceOfCommands(seed, 8)) {
+      game.process_command(command);
+    }
+    SpinSolver serial;
+    std::vector<COMMANDS> expected;
+    ASSERT_TRUE(serial.solve(game, expected));
+
+    SpinSolver parallel;
+    parallel.set_threads(4);
+    ASSERT_EQ(parallel.threads(), 4u);
+    std::vector<COMMANDS> solution;
+    ASSERT_TRUE(parallel.solve(game, solution)) << "seed " << seed;
+    ASSERT_TRUE(is_solution(game, solution)) << "seed " << seed;
+    // both are optimal
+    ASSERT_EQ(solution.size(), expected.size()) << "seed " << seed;
+
+    const auto& threads = parallel.thread_statistics();
+    ASSERT_EQ(threads.size(), 4u);
+    uint64_t nodes = 0;
+    for (const auto& thread : threads) {
+      nodes += thread.nodes;
+    }
+    ASSERT_EQ(nodes, parallel.statistics().nodes);
+  }
+}
+
+TEST(Solver, parallel_limits)
+{
+  SpinPuzzleGame game;
+  game.shuffle_with_commands(4, 200);
+  std::vector<COMMANDS> solution;
+  SpinSolver limited(30, 5000);
+  limited.set_threads(3);
+  ASSERT_FALSE(limited.solve(game, solution));
+  ASSERT_TRUE(solution.empty());
+
+  SpinSolver solver;
+  solver.set_threads(0);
+  ASSERT_GE(solver.threads(), 1u);
+  ASSERT_TRUE(solver.solve(SpinPuzzleGame(), solution));
+  ASSERT_TRUE(solution.empty());
+}
@@ -0,0 +1,148 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+
+#include "puzzle/spin_action_provider.h"
+#include "puzzle/spin_packed_state.h"
+#include "puzzle/spin_puzzle_game.h"
+#include "puzzle/spin_solver.h"
+#include "puzzle/spin_symmetry.h"
+
+using namespace puzzle;
+
+namespace {
+using Layout = Symmetry::Layout;
+
+SpinPuzzleGame
+scrambled(int seed, int commands)
+{
+  SpinPuzzleGame game;
+  game.shuffle_with_commands(seed, commands);
+  return game;
+}
+
+Layout
+apply(const Layout& layout, SIDE side, COMMANDS command)
+{
+  Layout out = layout;
+  DiscreteMoves::apply(DiscreteMoves::moves(side, command), out.data());
+  return out;
+}
+
+SpinPuzzleGame
+game_of(const Layout& layout, SIDE side)
+{
+  std::array<SpinMarble, 30> front;
+  std::array<SpinMarble, 30> back;
+  for (size_t p = 0; p < 30; ++p) {
+    front[p] = SpinMarble(static_cast<int32_t>(p), layout[p]);
+    back[p] = SpinMarble(static_cast<int32_t>(p + 30), layout[p + 30]);
+  }
+  SpinPuzzleGame game(front, back);
+  if (side == SIDE::BACK) {
+    game.swap_side();
+  }
+  return game;
+}
+} // namespace
+
+TEST(Symmetry, commands_commute)
+{
+  for (int seed = 1; seed <= 5; ++seed) {
+    const auto game = scrambled(seed, 100);
+    const auto layout = MetricProvider::layout(game);
+    const auto side = game.get_active_side();
+    for (size_t g = 0; g < Symmetry::N_GEOMETRIC; ++g) {
+      Layout image;
+      const SIDE image_side = Symmetry::transform(g, layout, side, image);
+      for (uint8_t c = 0; c < static_cast<uint8_t>(COMMANDS::WEST_SPIN); ++c) {
+        const auto command = static_cast<COMMANDS>(c);
+        Layout expected;
+        Symmetry::transform(g, apply(layout, side, command), side, expected);
+        const auto image_command = Symmetry::transform(g, side, command);
+        ASSERT_EQ(apply(image, image_side, image_command), expected)
+          << "symmetry " << g << " command " << static_cast<int>(c);
+      }
+    }
+  }
+}
+
+TEST(Symmetry, canonical_representative)
+{
+  const std::array<Color, 6> palette = { puzzle::blue,    puzzle::green,
+                                         puzzle::magenta, puzzle::cyan,
+                                         puzzle::red,     puzzle::yellow };
+  std::mt19937 gen(3);
+  for (int seed = 1; seed <= 5; ++seed) {
+    const auto game = scrambled(seed, 100);
+    auto layout = MetricProvider::layout(game);
+    auto side = game.get_active_side();
+    Layout canonical = layout;
+    SIDE canonical_side = side;
+    ASSERT_TRUE(Symmetry::canonicalize(canonical, canonical_side));
+    ASSERT_EQ(canonical_side, SIDE::FRONT);
+
+    // every image, with the colors relabelled, has the same representative
+    for (size_t g = 0; g < Symmetry::N_GEOMETRIC; ++g) {
+      auto colors = palette;
+      std::shuffle(colors.begin(), colors.end(), gen);
+      Layout image;
+      SIDE image_side = Symmetry::transform(g, layout, side, image);
+      for (auto& color : image) {
+        const auto n = std::find(palette.begin(), palette.end(), color);
+        color = colors[n - palette.begin()];
+      }
+      ASSERT_TRUE(Symmetry::canonicalize(image, image_side));
+      ASSERT_EQ(image, canonical) << "symmetry " << g;
+      ASSERT_EQ(image_side, SIDE::FRONT);
+    }
+
+    // equivalent states have the same distance to the goal
+    SpinSolver solver;
+    std::vector<COMMANDS> solution, canonical_solution;
+    ASSERT_TRUE(solver.solve(scrambled(seed, 6), solution));
+    auto small = MetricProvider::layout(scrambled(seed, 6));
+    auto small_side = scrambled(seed, 6).get_active_side();
+    ASSERT_TRUE(Symmetry::canonicalize(small, small_side));
+    ASSERT_TRUE(solver.solve(game_of(small, small_side), canonical_solution));
+    ASSERT_EQ(solution.size(), canonical_solution.size());
+  }
+}
+
+TEST(Symmetry, canonical_state)
+{
+  const auto game = scrambled(11, 100);
+  PackedState state;
+  ASSERT_TRUE(Symmetry::canonicalize(game, state));
+
+  // the representative is a valid game with the same class
+  SpinPuzzleGame canonical;
+  ASSERT_TRUE(state.unpack(canonical));
+  ASSERT_TRUE(canonical.check_consistency());
+  ASSERT_EQ(canonical.get_active_side(), SIDE::FRONT);
+  auto layout = MetricProvider::layout(game);
+  auto side = game.get_active_side();
+  ASSERT_TRUE(Symmetry::canonicalize(layout, side));
+  ASSERT_EQ(MetricProvider::layout(canonical), layout);
+
+  // the image of the game has the same representative
+  for (size_t g = 0; g < Symmetry::N_GEOMETRIC; ++g) {
+    Layout image;
+    const auto image_side = Symmetry::transform(
+      g, MetricProvider::layout(game), game.get_active_side(), image);
+    PackedState image_state;
+    ASSERT_TRUE(
+      Symmetry::canonicalize(game_of(image, image_side), image_state));
+    ASSERT_EQ(image_state, state) << "symmetry " << g;
+  }
+
+  PackedState packed;
+  ASSERT_TRUE(packed.pack(game));
+  ASSERT_TRUE(Symmetry::canonicalize(packed));
+  ASSERT_EQ(packed, state);
+
+  SpinPuzzleGame generic;
+  generic.rotate_marbles(LEAF::NORTH, 10.0);
+  ASSERT_FALSE(Symmetry::canonicalize(generic, state));
+}
@@ -0,0 +1,149 @@
+#include <gtest/gtest.h>
+
+#include <random>
+#include <sstream>
+
+#include "puzzle/spin_action_provider.h"
+#include "puzzle/spin_packed_state.h"
+#include "puzzle/spin_puzzle_game.h"
+#include "puzzle/spin_transposition_table.h"
+#include "puzzle/spin_zobrist.h"
+
+using namespace puzzle;
+
+namespace {
+// hash recomputed from scratch
+uint64_t
+full_hash(const SpinPuzzleGame& game)
+{
+  SpinPuzzleGame copy(game);
+  copy.rehash();
+  return copy.hash();
+}
+} // namespace
+
+TEST(Zobrist, keys)
+{
+  ASSERT_EQ(Zobrist::key(1, SpinMarble::INVALID_COLOR), 0ull);
+  ASSERT_NE(Zobrist::key(1, puzzle::red), Zobrist::key(2, puzzle::red));
+  ASSERT_NE(Zobrist::key(1, puzzle::red), Zobrist::key(1, puzzle::blue));
+  ASSERT_EQ(Zobrist::key(5, puzzle::green), Zobrist::key(5, puzzle::green));
+}
+
+TEST(Zobrist, incremental_with_keys)
+{
+  const int keys[] = { Key_N,     Key_E,      Key_W,        Key_I, Key_Left,
+                       Key_Right, Key_PageUp, Key_PageDown, Key_P };
+  const double fractions[] = { 1.0, 0.3, 0.5, 0.05 };
+  std::mt19937 gen(7);
+  std::uniform_int_distribution<int> key(0, 8);
+  std::uniform_int_distribution<int> fraction(0, 3);
+
+  SpinPuzzleGame game;
+  for (int n = 0; n < 3000; ++n) {
+    game.process_key(keys[key(gen)], fractions[fraction(gen)]);
+    ASSERT_EQ(game.hash(), full_hash(game)) << "key n. " << n;
+  }
+}
+
+TEST(Zobrist, incremental_with_trefoil)
+{
+  std::mt19937 gen(11);
+  std::uniform_int_distribution<int> leaf(0, 3);
+  std::uniform_real_distribution<double> angle(-40.0, 40.0);
+
+  SpinPuzzleGame game;
+  for (int n = 0; n < 2000; ++n) {
+    switch (n % 4) {
+      case 0:
+        game.rotate_marbles(static_cast<LEAF>(leaf(gen)), angle(gen));
+        break;
+      case 1:
+        game.rotate_internal_disk(angle(gen));
+        break;
+      case 2:
+        game.spin_leaf(static_cast<LEAF>(leaf(gen) % 3));
+        break;
+      default:
+        game.rotate_marbles(LEAF::TREFOIL, angle(gen));
+    }
+    ASSERT_EQ(game.hash(), full_hash(game)) << "action n. " << n;
+  }
+}
+
+TEST(Zobrist, incremental_with_commands)
+{
+  SpinPuzzleGame game;
+  ActionProvider ap;
+  for (auto command : ap.getSequenceOfCommands(3, 2000)) {
+    game.process_command(command);
+    ASSERT_EQ(game.hash(), full_hash(game));
+  }
+}
+
+TEST(Zobrist, same_observation_same_hash)
+{
+  SpinPuzzleGame game;
+  const auto initial = game.hash();
+  // the marbles of a leaf have the same color: mix them with a spin
+  game.process_command(COMMANDS::NORTH_SPIN);
+  const auto spinned = game.hash();
+  ASSERT_NE(spinned, initial);
+  game.process_command(COMMANDS::NORTH_RIGHT);
+  ASSERT_NE(game.hash(), spinned);
+  for (int n = 1; n < 10; ++n) {
+    game.process_command(COMMANDS::NORTH_RIGHT);
+  }
+  ASSERT_EQ(game.hash(), spinned);
+  game.process_command(COMMANDS::NORTH_SPIN);
+  ASSERT_EQ(game.hash(), initial);
+
+  game.swap_side();
+  ASSERT_NE(game.hash(), initial);
+  game.swap_side();
+  ASSERT_EQ(game.hash(), initial);
+
+  game.shuffle(5, 200);
+  game.reset();
+  ASSERT_EQ(game.hash(), initial);
+
+  SpinPuzzleGame first, second;
+  first.shuffle(5, 200);
+  second.shuffle(5, 200);
+  ASSERT_EQ(first.hash(), second.hash());
+  ASSERT_NE(first.hash(), initial);
+}
+
+TEST(Zobrist, load_and_unpack)
+{
+  SpinPuzzleGame game;
+  game.shuffle_with_commands(9, 500);
+
+  std::stringstream s;
+  game.serialize(s);
+  SpinPuzzleGame loaded;
+  loaded.load(s);
+  ASSERT_EQ(loaded.hash(), game.hash());
+
+  PackedState state;
+  ASSERT_TRUE(state.pack(game));
+  SpinPuzzleGame unpacked;
+  ASSERT_TRUE(state.unpack(unpacked));
+  ASSERT_EQ(unpacked.hash(), game.hash());
+}
+
+TEST(Zobrist, transposition_table)
+{
+  TranspositionTable table(4);
+  ASSERT_EQ(table.size(), 16u);
+  ASSERT_FALSE(table.visit(0x12345678abcdef00ull, 1, 5));
+  ASSERT_TRUE(table.visit(0x12345678abcdef00ull, 1, 5));
+  ASSERT_TRUE(table.visit(0x12345678abcdef00ull, 1, 7));
+  // a lower depth replaces the entry
+  ASSERT_FALSE(table.visit(0x12345678abcdef00ull, 1, 3));
+  ASSERT_TRUE(table.visit(0x12345678abcdef00ull, 1, 4));
+  // a new iteration ignores the old entries
+  ASSERT_FALSE(table.visit(0x12345678abcdef00ull, 2, 4));
+  table.clear();
+  ASSERT_FALSE(table.visit(0x12345678abcdef00ull, 2, 4));
+}